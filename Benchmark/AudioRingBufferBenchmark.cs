@@ -0,0 +1,189 @@
+﻿using System;
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+using System.Threading;
+using MediaEncoder;
+
+namespace Benchmark
+{
+    // One producer and one consumer thread pushing audio-sized packets through a ring, as the capture threads,
+    // AudioMixer and MediaBuffer do: the locked CircularBuffer that AudioRingBuffer replaced against
+    // AudioRingBuffer itself. A stall is a call that found the ring full (producer) or empty (consumer) and had
+    // to yield before retrying.
+    internal static class AudioRingBufferBenchmark
+    {
+        private const int RingBytes = 48000 * 2 * 4; // one second of 48 kHz stereo float
+        private const int WriteBytes = 480 * 2 * 4; // 10 ms capture packets
+        private const int ReadBytes = 1024 * 2 * 4; // one AAC frame
+        private const long TotalBytes = 1L << 30;
+
+        private struct Result
+        {
+            public double Seconds;
+            public long ProducerStalls, ConsumerStalls;
+            public bool Complete;
+        }
+
+        public static void Run()
+        {
+            Console.WriteLine("Audio ring, 1 producer / 1 consumer, {0} MiB in {1} byte writes and {2} byte reads",
+                TotalBytes >> 20, WriteBytes, ReadBytes);
+            Console.WriteLine("{0,-16} {1,10} {2,16} {3,16}", "Ring", "MB/s", "producer stalls", "consumer stalls");
+
+            for (int run = 0; run < 2; run++)
+            {
+                var locked = new LockedRingBuffer(RingBytes);
+                Print("CircularBuffer", Measure((data, count) => locked.Write(data, 0, count), locked.Read));
+
+                using (var ring = new AudioRingBuffer(RingBytes))
+                {
+                    Print("AudioRingBuffer", Measure(ring.Write, ring.Read));
+                }
+            }
+
+            Console.WriteLine();
+        }
+
+        private static void Print(string name, Result result)
+        {
+            Console.WriteLine("{0,-16} {1,10:F0} {2,16} {3,16}{4}", name, TotalBytes / result.Seconds / 1e6,
+                result.ProducerStalls, result.ConsumerStalls, result.Complete ? "" : " (bytes lost)");
+        }
+
+        private static Result Measure(Func<IntPtr, int, int> write, Func<IntPtr, int, int> read)
+        {
+            var result = new Result();
+            var source = Marshal.AllocHGlobal(WriteBytes);
+            var dest = Marshal.AllocHGlobal(ReadBytes);
+            long consumed = 0;
+            try
+            {
+                for (int i = 0; i < WriteBytes; i++)
+                {
+                    Marshal.WriteByte(source, i, (byte)i);
+                }
+
+                var consumer = new Thread(() =>
+                {
+                    long stalls = 0;
+                    while (consumed < TotalBytes)
+                    {
+                        var count = (int)Math.Min(ReadBytes, TotalBytes - consumed);
+                        var bytes = read(dest, count);
+                        if (bytes == 0)
+                        {
+                            stalls++;
+                            Thread.Yield();
+                        }
+
+                        consumed += bytes;
+                    }
+
+                    result.ConsumerStalls = stalls;
+                });
+
+                var stopwatch = Stopwatch.StartNew();
+                consumer.Start();
+
+                long produced = 0;
+                while (produced < TotalBytes)
+                {
+                    var count = (int)Math.Min(WriteBytes, TotalBytes - produced);
+                    var offset = 0;
+                    while (offset < count)
+                    {
+                        var written = write(IntPtr.Add(source, offset), count - offset);
+                        if (written == 0)
+                        {
+                            result.ProducerStalls++;
+                            Thread.Yield();
+                        }
+
+                        offset += written;
+                    }
+
+                    produced += count;
+                }
+
+                consumer.Join();
+                result.Seconds = stopwatch.Elapsed.TotalSeconds;
+                result.Complete = consumed == TotalBytes;
+            }
+            finally
+            {
+                Marshal.FreeHGlobal(source);
+                Marshal.FreeHGlobal(dest);
+            }
+
+            return result;
+        }
+
+        // Write(IntPtr)/Read(IntPtr) of ScreenRecorder's former Encoder/CircularBuffer, unchanged.
+        private sealed class LockedRingBuffer
+        {
+            private readonly byte[] _buffer;
+            private readonly object _lockObject;
+            private int _writePosition;
+            private int _readPosition;
+            private int _byteCount;
+
+            public LockedRingBuffer(int size)
+            {
+                _buffer = new byte[size];
+                _lockObject = new object();
+            }
+
+            public int Write(IntPtr data, int offset, int count)
+            {
+                lock (_lockObject)
+                {
+                    var bytesWritten = 0;
+                    if (count > _buffer.Length - _byteCount)
+                    {
+                        count = _buffer.Length - _byteCount;
+                    }
+                    var writeToEnd = Math.Min(_buffer.Length - _writePosition, count);
+                    Marshal.Copy(IntPtr.Add(data, offset), _buffer, _writePosition, writeToEnd);
+                    _writePosition += writeToEnd;
+                    _writePosition %= _buffer.Length;
+                    bytesWritten += writeToEnd;
+                    if (bytesWritten < count)
+                    {
+                        Marshal.Copy(IntPtr.Add(data, offset + bytesWritten), _buffer, _writePosition, count - bytesWritten);
+                        _writePosition += (count - bytesWritten);
+                        bytesWritten = count;
+                    }
+                    _byteCount += bytesWritten;
+                    return bytesWritten;
+                }
+            }
+
+            public int Read(IntPtr data, int count)
+            {
+                lock (_lockObject)
+                {
+                    if (count > _byteCount)
+                    {
+                        count = _byteCount;
+                    }
+                    var bytesRead = 0;
+                    var readToEnd = Math.Min(_buffer.Length - _readPosition, count);
+                    Marshal.Copy(_buffer, _readPosition, data, readToEnd);
+                    bytesRead += readToEnd;
+                    _readPosition += readToEnd;
+                    _readPosition %= _buffer.Length;
+
+                    if (bytesRead < count)
+                    {
+                        Marshal.Copy(_buffer, _readPosition, IntPtr.Add(data, bytesRead), count - bytesRead);
+                        _readPosition += (count - bytesRead);
+                        bytesRead = count;
+                    }
+
+                    _byteCount -= bytesRead;
+                    return bytesRead;
+                }
+            }
+        }
+    }
+}
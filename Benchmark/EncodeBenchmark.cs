@@ -0,0 +1,69 @@
+﻿using System;
+using System.Diagnostics;
+using System.IO;
+using MediaEncoder;
+
+namespace Benchmark
+{
+    // Offline encode throughput on a fixed corpus: Benchmark encode <video.y4m> [output]. Frames come straight
+    // from the VideoFileReader mapping and go to MediaWriter back to back, without the clock-paced MediaBuffer
+    // the recorder uses (ScreenRecorder /replay covers that path in real time). The output is deleted afterwards.
+    internal static class EncodeBenchmark
+    {
+        public static bool Run(string[] args)
+        {
+            if (args.Length < 2 || !File.Exists(args[1]))
+            {
+                Console.WriteLine("usage: Benchmark encode <video.y4m> [output]");
+                return false;
+            }
+
+            var output = args.Length > 2
+                ? args[2]
+                : Path.Combine(Path.GetTempPath(), Path.GetFileNameWithoutExtension(args[1]) + ".encode.mp4");
+            var format = Path.GetExtension(output).TrimStart('.').ToLowerInvariant();
+
+            using (var reader = new VideoFileReader(args[1]))
+            {
+                var duration = reader.FrameCount * (double)reader.FrameRateDenominator / reader.FrameRateNumerator;
+                Console.WriteLine("Encode {0} ({1}x{2} {3}, {4} frames at {5}/{6} fps) -> {7}", args[1], reader.Width,
+                    reader.Height, reader.PixelFormat, reader.FrameCount, reader.FrameRateNumerator,
+                    reader.FrameRateDenominator, output);
+
+                var stopwatch = Stopwatch.StartNew();
+                try
+                {
+                    using (var writer = new MediaWriter(reader.Width, reader.Height, reader.FrameRateNumerator,
+                        reader.FrameRateDenominator, VideoCodec.H264, 5000000, AudioCodec.None, 0))
+                    {
+                        writer.Open(output, format);
+                        for (int i = 0; i < reader.FrameCount; i++)
+                        {
+                            using (var frame = reader.ReadFrame(i))
+                            {
+                                writer.EncodeVideoFrame(frame);
+                            }
+                        }
+
+                        writer.Close();
+                    }
+                }
+                finally
+                {
+                    stopwatch.Stop();
+                    if (File.Exists(output))
+                    {
+                        File.Delete(output);
+                    }
+                }
+
+                var seconds = stopwatch.Elapsed.TotalSeconds;
+                Console.WriteLine("H.264 5 Mbps: {0:F2} s, {1:F1} fps, {2:F2}x real time", seconds,
+                    reader.FrameCount / seconds, duration / seconds);
+            }
+
+            Console.WriteLine();
+            return true;
+        }
+    }
+}
@@ -0,0 +1,163 @@
+﻿using System;
+using MediaEncoder;
+
+namespace Benchmark
+{
+    // Compares the PixelConverter kernels (Scaler with UsePixelKernels) with swscale (UsePixelKernels = false)
+    // for every colorspace and range. The pictures are smooth gradients, one per channel order, so the
+    // differences come from the matrix and rounding rather than from swscale's choice of filter, which on noise
+    // disagrees with any other filter by far more than a rounding step.
+    //
+    // Allowed difference per plane, in code values:
+    //   Y                      1 (both round the same 15 bit products, swscale with its own offsets)
+    //   U/V at 1:1             1
+    //   U/V at 2:1             2 (2x2 box here, swscale's bilinear support with a different phase)
+    //   NV12 -> YUV420P        0 (a copy in both)
+    internal static class PixelConverterTest
+    {
+        private const int Width = 642;
+        private const int Height = 362;
+
+        public static bool Run()
+        {
+            var passed = Scaler.VerifyPixelKernels();
+            Console.WriteLine("PixelConverter against swscale, {0}x{1}, kernel {2}, self-check {3}", Width,
+                Height, Scaler.PixelKernel, passed ? "passed" : "FAILED");
+
+            foreach (ColorSpace colorSpace in Enum.GetValues(typeof(ColorSpace)))
+            {
+                foreach (ColorRange colorRange in Enum.GetValues(typeof(ColorRange)))
+                {
+                    foreach (var dstFormat in new[] { PixelFormat.NV12, PixelFormat.YUV420P })
+                    {
+                        foreach (var divisor in new[] { 1, 2 })
+                        {
+                            for (int order = 0; order < 3; order++)
+                            {
+                                using (var source = Gradient(order))
+                                {
+                                    passed &= Compare(source, Width / divisor, Height / divisor, dstFormat,
+                                        colorSpace, colorRange, 1, divisor == 1 ? 1 : 2,
+                                        string.Format("BGRA -> {0} {1} {2} {3}:1 order {4}", dstFormat, colorSpace,
+                                            colorRange, divisor, order));
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            using (var source = Noise(PixelFormat.NV12))
+            {
+                passed &= Compare(source, Width, Height, PixelFormat.YUV420P, ColorSpace.BT601, ColorRange.Limited,
+                    0, 0, "NV12 -> YUV420P");
+            }
+
+            Console.WriteLine(passed ? "passed" : "FAILED");
+            Console.WriteLine();
+            return passed;
+        }
+
+        private static bool Compare(VideoFrame source, int dstW, int dstH, PixelFormat dstFormat,
+            ColorSpace colorSpace, ColorRange colorRange, int lumaTolerance, int chromaTolerance, string name)
+        {
+            using (var kernels = new Scaler { ColorSpace = colorSpace, ColorRange = colorRange })
+            using (var swscale = new Scaler
+                   { ColorSpace = colorSpace, ColorRange = colorRange, UsePixelKernels = false })
+            using (var expected = new VideoFrame(dstW, dstH, dstFormat))
+            using (var actual = new VideoFrame(dstW, dstH, dstFormat))
+            {
+                if (!swscale.Convert(source, expected) || !kernels.Convert(source, actual))
+                {
+                    Console.WriteLine("{0,-48} conversion failed", name);
+                    return false;
+                }
+
+                var passed = true;
+                var line = string.Format("{0,-48}", name);
+                var planes = dstFormat == PixelFormat.NV12 ? 2 : 3;
+                for (int plane = 0; plane < planes; plane++)
+                {
+                    var tolerance = plane == 0 ? lumaTolerance : chromaTolerance;
+                    var difference = MaxDifference(expected, actual, plane);
+                    passed &= difference <= tolerance;
+                    var label = plane == 0 ? "Y" : planes == 2 ? "UV" : plane == 1 ? "U" : "V";
+                    line += string.Format(" {0} {1}/{2}", label, difference, tolerance);
+                }
+
+                if (!passed)
+                {
+                    line += " FAILED";
+                }
+
+                Console.WriteLine(line);
+                return passed;
+            }
+        }
+
+        private static unsafe int MaxDifference(VideoFrame expected, VideoFrame actual, int plane)
+        {
+            var chroma = plane > 0;
+            var rowBytes = !chroma ? expected.Width :
+                expected.PixelFormat == PixelFormat.NV12 ? (expected.Width + 1) / 2 * 2 : (expected.Width + 1) / 2;
+            var rows = chroma ? (expected.Height + 1) / 2 : expected.Height;
+            var e = (byte*)expected.DataPointer[plane];
+            var a = (byte*)actual.DataPointer[plane];
+            int eStride = expected.LineSize[plane], aStride = actual.LineSize[plane];
+
+            var result = 0;
+            for (int y = 0; y < rows; y++)
+            {
+                for (int x = 0; x < rowBytes; x++)
+                {
+                    result = Math.Max(result, Math.Abs(e[y * eStride + x] - a[y * aStride + x]));
+                }
+            }
+
+            return result;
+        }
+
+        // Channel c of pixel (x, y) is one of three ramps (horizontal, vertical, diagonal); order rotates which
+        // channel gets which, so a swapped matrix row cannot hide behind a symmetric picture.
+        private static unsafe VideoFrame Gradient(int order)
+        {
+            var frame = new VideoFrame(Width, Height, PixelFormat.BGRA);
+            var data = (byte*)frame.DataPointer[0];
+            var stride = frame.LineSize[0];
+            var ramps = new int[3];
+            for (int y = 0; y < Height; y++)
+            {
+                for (int x = 0; x < Width; x++)
+                {
+                    ramps[0] = x * 255 / Width;
+                    ramps[1] = y * 255 / Height;
+                    ramps[2] = (x + y) * 255 / (Width + Height);
+                    var p = data + y * stride + x * 4;
+                    p[0] = (byte)ramps[order % 3];
+                    p[1] = (byte)ramps[(order + 1) % 3];
+                    p[2] = (byte)ramps[(order + 2) % 3];
+                    p[3] = 255;
+                }
+            }
+
+            return frame;
+        }
+
+        private static unsafe VideoFrame Noise(PixelFormat format)
+        {
+            var frame = new VideoFrame(Width, Height, format);
+            var random = new Random(1);
+            for (int plane = 0; plane < 2; plane++)
+            {
+                var data = (byte*)frame.DataPointer[plane];
+                var rows = plane == 0 ? Height : (Height + 1) / 2;
+                for (int i = 0; i < rows * frame.LineSize[plane]; i++)
+                {
+                    data[i] = (byte)random.Next(256);
+                }
+            }
+
+            return frame;
+        }
+    }
+}
@@ -0,0 +1,386 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Drawing;
+using System.Runtime.InteropServices;
+using MediaEncoder;
+
+namespace Benchmark
+{
+    // Console measurements backing the figures quoted in MediaEncoder (ResamplerProfile.h, ChromaKeyFilter.h),
+    // and checks of the native kernels against FFmpeg.
+    // Run the Release build from bin\x64\Release so the FFmpeg dlls are found next to MediaEncoder.dll.
+    internal static class Program
+    {
+        private const int SourceRate = 48000;
+        private const int DestRate = 44100;
+        private const int BlockSamples = 480;
+
+        // Benchmark [resampler|audioformat|chromakey|pixels|scaler|ringbuffer]; no argument runs all of them.
+        // Benchmark remux <input> [output] and Benchmark encode <video.y4m> [output] only run on request, as they
+        // need an input file. Returns 1 if a check failed.
+        private static int Main(string[] args)
+        {
+            var mode = args.Length > 0 ? args[0].ToLowerInvariant() : "all";
+            var passed = true;
+
+            if (mode == "remux")
+            {
+                return RemuxBenchmark.Run(args) ? 0 : 1;
+            }
+
+            if (mode == "encode")
+            {
+                return EncodeBenchmark.Run(args) ? 0 : 1;
+            }
+
+            if (mode == "all" || mode == "resampler")
+            {
+                BenchmarkResampler();
+            }
+
+            if (mode == "all" || mode == "audioformat")
+            {
+                BenchmarkAudioFormat();
+            }
+
+            if (mode == "all" || mode == "chromakey")
+            {
+                BenchmarkChromaKey();
+            }
+
+            if (mode == "all" || mode == "pixels")
+            {
+                passed &= PixelConverterTest.Run();
+            }
+
+            if (mode == "all" || mode == "scaler")
+            {
+                passed &= ScalerBenchmark.Run();
+            }
+
+            if (mode == "all" || mode == "ringbuffer")
+            {
+                AudioRingBufferBenchmark.Run();
+            }
+
+            return passed ? 0 : 1;
+        }
+
+        private static void BenchmarkResampler()
+        {
+            Console.WriteLine("Resampler {0} -> {1} Hz, float", SourceRate, DestRate);
+            Console.WriteLine("{0,-12} {1,21} {2,21} {3,21} {4,21} {5,10} {6,9}", "Profile", "1 kHz", "10 kHz",
+                "16 kHz", "20 kHz", "23 kHz", "speed");
+
+            foreach (ResamplerProfile profile in Enum.GetValues(typeof(ResamplerProfile)))
+            {
+                var line = string.Format("{0,-12}", profile);
+                foreach (var frequency in new[] { 1000, 10000, 16000, 20000 })
+                {
+                    var output = Resample(profile, 1, Tone(frequency, SourceRate * 2));
+                    var sinad = FitTone(output, frequency, out var amplitude);
+                    line += string.Format(" {0,8:F1} dB {1,6:+0.00;-0.00} dB", sinad,
+                        Math.Round(20 * Math.Log10(amplitude / 0.5), 2) + 0.0);
+                }
+
+                // a 23 kHz tone is above the output Nyquist; whatever is left of it has folded back to 21.1 kHz
+                var alias = Resample(profile, 1, Tone(23000, SourceRate * 2));
+                line += string.Format(" {0,7:F1} dB", 20 * Math.Log10(Rms(alias) / (0.5 / Math.Sqrt(2))));
+
+                line += string.Format(" {0,8:F0}x", MeasureSpeed(profile));
+                Console.WriteLine(line);
+            }
+
+            Console.WriteLine("tone columns: SINAD / gain; 23 kHz: folded level relative to the input; speed: x real time");
+            Console.WriteLine();
+        }
+
+        // The audio path before and after the float change: capture float -> S16 (AudioSourceResampler) ->
+        // MediaWriter's swr to the encoder's FLTP, against float handed to MediaWriter as is. Part one is the
+        // round trip through S16 on its own, part two the whole writer with AAC into a temporary file.
+        private static unsafe void BenchmarkAudioFormat()
+        {
+            const int seconds = 60;
+            const int channels = 2;
+            const int frameSamples = 1024;
+            var samples = SourceRate * seconds;
+            var source = new float[samples * channels];
+            for (int i = 0; i < samples; i++)
+            {
+                source[i * 2] = source[i * 2 + 1] = (float)(0.9 * Math.Sin(2 * Math.PI * 1000 * i / SourceRate));
+            }
+
+            Console.WriteLine("Audio format, {0} s of {1} Hz stereo", seconds, SourceRate);
+
+            var roundTrip = new float[source.Length];
+            var stopwatch = Stopwatch.StartNew();
+            using (var toS16 = new Resampler())
+            using (var toFloat = new Resampler())
+            {
+                fixed (float* src = source)
+                fixed (float* dst = roundTrip)
+                {
+                    for (int offset = 0; offset < samples; offset += frameSamples)
+                    {
+                        var count = Math.Min(frameSamples, samples - offset);
+                        toS16.Resampling(channels, SampleFormat.FLT, SourceRate, channels, SampleFormat.S16,
+                            SourceRate, new IntPtr(src + offset * channels), count, out var s16, out var s16Samples);
+                        toFloat.Resampling(channels, SampleFormat.S16, SourceRate, channels, SampleFormat.FLT,
+                            SourceRate, s16, s16Samples, out var flt, out var fltSamples);
+                        Buffer.MemoryCopy(flt.ToPointer(), dst + offset * channels, (samples - offset) * channels * 4,
+                            fltSamples * channels * 4);
+                    }
+                }
+            }
+
+            var roundTripSeconds = stopwatch.Elapsed.TotalSeconds;
+            double signal = 0, noise = 0;
+            for (int i = 0; i < source.Length; i++)
+            {
+                signal += source[i] * source[i];
+                noise += (roundTrip[i] - source[i]) * (roundTrip[i] - source[i]);
+            }
+
+            Console.WriteLine("FLT -> S16 -> FLT   {0,8:F3} ms per second of audio, SNR {1:F1} dB (float: no conversion)",
+                roundTripSeconds * 1000 / seconds, 10 * Math.Log10(signal / noise));
+
+            foreach (var format in new[] { SampleFormat.S16, SampleFormat.FLT })
+            {
+                var path = System.IO.Path.Combine(System.IO.Path.GetTempPath(), "Benchmark-audio.m4a");
+                stopwatch.Restart();
+                using (var writer = new MediaWriter(0, 0, 1, 1, VideoCodec.None, 0, AudioCodec.Aac, 192000))
+                using (var toS16 = new Resampler())
+                using (var frame = new AudioFrame(SourceRate, channels, format, frameSamples))
+                {
+                    writer.Open(path, "mp4");
+                    fixed (float* src = source)
+                    {
+                        for (int offset = 0; offset + frameSamples <= samples; offset += frameSamples)
+                        {
+                            var data = new IntPtr(src + offset * channels);
+                            if (format == SampleFormat.S16)
+                            {
+                                toS16.Resampling(channels, SampleFormat.FLT, SourceRate, channels, SampleFormat.S16,
+                                    SourceRate, data, frameSamples, out data, out _);
+                            }
+
+                            frame.FillFrame(data);
+                            writer.EncodeAudioFrame(frame);
+                        }
+                    }
+
+                    writer.Close();
+                }
+
+                var elapsed = stopwatch.Elapsed.TotalSeconds;
+                System.IO.File.Delete(path);
+                Console.WriteLine("MediaWriter AAC, {0,-3} {1,8:F3} ms per second of audio, {2:F0}x real time",
+                    format == SampleFormat.S16 ? "S16" : "FLT", elapsed * 1000 / seconds, seconds / elapsed);
+            }
+
+            Console.WriteLine();
+        }
+
+        private static unsafe void BenchmarkChromaKey()
+        {
+            const int width = 1920, height = 1080, frames = 120;
+
+            // left half green screen with a little noise, right half a busy pattern
+            var source = new byte[width * height * 4];
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    var i = (y * width + x) * 4;
+                    var green = x < width / 2;
+                    source[i + 0] = (byte)(green ? 40 : x * 7);
+                    source[i + 1] = (byte)(green ? 200 + (y & 31) : y * 3);
+                    source[i + 2] = (byte)(green ? 50 : x + y);
+                    source[i + 3] = 255;
+                }
+            }
+
+            using (var frame = new VideoFrame(width, height, PixelFormat.BGRA))
+            using (var filter = new ChromaKeyFilter())
+            {
+                filter.KeyColor = Color.FromArgb(0, 255, 0);
+
+                var stopwatch = new Stopwatch();
+                fixed (byte* src = source)
+                {
+                    for (int i = -10; i < frames; i++)
+                    {
+                        // Apply keys in place, so every run starts from the same picture; the first ten warm up
+                        frame.FillFrame(new IntPtr(src), width * 4);
+                        if (i >= 0)
+                        {
+                            stopwatch.Start();
+                        }
+
+                        filter.Apply(frame);
+                        stopwatch.Stop();
+                    }
+                }
+
+                var milliseconds = stopwatch.Elapsed.TotalMilliseconds / frames;
+                Console.WriteLine("ChromaKeyFilter {0}x{1} BGRA, kernel {2}, {3} cores", width, height,
+                    ChromaKeyFilter.Kernel, Environment.ProcessorCount);
+                Console.WriteLine("{0:F2} ms/frame, {1:F0} fps", milliseconds, 1000 / milliseconds);
+                Console.WriteLine();
+            }
+        }
+
+        private static float[] Tone(int frequency, int samples)
+        {
+            var result = new float[samples];
+            for (int i = 0; i < samples; i++)
+            {
+                result[i] = (float)(0.5 * Math.Sin(2 * Math.PI * frequency * i / SourceRate));
+            }
+
+            return result;
+        }
+
+        private static unsafe float[] Resample(ResamplerProfile profile, int channels, float[] source)
+        {
+            var result = new List<float>(source.Length);
+            using (var resampler = new Resampler())
+            {
+                resampler.Profile = profile;
+                fixed (float* src = source)
+                {
+                    for (int offset = 0; offset < source.Length; offset += BlockSamples * channels)
+                    {
+                        var samples = Math.Min(BlockSamples, (source.Length - offset) / channels);
+                        resampler.Resampling(channels, SampleFormat.FLT, SourceRate, channels, SampleFormat.FLT,
+                            DestRate, new IntPtr(src + offset), samples, out var destData, out var destSamples);
+                        var block = new float[destSamples * channels];
+                        Marshal.Copy(destData, block, 0, block.Length);
+                        result.AddRange(block);
+                    }
+                }
+            }
+
+            return result.ToArray();
+        }
+
+        private static unsafe double MeasureSpeed(ResamplerProfile profile)
+        {
+            const int seconds = 60;
+            const int channels = 2;
+            var random = new Random(1);
+            var source = new float[SourceRate * seconds * channels];
+            for (int i = 0; i < source.Length; i++)
+            {
+                source[i] = (float)(random.NextDouble() - 0.5);
+            }
+
+            var best = double.MaxValue;
+            for (int run = 0; run < 3; run++)
+            {
+                using (var resampler = new Resampler())
+                {
+                    resampler.Profile = profile;
+                    var stopwatch = Stopwatch.StartNew();
+                    fixed (float* src = source)
+                    {
+                        for (int offset = 0; offset < source.Length; offset += BlockSamples * channels)
+                        {
+                            resampler.Resampling(channels, SampleFormat.FLT, SourceRate, channels, SampleFormat.FLT,
+                                DestRate, new IntPtr(src + offset), BlockSamples, out _, out _);
+                        }
+                    }
+
+                    best = Math.Min(best, stopwatch.Elapsed.TotalSeconds);
+                }
+            }
+
+            return seconds / best;
+        }
+
+        // Least-squares fit of a sine, a cosine and a DC term at the known frequency over the middle half of the
+        // output (clear of the filter start-up); returns the fitted tone against everything else in dB.
+        private static double FitTone(float[] samples, int frequency, out double amplitude)
+        {
+            int start = samples.Length / 4, count = samples.Length / 2;
+            var ata = new double[3, 3];
+            var atb = new double[3];
+            var basis = new double[3];
+            for (int i = start; i < start + count; i++)
+            {
+                var phase = 2 * Math.PI * frequency * i / DestRate;
+                basis[0] = Math.Sin(phase);
+                basis[1] = Math.Cos(phase);
+                basis[2] = 1;
+                for (int r = 0; r < 3; r++)
+                {
+                    atb[r] += basis[r] * samples[i];
+                    for (int c = 0; c < 3; c++)
+                    {
+                        ata[r, c] += basis[r] * basis[c];
+                    }
+                }
+            }
+
+            var coef = Solve(ata, atb);
+            amplitude = Math.Sqrt(coef[0] * coef[0] + coef[1] * coef[1]);
+
+            double signal = 0, noise = 0;
+            for (int i = start; i < start + count; i++)
+            {
+                var phase = 2 * Math.PI * frequency * i / DestRate;
+                var tone = coef[0] * Math.Sin(phase) + coef[1] * Math.Cos(phase);
+                var residual = samples[i] - tone - coef[2];
+                signal += tone * tone;
+                noise += residual * residual;
+            }
+
+            return 10 * Math.Log10(signal / noise);
+        }
+
+        private static double[] Solve(double[,] a, double[] b)
+        {
+            int n = b.Length;
+            for (int p = 0; p < n; p++)
+            {
+                for (int r = p + 1; r < n; r++)
+                {
+                    var factor = a[r, p] / a[p, p];
+                    for (int c = p; c < n; c++)
+                    {
+                        a[r, c] -= factor * a[p, c];
+                    }
+
+                    b[r] -= factor * b[p];
+                }
+            }
+
+            var x = new double[n];
+            for (int r = n - 1; r >= 0; r--)
+            {
+                var sum = b[r];
+                for (int c = r + 1; c < n; c++)
+                {
+                    sum -= a[r, c] * x[c];
+                }
+
+                x[r] = sum / a[r, r];
+            }
+
+            return x;
+        }
+
+        private static double Rms(float[] samples)
+        {
+            int start = samples.Length / 4, count = samples.Length / 2;
+            double sum = 0;
+            for (int i = start; i < start + count; i++)
+            {
+                sum += samples[i] * samples[i];
+            }
+
+            return Math.Sqrt(sum / count);
+        }
+    }
+}
@@ -0,0 +1,151 @@
+﻿using System;
+using System.Diagnostics;
+using MediaEncoder;
+
+namespace Benchmark
+{
+    // Sliced swscale (Scaler.h, CreateSlicedSwsContext): checks that the output does not depend on the number of
+    // bands, at heights that do and do not line up with them, and times one conversion across thread counts.
+    // Scalers here run with UsePixelKernels = false so every frame really goes through swscale.
+    internal static class ScalerBenchmark
+    {
+        private const int SourceWidth = 1920;
+        private const int SourceHeight = 1080;
+
+        private static readonly int[,] Sizes =
+        {
+            { 1920, 1080 }, { 1280, 720 }, { 1280, 719 }, { 1366, 768 }, { 1917, 1079 }, { 641, 361 }, { 640, 97 }
+        };
+
+        private static readonly int[] ThreadCounts = { 1, 2, 3, 4, 8 };
+
+        public static bool Run()
+        {
+            int defaultThreads;
+            using (var scaler = new Scaler())
+            {
+                defaultThreads = scaler.Threads;
+            }
+
+            Console.WriteLine("Sliced swscale, {0}x{1} BGRA -> YUV420P, {2} cores, default {3} threads", SourceWidth,
+                SourceHeight, Environment.ProcessorCount, defaultThreads);
+
+            var passed = true;
+            using (var source = Noise())
+            {
+                for (int i = 0; i < Sizes.GetLength(0); i++)
+                {
+                    passed &= CompareThreads(source, Sizes[i, 0], Sizes[i, 1]);
+                }
+
+                Console.WriteLine();
+                Console.WriteLine("{0,-8} {1,10} {2,8} {3,8}", "threads", "ms/frame", "fps", "speedup");
+                var single = 0.0;
+                foreach (var threads in ThreadCounts)
+                {
+                    var milliseconds = Measure(source, 1280, 720, threads);
+                    if (threads == 1)
+                    {
+                        single = milliseconds;
+                    }
+
+                    Console.WriteLine("{0,-8} {1,10:F2} {2,8:F0} {3,7:F2}x", threads, milliseconds,
+                        1000 / milliseconds, single / milliseconds);
+                }
+            }
+
+            Console.WriteLine(passed ? "passed" : "FAILED");
+            Console.WriteLine();
+            return passed;
+        }
+
+        private static bool CompareThreads(VideoFrame source, int dstW, int dstH)
+        {
+            var line = string.Format("{0,5}x{1,-5}", dstW, dstH);
+            var passed = true;
+            ulong expected = 0;
+            foreach (var threads in ThreadCounts)
+            {
+                using (var scaler = new Scaler(1, threads) { UsePixelKernels = false })
+                using (var frame = new VideoFrame(dstW, dstH, PixelFormat.YUV420P))
+                {
+                    if (!scaler.Convert(source, frame))
+                    {
+                        line += string.Format(" {0}: failed", threads);
+                        passed = false;
+                        continue;
+                    }
+
+                    var checksum = Checksum(frame);
+                    if (threads == 1)
+                    {
+                        expected = checksum;
+                    }
+
+                    var same = checksum == expected;
+                    passed &= same;
+                    line += string.Format(" {0}: {1:X16}{2}", threads, checksum, same ? "" : " DIFFERS");
+                }
+            }
+
+            Console.WriteLine(line);
+            return passed;
+        }
+
+        private static double Measure(VideoFrame source, int dstW, int dstH, int threads)
+        {
+            const int frames = 200;
+            using (var scaler = new Scaler(1, threads) { UsePixelKernels = false })
+            using (var frame = new VideoFrame(dstW, dstH, PixelFormat.YUV420P))
+            {
+                for (int i = 0; i < 10; i++)
+                {
+                    scaler.Convert(source, frame);
+                }
+
+                var stopwatch = Stopwatch.StartNew();
+                for (int i = 0; i < frames; i++)
+                {
+                    scaler.Convert(source, frame);
+                }
+
+                return stopwatch.Elapsed.TotalMilliseconds / frames;
+            }
+        }
+
+        // FNV-1a over the visible bytes of the three planes, ignoring the padding at the end of each line.
+        private static unsafe ulong Checksum(VideoFrame frame)
+        {
+            var hash = 14695981039346656037UL;
+            for (int plane = 0; plane < 3; plane++)
+            {
+                var width = plane == 0 ? frame.Width : (frame.Width + 1) / 2;
+                var height = plane == 0 ? frame.Height : (frame.Height + 1) / 2;
+                var data = (byte*)frame.DataPointer[plane];
+                var stride = frame.LineSize[plane];
+                for (int y = 0; y < height; y++)
+                {
+                    for (int x = 0; x < width; x++)
+                    {
+                        hash = (hash ^ data[y * stride + x]) * 1099511628211UL;
+                    }
+                }
+            }
+
+            return hash;
+        }
+
+        private static unsafe VideoFrame Noise()
+        {
+            var frame = new VideoFrame(SourceWidth, SourceHeight, PixelFormat.BGRA);
+            var random = new Random(1);
+            var data = (byte*)frame.DataPointer[0];
+            for (int i = 0; i < SourceHeight * frame.LineSize[0]; i++)
+            {
+                data[i] = (byte)random.Next(256);
+            }
+
+            return frame;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#include "pch.h"
+#include "AVSync.h"
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	// weight of a new audio offset in the running average; the per-frame estimate is noisy by a packet or so
+	static const double AudioDriftSmoothing = 0.05;
+
+	void InitAVSync(AVSyncState* state)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+
+		memset(state, 0, sizeof(AVSyncState));
+		state->frequency = frequency.QuadPart;
+	}
+
+	int64_t SyncPosition(const AVSyncState* state, int64_t captureTimestamp, int64_t rebase, AVRational timeBase)
+	{
+		return av_rescale_rnd(captureTimestamp - rebase - state->origin, timeBase.den,
+		                      state->frequency * timeBase.num, AV_ROUND_NEAR_INF);
+	}
+
+	// Ticks to subtract from captureTimestamp so that it lands at position.
+	static int64_t Rebase(const AVSyncState* state, int64_t captureTimestamp, int64_t position, AVRational timeBase)
+	{
+		return captureTimestamp - state->origin - av_rescale_rnd(position, state->frequency * timeBase.num,
+		                                                         timeBase.den, AV_ROUND_NEAR_INF);
+	}
+
+	// Offset of a stream's frame from where it is about to be written, or false if the stream was rebased onto
+	// position instead. The first stamped frame of either stream fixes the origin.
+	static bool StreamOffset(AVSyncState* state, int64_t captureTimestamp, int64_t position, int64_t* rebase,
+	                         bool* started, AVRational timeBase, int64_t* offset)
+	{
+		if (state->origin == 0)
+			state->origin = captureTimestamp - av_rescale_rnd(position, state->frequency * timeBase.num,
+			                                                  timeBase.den, AV_ROUND_NEAR_INF);
+
+		*offset = SyncPosition(state, captureTimestamp, *rebase, timeBase) - position;
+		int64_t second = timeBase.den / timeBase.num;
+		// a stream that starts later than the other is placed where it belongs, however late that is
+		if (*started && (*offset > second || *offset < -second))
+		{
+			*rebase = Rebase(state, captureTimestamp, position, timeBase);
+			state->rebases++;
+			return false;
+		}
+		*started = true;
+		return true;
+	}
+
+	int SyncVideoFrame(AVSyncState* state, int64_t captureTimestamp, int64_t nextPts, AVRational timeBase)
+	{
+		int64_t offset;
+		if (!StreamOffset(state, captureTimestamp, nextPts, &state->videoRebase, &state->videoStarted, timeBase,
+		                  &offset))
+			return 0;
+
+		// a frame of slack absorbs the jitter between capture and the pacing clock
+		if (offset <= -2)
+		{
+			state->droppedVideoFrames++;
+			return -1;
+		}
+		if (offset >= 2)
+		{
+			state->duplicatedVideoFrames += offset;
+			return static_cast<int>(offset);
+		}
+		return 0;
+	}
+
+	int SyncAudioFrame(AVSyncState* state, int64_t captureTimestamp, int64_t position, int sampleRate, int distance,
+	                   int64_t* gap)
+	{
+		*gap = 0;
+		int64_t offset;
+		if (!StreamOffset(state, captureTimestamp, position, &state->audioRebase, &state->audioStarted,
+		                  av_make_q(1, sampleRate), &offset))
+		{
+			state->audioDrift = 0;
+			return 0;
+		}
+
+		// a stall of 100 ms would take 10 s to stretch away at 1%, so it is closed at once
+		if (offset > sampleRate / 10 || offset < -sampleRate / 10)
+		{
+			*gap = offset;
+			state->audioDrift = 0;
+			return 0;
+		}
+
+		state->audioDrift += (offset - state->audioDrift) * AudioDriftSmoothing;
+
+		// within 10 ms nothing is corrected; beyond that audio is stretched by at most 1%, about 17 cents of pitch
+		if (fabs(state->audioDrift) < sampleRate / 100.0)
+			return 0;
+		double limit = distance / 100.0;
+		return static_cast<int>(lround(max(-limit, min(limit, state->audioDrift))));
+	}
+#pragma managed(pop)
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+namespace MediaEncoder
+{
+	// Maps the capture timestamps (QueryPerformanceCounter ticks) of both streams onto one output timeline whose
+	// pts 0 is at origin. Video keeps a constant frame rate by repeating or dropping frames; audio is stretched
+	// through swr_set_compensation, and gaps too large to stretch away are filled with silence or cut.
+	// Offsets beyond a second (pause, device switch, suspend) rebase only the stream they happen on, so the
+	// shared origin never moves and one stream's gap can not shift the other.
+	struct AVSyncState
+	{
+		int64_t origin; // 0 until the first stamped frame of either stream
+		int64_t frequency;
+		int64_t videoRebase; // ticks subtracted from video timestamps after rebases
+		int64_t audioRebase;
+		bool videoStarted;
+		bool audioStarted;
+		double audioDrift; // smoothed, in samples; positive when audio lags the timeline
+		int audioCompensation;
+		int64_t droppedVideoFrames;
+		int64_t duplicatedVideoFrames;
+		int64_t rebases;
+	};
+
+	void InitAVSync(AVSyncState* state);
+
+	// Position of captureTimestamp on the output timeline, in timeBase units, after the stream's rebase.
+	int64_t SyncPosition(const AVSyncState* state, int64_t captureTimestamp, int64_t rebase, AVRational timeBase);
+
+	// Number of copies of the previous frame to encode before this one, or -1 to drop it.
+	int SyncVideoFrame(AVSyncState* state, int64_t captureTimestamp, int64_t nextPts, AVRational timeBase);
+
+	// Sample delta to pass to swr_set_compensation over distance output samples. position is the output pts the
+	// frame's first sample will get, including what the resampler still buffers. When the offset is too large to
+	// stretch, gap receives the number of samples to insert (positive) or drop (negative) instead.
+	int SyncAudioFrame(AVSyncState* state, int64_t captureTimestamp, int64_t position, int sampleRate, int distance,
+	                   int64_t* gap);
+}
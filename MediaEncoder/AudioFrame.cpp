@@ -4,7 +4,7 @@
 namespace MediaEncoder
 {
 	AudioFrame::AudioFrame(int sampleRate, int channels, MediaEncoder::SampleFormat sampleFormat,
-	                       int samples) : m_disposed(false)
+	                       int samples) : m_capacity(samples), m_bufferSize(0), m_disposed(false)
 	{
 		m_avFrame = av_frame_alloc();
 		m_avFrame->format = static_cast<int>(sampleFormat);
@@ -12,26 +12,40 @@ namespace MediaEncoder
 		m_avFrame->sample_rate = sampleRate;
 		m_avFrame->nb_samples = samples;
 		av_frame_get_buffer(m_avFrame, 0);
+		m_bufferSize = av_samples_get_buffer_size(nullptr, m_avFrame->channels, m_avFrame->nb_samples,
+		                                          static_cast<AVSampleFormat>(m_avFrame->format), 1);
 	}
 
     void AudioFrame::FillFrame(IntPtr src)
     {
         CheckIfDisposed();
-        int bufferSize = av_samples_get_buffer_size(m_avFrame->linesize, m_avFrame->channels, m_avFrame->nb_samples, static_cast<AVSampleFormat>(m_avFrame->format), 0);
-        if (bufferSize > 0)
-            memcpy(m_avFrame->data[0], src.ToPointer(), bufferSize);
+        if (m_bufferSize > 0)
+            memcpy(m_avFrame->data[0], src.ToPointer(), m_bufferSize);
         else
-            System::Diagnostics::Debug::WriteLine("av_samples_get_buffer_size: {0}", bufferSize);
+            System::Diagnostics::Debug::WriteLine("av_samples_get_buffer_size: {0}", m_bufferSize);
     }
 
     void AudioFrame::ClearFrame()
     {
         CheckIfDisposed();
-        int bufferSize = av_samples_get_buffer_size(m_avFrame->linesize, m_avFrame->channels, m_avFrame->nb_samples, static_cast<AVSampleFormat>(m_avFrame->format), 0);
-        if (bufferSize > 0)
-            memset(m_avFrame->data[0], 0, bufferSize);
+        if (m_bufferSize > 0)
+            memset(m_avFrame->data[0], 0, m_bufferSize);
         else
-            System::Diagnostics::Debug::WriteLine("av_samples_get_buffer_size: {0}", bufferSize);
+            System::Diagnostics::Debug::WriteLine("av_samples_get_buffer_size: {0}", m_bufferSize);
+    }
+
+    bool AudioFrame::TrySetSamples(int samples)
+    {
+        CheckIfDisposed();
+        if (samples <= 0 || samples > m_capacity)
+            return false;
+        if (samples == m_avFrame->nb_samples)
+            return true;
+
+        m_avFrame->nb_samples = samples;
+        m_bufferSize = av_samples_get_buffer_size(nullptr, m_avFrame->channels, samples,
+                                                  static_cast<AVSampleFormat>(m_avFrame->format), 1);
+        return true;
     }
 
 }
\ No newline at end of file
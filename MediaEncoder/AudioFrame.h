@@ -4,6 +4,7 @@ using namespace System;
 using namespace Collections::Generic;
 
 #include "SampleFormat.h"
+#include "FramePlanes.h"
 
 namespace MediaEncoder
 {
@@ -11,6 +12,8 @@ namespace MediaEncoder
 	{
 	private:
 		AVFrame* m_avFrame;
+		int m_capacity;
+		int m_bufferSize;
 		bool m_disposed;
 	private:
 		void CheckIfDisposed()
@@ -41,6 +44,19 @@ namespace MediaEncoder
 
 		void FillFrame(IntPtr src);
 		void ClearFrame();
+
+	internal:
+		bool TrySetSamples(int samples);
+
+		// number of samples the buffer was allocated for
+		property int Capacity
+		{
+			int get()
+			{
+				return m_capacity;
+			}
+		}
+
 	public:
 		property IntPtr NativePointer
 		{
@@ -86,7 +102,7 @@ namespace MediaEncoder
 				auto result = gcnew array<int>(8);
 				for (int i = 0; i < 8; i++)
 				{
-					result[i] = m_avFrame->linesize[0];
+					result[i] = m_avFrame->linesize[i];
 				}
 				return result;
 			}
@@ -106,6 +122,16 @@ namespace MediaEncoder
 			}
 		}
 
+		// Same as DataPointer and LineSize, without allocating. Planar layouts expose the first four channels.
+		property FramePlanes Planes
+		{
+			FramePlanes get()
+			{
+				CheckIfDisposed();
+				return FramePlanes::FromAVFrame(m_avFrame);
+			}
+		}
+
 		property SampleFormat SampleFormat
 		{
 			MediaEncoder::SampleFormat get()
@@ -114,5 +140,21 @@ namespace MediaEncoder
 				return static_cast<MediaEncoder::SampleFormat>(m_avFrame->format);
 			}
 		}
+
+		// Stopwatch ticks at which the first sample was captured, 0 if unknown; stored like
+		// VideoFrame::CaptureTimestamp.
+		property Int64 CaptureTimestamp
+		{
+			Int64 get()
+			{
+				CheckIfDisposed();
+				return reinterpret_cast<intptr_t>(m_avFrame->opaque);
+			}
+			void set(Int64 value)
+			{
+				CheckIfDisposed();
+				m_avFrame->opaque = reinterpret_cast<void*>(static_cast<intptr_t>(value));
+			}
+		}
 	};
 }
@@ -0,0 +1,64 @@
+#include "pch.h"
+#include "AudioFramePool.h"
+
+namespace MediaEncoder
+{
+	AudioFramePool::AudioFramePool() : m_hits(0), m_misses(0), m_count(0), m_disposed(false)
+	{
+		m_frames = gcnew ConcurrentDictionary<int64_t, ConcurrentBag<AudioFrame^>^>();
+	}
+
+	AudioFramePool::~AudioFramePool()
+	{
+		m_disposed = true;
+		for each (auto bag in m_frames->Values)
+		{
+			AudioFrame^ audioFrame;
+			while (bag->TryTake(audioFrame))
+			{
+				Threading::Interlocked::Decrement(m_count);
+				delete audioFrame;
+			}
+		}
+	}
+
+	AudioFrame^ AudioFramePool::Rent(int sampleRate, int channels, SampleFormat sampleFormat, int samples)
+	{
+		CheckIfDisposed();
+
+		ConcurrentBag<AudioFrame^>^ bag;
+		AudioFrame^ audioFrame;
+		if (m_frames->TryGetValue(MakeKey(sampleRate, channels, sampleFormat, samples), bag) && bag->TryTake(
+			audioFrame))
+		{
+			Threading::Interlocked::Decrement(m_count);
+			Threading::Interlocked::Increment(m_hits);
+			return audioFrame;
+		}
+
+		Threading::Interlocked::Increment(m_misses);
+		return gcnew AudioFrame(sampleRate, channels, sampleFormat, samples);
+	}
+
+	void AudioFramePool::Return(AudioFrame^ audioFrame)
+	{
+		if (audioFrame == nullptr)
+			return;
+
+		if (m_disposed || !audioFrame->TrySetSamples(audioFrame->Capacity))
+		{
+			delete audioFrame;
+			return;
+		}
+		audioFrame->CaptureTimestamp = 0;
+
+		int64_t key = MakeKey(audioFrame->SampleRate, audioFrame->Channels, audioFrame->SampleFormat,
+		                      audioFrame->Capacity);
+		ConcurrentBag<AudioFrame^>^ bag;
+		if (!m_frames->TryGetValue(key, bag))
+			bag = m_frames->GetOrAdd(key, gcnew ConcurrentBag<AudioFrame^>());
+
+		bag->Add(audioFrame);
+		Threading::Interlocked::Increment(m_count);
+	}
+}
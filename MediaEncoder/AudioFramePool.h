@@ -0,0 +1,71 @@
+#pragma once
+
+using namespace System;
+using namespace Collections::Concurrent;
+
+#include "AudioFrame.h"
+
+namespace MediaEncoder
+{
+	// Recycles AudioFrames, keyed by (sample rate, channels, sample format, samples). Rent and Return can be
+	// called from different threads; in steady state, when the same chunk size is requested over and over,
+	// nothing is allocated.
+	public ref class AudioFramePool : IDisposable
+	{
+	private:
+		ConcurrentDictionary<int64_t, ConcurrentBag<AudioFrame^>^>^ m_frames;
+		int64_t m_hits;
+		int64_t m_misses;
+		int m_count;
+		bool m_disposed;
+
+		void CheckIfDisposed()
+		{
+			if (m_disposed)
+				throw gcnew ObjectDisposedException("The object was already disposed.");
+		}
+
+		static int64_t MakeKey(int sampleRate, int channels, SampleFormat sampleFormat, int samples)
+		{
+			return (static_cast<int64_t>(samples) << 40) | (static_cast<int64_t>(sampleRate & 0xFFFFF) << 20) |
+				(static_cast<int64_t>(channels & 0xFF) << 8) | (static_cast<int64_t>(sampleFormat) & 0xFF);
+		}
+
+	public:
+		AudioFramePool();
+
+		~AudioFramePool();
+
+		AudioFrame^ Rent(int sampleRate, int channels, SampleFormat sampleFormat, int samples);
+
+		// Hands a rented frame back. A frame that was shortened is restored to the size it was rented with.
+		// Frames returned after the pool was disposed are disposed right away.
+		void Return(AudioFrame^ audioFrame);
+
+	public:
+		property int64_t Hits
+		{
+			int64_t get()
+			{
+				return m_hits;
+			}
+		}
+
+		property int64_t Misses
+		{
+			int64_t get()
+			{
+				return m_misses;
+			}
+		}
+
+		// frames currently waiting in the pool
+		property int Count
+		{
+			int get()
+			{
+				return m_count;
+			}
+		}
+	};
+}
@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "AudioRingBuffer.h"
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	SpscRingBuffer* SpscRingBuffer::Create(int capacity)
+	{
+		auto ringBuffer = static_cast<SpscRingBuffer*>(_aligned_malloc(sizeof(SpscRingBuffer), 64));
+		if (ringBuffer == nullptr)
+			return nullptr;
+
+		memset(ringBuffer, 0, sizeof(SpscRingBuffer));
+		ringBuffer->m_buffer = static_cast<uint8_t*>(av_malloc(capacity));
+		if (ringBuffer->m_buffer == nullptr)
+		{
+			_aligned_free(ringBuffer);
+			return nullptr;
+		}
+		ringBuffer->m_capacity = capacity;
+		return ringBuffer;
+	}
+
+	void SpscRingBuffer::Destroy(SpscRingBuffer* ringBuffer)
+	{
+		if (ringBuffer == nullptr)
+			return;
+
+		av_free(ringBuffer->m_buffer);
+		_aligned_free(ringBuffer);
+	}
+
+	int SpscRingBuffer::Count() const
+	{
+		LONG64 readPosition = ReadAcquire64(&m_readPosition);
+		LONG64 writePosition = ReadAcquire64(&m_writePosition);
+		return static_cast<int>(writePosition - readPosition);
+	}
+
+	int SpscRingBuffer::BeginWrite(int count, uint8_t** first, int* firstLength, uint8_t** second, int* secondLength)
+	{
+		LONG64 writePosition = m_writePosition;
+		if (m_capacity - (writePosition - m_cachedReadPosition) < count)
+			m_cachedReadPosition = ReadAcquire64(&m_readPosition);
+
+		int available = m_capacity - static_cast<int>(writePosition - m_cachedReadPosition);
+		if (count > available)
+			count = available;
+
+		int offset = static_cast<int>(writePosition % m_capacity);
+		int toEnd = min(m_capacity - offset, count);
+		*first = m_buffer + offset;
+		*firstLength = toEnd;
+		*second = count > toEnd ? m_buffer : nullptr;
+		*secondLength = count - toEnd;
+		return count;
+	}
+
+	void SpscRingBuffer::EndWrite(int count)
+	{
+		WriteRelease64(&m_writePosition, m_writePosition + count);
+	}
+
+	int SpscRingBuffer::BeginRead(int count, uint8_t** first, int* firstLength, uint8_t** second, int* secondLength)
+	{
+		LONG64 readPosition = m_readPosition;
+		if (m_cachedWritePosition - readPosition < count)
+			m_cachedWritePosition = ReadAcquire64(&m_writePosition);
+
+		int available = static_cast<int>(m_cachedWritePosition - readPosition);
+		if (count > available)
+			count = available;
+
+		int offset = static_cast<int>(readPosition % m_capacity);
+		int toEnd = min(m_capacity - offset, count);
+		*first = m_buffer + offset;
+		*firstLength = toEnd;
+		*second = count > toEnd ? m_buffer : nullptr;
+		*secondLength = count - toEnd;
+		return count;
+	}
+
+	void SpscRingBuffer::EndRead(int count)
+	{
+		WriteRelease64(&m_readPosition, m_readPosition + count);
+	}
+
+	int SpscRingBuffer::Write(const uint8_t* src, int count)
+	{
+		uint8_t *first, *second;
+		int firstLength, secondLength;
+		count = BeginWrite(count, &first, &firstLength, &second, &secondLength);
+		memcpy(first, src, firstLength);
+		if (secondLength > 0)
+			memcpy(second, src + firstLength, secondLength);
+		EndWrite(count);
+		return count;
+	}
+
+	int SpscRingBuffer::Read(uint8_t* dest, int count)
+	{
+		uint8_t *first, *second;
+		int firstLength, secondLength;
+		count = BeginRead(count, &first, &firstLength, &second, &secondLength);
+		memcpy(dest, first, firstLength);
+		if (secondLength > 0)
+			memcpy(dest + firstLength, second, secondLength);
+		EndRead(count);
+		return count;
+	}
+#pragma managed(pop)
+
+	AudioRingBuffer::AudioRingBuffer(int size) : m_disposed(false)
+	{
+		if (size <= 0)
+			throw gcnew ArgumentOutOfRangeException("size");
+
+		m_ringBuffer = SpscRingBuffer::Create(size);
+		if (m_ringBuffer == nullptr)
+			throw gcnew OutOfMemoryException("SpscRingBuffer::Create");
+	}
+
+	AudioRingBufferRegion AudioRingBuffer::BeginWrite(int count)
+	{
+		CheckIfDisposed();
+
+		uint8_t *first, *second;
+		int firstLength, secondLength;
+		m_ringBuffer->BeginWrite(count, &first, &firstLength, &second, &secondLength);
+
+		AudioRingBufferRegion region;
+		region.First = IntPtr(first);
+		region.FirstLength = firstLength;
+		region.Second = IntPtr(second);
+		region.SecondLength = secondLength;
+		return region;
+	}
+
+	void AudioRingBuffer::EndWrite(int count)
+	{
+		CheckIfDisposed();
+		m_ringBuffer->EndWrite(count);
+	}
+
+	int AudioRingBuffer::Write(IntPtr data, int count)
+	{
+		CheckIfDisposed();
+		return m_ringBuffer->Write(static_cast<uint8_t*>(data.ToPointer()), count);
+	}
+
+	AudioRingBufferRegion AudioRingBuffer::BeginRead(int count)
+	{
+		CheckIfDisposed();
+
+		uint8_t *first, *second;
+		int firstLength, secondLength;
+		m_ringBuffer->BeginRead(count, &first, &firstLength, &second, &secondLength);
+
+		AudioRingBufferRegion region;
+		region.First = IntPtr(first);
+		region.FirstLength = firstLength;
+		region.Second = IntPtr(second);
+		region.SecondLength = secondLength;
+		return region;
+	}
+
+	void AudioRingBuffer::EndRead(int count)
+	{
+		CheckIfDisposed();
+		m_ringBuffer->EndRead(count);
+	}
+
+	int AudioRingBuffer::Read(IntPtr data, int count)
+	{
+		CheckIfDisposed();
+		return m_ringBuffer->Read(static_cast<uint8_t*>(data.ToPointer()), count);
+	}
+
+	void AudioRingBuffer::Advance(int count)
+	{
+		CheckIfDisposed();
+
+		uint8_t *first, *second;
+		int firstLength, secondLength;
+		m_ringBuffer->EndRead(m_ringBuffer->BeginRead(count, &first, &firstLength, &second, &secondLength));
+	}
+
+	void AudioRingBuffer::Clear()
+	{
+		CheckIfDisposed();
+		Advance(m_ringBuffer->Capacity());
+	}
+}
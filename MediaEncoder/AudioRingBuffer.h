@@ -0,0 +1,130 @@
+#pragma once
+
+using namespace System;
+using namespace IO;
+
+namespace MediaEncoder
+{
+	// Single-producer/single-consumer byte ring.
+	// Positions are monotonic byte counters; the producer only writes m_writePosition and the consumer only
+	// writes m_readPosition, so no lock is needed. Each side also keeps a cached copy of the other side's
+	// position on its own cache line to avoid bouncing the shared line on every call.
+	class SpscRingBuffer
+	{
+	public:
+		static SpscRingBuffer* Create(int capacity);
+		static void Destroy(SpscRingBuffer* ringBuffer);
+
+		int Capacity() const { return m_capacity; }
+		int Count() const;
+
+		int BeginWrite(int count, uint8_t** first, int* firstLength, uint8_t** second, int* secondLength);
+		void EndWrite(int count);
+		int BeginRead(int count, uint8_t** first, int* firstLength, uint8_t** second, int* secondLength);
+		void EndRead(int count);
+
+		int Write(const uint8_t* src, int count);
+		int Read(uint8_t* dest, int count);
+
+	private:
+		SpscRingBuffer() = default;
+
+		__declspec(align(64)) volatile LONG64 m_writePosition;
+		LONG64 m_cachedReadPosition;
+		__declspec(align(64)) volatile LONG64 m_readPosition;
+		LONG64 m_cachedWritePosition;
+		__declspec(align(64)) uint8_t* m_buffer;
+		int m_capacity;
+	};
+
+	public value struct AudioRingBufferRegion
+	{
+		IntPtr First;
+		int FirstLength;
+		IntPtr Second;
+		int SecondLength;
+
+		property int Length
+		{
+			int get()
+			{
+				return FirstLength + SecondLength;
+			}
+		}
+	};
+
+	public ref class AudioRingBuffer : IDisposable
+	{
+	private:
+		SpscRingBuffer* m_ringBuffer;
+		bool m_disposed;
+
+		void CheckIfDisposed()
+		{
+			if (m_disposed)
+				throw gcnew ObjectDisposedException("The object was already disposed.");
+		}
+
+	protected:
+		!AudioRingBuffer()
+		{
+			if (m_ringBuffer != nullptr)
+			{
+				SpscRingBuffer::Destroy(m_ringBuffer);
+				m_ringBuffer = nullptr;
+			}
+		}
+
+	public:
+		AudioRingBuffer(int size);
+
+		~AudioRingBuffer()
+		{
+			this->!AudioRingBuffer();
+			m_disposed = true;
+		}
+
+	internal:
+		property SpscRingBuffer* NativeRingBuffer
+		{
+			SpscRingBuffer* get()
+			{
+				CheckIfDisposed();
+				return m_ringBuffer;
+			}
+		}
+
+	public:
+		// Producer side. BeginWrite hands out up to count free bytes (two regions when the ring wraps),
+		// EndWrite publishes the bytes that were actually written.
+		AudioRingBufferRegion BeginWrite(int count);
+		void EndWrite(int count);
+		int Write(IntPtr data, int count);
+
+		// Consumer side. BeginRead hands out up to count readable bytes in place, EndRead releases them.
+		AudioRingBufferRegion BeginRead(int count);
+		void EndRead(int count);
+		int Read(IntPtr data, int count);
+		void Advance(int count);
+		void Clear();
+
+	public:
+		property int MaxLength
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_ringBuffer->Capacity();
+			}
+		}
+
+		property int Count
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_ringBuffer->Count();
+			}
+		}
+	};
+}
@@ -0,0 +1,310 @@
+#include "pch.h"
+#include "ChromaKeyFilter.h"
+#include "ParallelRows.h"
+
+#include <immintrin.h>
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	// cb_v4 and cr_v4 of the shader
+	static const float CbR = -0.100644f, CbG = -0.338572f, CbB = 0.439216f, CbW = 0.501961f;
+	static const float CrR = 0.439216f, CrG = -0.398942f, CrB = -0.040274f, CrW = 0.501961f;
+	static const float Unorm = 1.0f / 255.0f;
+
+	struct ChromaKeyContext
+	{
+		const uint8_t* src;
+		int srcStride;
+		uint8_t* dst;
+		int dstStride;
+		int width, height;
+		float keyX, keyY; // chroma_key as uploaded by ChromaKeyFilterShader
+		float similarity, smoothness, spill;
+		float opacity, contrast, brightness, gamma;
+		bool avx2;
+	};
+
+	static inline float Saturate(float value)
+	{
+		return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	}
+
+	static inline void TexelChroma(const ChromaKeyContext* c, int x, int y, float* cr, float* cb)
+	{
+		// Clamp addressing
+		x = x < 0 ? 0 : (x >= c->width ? c->width - 1 : x);
+		y = y < 0 ? 0 : (y >= c->height ? c->height - 1 : y);
+		const uint8_t* p = c->src + static_cast<ptrdiff_t>(y) * c->srcStride + x * 4;
+		float b = p[0] * Unorm, g = p[1] * Unorm, r = p[2] * Unorm;
+		*cb = r * CbR + g * CbG + b * CbB + CbW;
+		*cr = r * CrR + g * CrG + b * CrB + CrW;
+	}
+
+	static inline float ChromaDist(const ChromaKeyContext* c, float cr, float cb)
+	{
+		float dx = c->keyX - cr, dy = c->keyY - cb;
+		return sqrtf(dx * dx + dy * dy);
+	}
+
+	// The shader samples half a texel off the centers with a linear sampler, i.e. the mean of two texels; cb/cr
+	// are linear in rgb, so the mean of their chroma is the chroma of their mean.
+	static inline float TapDist(const ChromaKeyContext* c, int x0, int y0, int x1, int y1)
+	{
+		float cr0, cb0, cr1, cb1;
+		TexelChroma(c, x0, y0, &cr0, &cb0);
+		TexelChroma(c, x1, y1, &cr1, &cb1);
+		return ChromaDist(c, 0.5f * (cr0 + cr1), 0.5f * (cb0 + cb1));
+	}
+
+	static void ChromaKeyPixelC(const ChromaKeyContext* c, int x, int y)
+	{
+		float dist = TapDist(c, x - 1, y, x - 1, y - 1) + TapDist(c, x + 1, y, x + 1, y + 1) +
+			TapDist(c, x - 1, y + 1, x, y + 1) + TapDist(c, x, y - 1, x + 1, y - 1);
+		float cr, cb;
+		TexelChroma(c, x, y, &cr, &cb);
+		dist = (dist * 2.0f + ChromaDist(c, cr, cb)) / 9.0f;
+
+		float baseMask = dist - c->similarity;
+		float fullMask = Saturate(baseMask / c->smoothness);
+		fullMask *= sqrtf(fullMask);
+		float spillVal = Saturate(baseMask / c->spill);
+		spillVal *= sqrtf(spillVal);
+
+		const uint8_t* p = c->src + static_cast<ptrdiff_t>(y) * c->srcStride + x * 4;
+		float b = p[0] * Unorm, g = p[1] * Unorm, r = p[2] * Unorm, a = p[3] * Unorm;
+		a *= c->opacity * fullMask;
+		float desat = r * 0.2126f + g * 0.7152f + b * 0.0722f;
+		r = desat + (r - desat) * spillVal;
+		g = desat + (g - desat) * spillVal;
+		b = desat + (b - desat) * spillVal;
+		if (c->gamma != 1.0f)
+		{
+			r = powf(r, c->gamma);
+			g = powf(g, c->gamma);
+			b = powf(b, c->gamma);
+		}
+		r = r * c->contrast + c->brightness;
+		g = g * c->contrast + c->brightness;
+		b = b * c->contrast + c->brightness;
+
+		uint8_t* q = c->dst + static_cast<ptrdiff_t>(y) * c->dstStride + x * 4;
+		q[0] = static_cast<uint8_t>(lrintf(Saturate(b) * 255.0f));
+		q[1] = static_cast<uint8_t>(lrintf(Saturate(g) * 255.0f));
+		q[2] = static_cast<uint8_t>(lrintf(Saturate(r) * 255.0f));
+		q[3] = static_cast<uint8_t>(lrintf(Saturate(a) * 255.0f));
+	}
+
+	static inline __m256 Channel(__m256i pixels, int shift)
+	{
+		__m256i value = _mm256_and_si256(_mm256_srli_epi32(pixels, shift), _mm256_set1_epi32(0xFF));
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(value), _mm256_set1_ps(Unorm));
+	}
+
+	static inline void Chroma8(const uint8_t* p, __m256* cr, __m256* cb)
+	{
+		__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256 b = Channel(pixels, 0), g = Channel(pixels, 8), r = Channel(pixels, 16);
+		*cb = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(CbR)),
+		                                                _mm256_mul_ps(g, _mm256_set1_ps(CbG))),
+		                                  _mm256_mul_ps(b, _mm256_set1_ps(CbB))), _mm256_set1_ps(CbW));
+		*cr = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(CrR)),
+		                                                _mm256_mul_ps(g, _mm256_set1_ps(CrG))),
+		                                  _mm256_mul_ps(b, _mm256_set1_ps(CrB))), _mm256_set1_ps(CrW));
+	}
+
+	static inline __m256 Dist8(const ChromaKeyContext* c, __m256 cr, __m256 cb)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_set1_ps(c->keyX), cr);
+		__m256 dy = _mm256_sub_ps(_mm256_set1_ps(c->keyY), cb);
+		return _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+	}
+
+	static inline __m256 TapDist8(const ChromaKeyContext* c, const uint8_t* p0, const uint8_t* p1)
+	{
+		const __m256 half = _mm256_set1_ps(0.5f);
+		__m256 cr0, cb0, cr1, cb1;
+		Chroma8(p0, &cr0, &cb0);
+		Chroma8(p1, &cr1, &cb1);
+		return Dist8(c, _mm256_mul_ps(half, _mm256_add_ps(cr0, cr1)), _mm256_mul_ps(half, _mm256_add_ps(cb0, cb1)));
+	}
+
+	static inline __m256 Saturate8(__m256 value)
+	{
+		return _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	}
+
+	static inline __m256i Unorm8(__m256 value, int shift)
+	{
+		__m256i result = _mm256_cvtps_epi32(_mm256_mul_ps(Saturate8(value), _mm256_set1_ps(255.0f)));
+		return _mm256_slli_epi32(result, shift);
+	}
+
+	// Eight pixels starting at x, all of whose neighbours are inside the frame; same operation order as
+	// ChromaKeyPixelC, so the results only differ where pow is involved.
+	static void ChromaKeyPixels8Avx2(const ChromaKeyContext* c, int x, int y)
+	{
+		const uint8_t* row = c->src + static_cast<ptrdiff_t>(y) * c->srcStride + x * 4;
+		const uint8_t* up = row - c->srcStride;
+		const uint8_t* down = row + c->srcStride;
+
+		__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(TapDist8(c, row - 4, up - 4), TapDist8(c, row + 4,
+			                                                        down + 4)), TapDist8(c, down - 4, down)),
+		                            TapDist8(c, up, up + 4));
+		__m256 cr, cb;
+		Chroma8(row, &cr, &cb);
+		dist = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(dist, _mm256_set1_ps(2.0f)), Dist8(c, cr, cb)),
+		                     _mm256_set1_ps(9.0f));
+
+		__m256 baseMask = _mm256_sub_ps(dist, _mm256_set1_ps(c->similarity));
+		__m256 fullMask = Saturate8(_mm256_div_ps(baseMask, _mm256_set1_ps(c->smoothness)));
+		fullMask = _mm256_mul_ps(fullMask, _mm256_sqrt_ps(fullMask));
+		__m256 spillVal = Saturate8(_mm256_div_ps(baseMask, _mm256_set1_ps(c->spill)));
+		spillVal = _mm256_mul_ps(spillVal, _mm256_sqrt_ps(spillVal));
+
+		__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+		__m256 b = Channel(pixels, 0), g = Channel(pixels, 8), r = Channel(pixels, 16), a = Channel(pixels, 24);
+		a = _mm256_mul_ps(a, _mm256_mul_ps(_mm256_set1_ps(c->opacity), fullMask));
+		__m256 desat = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(0.2126f)),
+		                                           _mm256_mul_ps(g, _mm256_set1_ps(0.7152f))),
+		                             _mm256_mul_ps(b, _mm256_set1_ps(0.0722f)));
+		r = _mm256_add_ps(desat, _mm256_mul_ps(_mm256_sub_ps(r, desat), spillVal));
+		g = _mm256_add_ps(desat, _mm256_mul_ps(_mm256_sub_ps(g, desat), spillVal));
+		b = _mm256_add_ps(desat, _mm256_mul_ps(_mm256_sub_ps(b, desat), spillVal));
+		if (c->gamma != 1.0f)
+		{
+			__m256 gamma = _mm256_set1_ps(c->gamma);
+			r = _mm256_pow_ps(r, gamma);
+			g = _mm256_pow_ps(g, gamma);
+			b = _mm256_pow_ps(b, gamma);
+		}
+		__m256 contrast = _mm256_set1_ps(c->contrast), brightness = _mm256_set1_ps(c->brightness);
+		r = _mm256_add_ps(_mm256_mul_ps(r, contrast), brightness);
+		g = _mm256_add_ps(_mm256_mul_ps(g, contrast), brightness);
+		b = _mm256_add_ps(_mm256_mul_ps(b, contrast), brightness);
+
+		__m256i result = _mm256_or_si256(_mm256_or_si256(Unorm8(b, 0), Unorm8(g, 8)),
+		                                 _mm256_or_si256(Unorm8(r, 16), Unorm8(a, 24)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(c->dst + static_cast<ptrdiff_t>(y) * c->dstStride + x * 4),
+		                    result);
+	}
+
+	static void ChromaKeyRows(void* context, int firstRow, int lastRow)
+	{
+		auto c = static_cast<const ChromaKeyContext*>(context);
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			int x = 0;
+			if (c->avx2 && y > 0 && y < c->height - 1)
+			{
+				// column 0 and the last column need clamping, everything between goes eight at a time
+				ChromaKeyPixelC(c, 0, y);
+				for (x = 1; x + 8 <= c->width - 1; x += 8)
+					ChromaKeyPixels8Avx2(c, x, y);
+			}
+			for (; x < c->width; x++)
+				ChromaKeyPixelC(c, x, y);
+		}
+	}
+
+	struct CopyRowsContext
+	{
+		const uint8_t* src;
+		int srcStride;
+		uint8_t* dst;
+		int dstStride;
+		int bytes;
+	};
+
+	static void CopyRows(void* context, int firstRow, int lastRow)
+	{
+		auto c = static_cast<const CopyRowsContext*>(context);
+		for (int y = firstRow; y < lastRow; y++)
+			memcpy(c->dst + static_cast<ptrdiff_t>(y) * c->dstStride, c->src + static_cast<ptrdiff_t>(y) * c->srcStride,
+			       c->bytes);
+	}
+
+	static bool HasAvx2()
+	{
+		return (av_get_cpu_flags() & AV_CPU_FLAG_AVX2) != 0;
+	}
+
+	static float SrgbToLinear(float value)
+	{
+		return static_cast<float>(value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4));
+	}
+#pragma managed(pop)
+
+	ChromaKeyFilter::ChromaKeyFilter()
+		: m_source(nullptr), m_sourceSize(0), m_keyColor(Color::FromArgb(0, 255, 0)), m_opacity(1.0f),
+		  m_contrast(1.0f), m_brightness(0.0f), m_gamma(1.0f), m_similarity(0.4f), m_smoothness(0.08f),
+		  m_spill(0.1f), m_disposed(false)
+	{
+	}
+
+	String^ ChromaKeyFilter::Kernel::get()
+	{
+		return HasAvx2() ? "avx2" : "c";
+	}
+
+	void ChromaKeyFilter::Apply(VideoFrame^ frame)
+	{
+		CheckIfDisposed();
+		if (frame == nullptr)
+			throw gcnew ArgumentNullException("frame");
+
+		auto avFrame = static_cast<AVFrame*>(frame->NativePointer.ToPointer());
+		if (avFrame->format != AV_PIX_FMT_BGRA)
+			throw gcnew NotSupportedException("ChromaKeyFilter needs a BGRA frame.");
+		if (av_frame_make_writable(avFrame) < 0)
+			throw gcnew OutOfMemoryException("av_frame_make_writable");
+
+		// every output pixel reads its neighbours, so the filter reads from a copy of the frame
+		int rowBytes = avFrame->width * 4;
+		int size = rowBytes * avFrame->height;
+		if (m_sourceSize < size)
+		{
+			av_free(m_source);
+			m_source = static_cast<uint8_t*>(av_malloc(size));
+			m_sourceSize = m_source != nullptr ? size : 0;
+			if (m_source == nullptr)
+				throw gcnew OutOfMemoryException("av_malloc");
+		}
+
+		CopyRowsContext copy;
+		copy.src = avFrame->data[0];
+		copy.srcStride = avFrame->linesize[0];
+		copy.dst = m_source;
+		copy.dstStride = rowBytes;
+		copy.bytes = rowBytes;
+		ParallelRows(avFrame->height, 64, CopyRows, &copy);
+
+		// the key is linearized and projected the same way ChromaKeyFilterShader uploads it (red in X)
+		float keyR = SrgbToLinear(m_keyColor.R / 255.0f);
+		float keyG = SrgbToLinear(m_keyColor.G / 255.0f);
+		float keyB = SrgbToLinear(m_keyColor.B / 255.0f);
+
+		ChromaKeyContext context;
+		context.src = m_source;
+		context.srcStride = rowBytes;
+		context.dst = avFrame->data[0];
+		context.dstStride = avFrame->linesize[0];
+		context.width = avFrame->width;
+		context.height = avFrame->height;
+		context.keyX = keyR * CbR + keyG * CbG + keyB * CbB + CbW;
+		context.keyY = keyR * CrR + keyG * CrG + keyB * CrB + CrW;
+		context.similarity = m_similarity;
+		context.smoothness = m_smoothness;
+		context.spill = m_spill;
+		context.opacity = m_opacity;
+		context.contrast = m_contrast;
+		context.brightness = m_brightness;
+		context.gamma = m_gamma;
+		context.avx2 = HasAvx2();
+		ParallelRows(avFrame->height, 16, ChromaKeyRows, &context);
+	}
+}
@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "ClockDriftEstimator.h"
+
+namespace MediaEncoder
+{
+	// time constant of the exponential weighting
+	static const double DriftTimeConstantSeconds = 60.0;
+	// a delivery gap longer than this is treated as a pause of the device
+	static const double DriftPauseSeconds = 0.25;
+	// do not report anything until the fit covers this much time
+	static const double DriftWarmUpSeconds = 5.0;
+	// rates further off than this are measurement errors, not clock drift
+	static const double DriftMaxDeviation = 0.02;
+
+	ClockDriftEstimator::ClockDriftEstimator(int nominalSampleRate) : m_nominalSampleRate(nominalSampleRate)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		m_frequency = frequency.QuadPart;
+		Reset();
+	}
+
+	void ClockDriftEstimator::Reset()
+	{
+		m_startTime = 0;
+		m_lastTime = 0;
+		m_pausedSeconds = 0;
+		m_totalSamples = 0;
+		m_sumWeight = m_sumTime = m_sumSamples = m_sumTimeTime = m_sumTimeSamples = 0;
+		m_lastSeconds = 0;
+		m_ratio = 1.0;
+		m_hasEstimate = false;
+	}
+
+	void ClockDriftEstimator::Update(int samples)
+	{
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		LONGLONG now = counter.QuadPart;
+
+		if (m_startTime == 0)
+		{
+			// the first packet only marks the start of the timeline
+			m_startTime = now;
+			m_lastTime = now;
+			return;
+		}
+
+		double sinceLast = static_cast<double>(now - m_lastTime) / m_frequency;
+		if (sinceLast > DriftPauseSeconds)
+		{
+			m_pausedSeconds += sinceLast;
+		}
+		m_lastTime = now;
+		m_totalSamples += samples;
+
+		double seconds = static_cast<double>(now - m_startTime) / m_frequency - m_pausedSeconds;
+		double decay = exp(-(seconds - m_lastSeconds) / DriftTimeConstantSeconds);
+		m_lastSeconds = seconds;
+
+		m_sumWeight = m_sumWeight * decay + 1.0;
+		m_sumTime = m_sumTime * decay + seconds;
+		m_sumSamples = m_sumSamples * decay + m_totalSamples;
+		m_sumTimeTime = m_sumTimeTime * decay + seconds * seconds;
+		m_sumTimeSamples = m_sumTimeSamples * decay + seconds * m_totalSamples;
+
+		if (seconds < DriftWarmUpSeconds)
+			return;
+
+		double denominator = m_sumWeight * m_sumTimeTime - m_sumTime * m_sumTime;
+		if (denominator <= 0)
+			return;
+
+		double ratio = (m_sumWeight * m_sumTimeSamples - m_sumTime * m_sumSamples) / denominator / m_nominalSampleRate;
+		if (fabs(ratio - 1.0) <= DriftMaxDeviation)
+		{
+			m_ratio = ratio;
+			m_hasEstimate = true;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+using namespace System;
+
+namespace MediaEncoder
+{
+	// Estimates the real sample rate of a capture device against QueryPerformanceCounter.
+	// Delivered samples are fitted to elapsed time with an exponentially weighted least squares line,
+	// which averages out the burstiness of packet delivery. Pauses in delivery (a silent loopback device
+	// stops sending packets) are cut out of the timeline instead of being counted as a slow clock.
+	public ref class ClockDriftEstimator
+	{
+	private:
+		int m_nominalSampleRate;
+		LONGLONG m_frequency;
+		LONGLONG m_startTime, m_lastTime;
+		double m_pausedSeconds;
+		double m_totalSamples;
+		double m_sumWeight, m_sumTime, m_sumSamples, m_sumTimeTime, m_sumTimeSamples;
+		double m_lastSeconds;
+		double m_ratio;
+		bool m_hasEstimate;
+
+	public:
+		ClockDriftEstimator(int nominalSampleRate);
+
+		void Update(int samples);
+		void Reset();
+
+	public:
+		property int NominalSampleRate
+		{
+			int get()
+			{
+				return m_nominalSampleRate;
+			}
+		}
+
+		property bool HasEstimate
+		{
+			bool get()
+			{
+				return m_hasEstimate;
+			}
+		}
+
+		// observed rate / nominal rate
+		property double Ratio
+		{
+			double get()
+			{
+				return m_hasEstimate ? m_ratio : 1.0;
+			}
+		}
+
+		property double ObservedSampleRate
+		{
+			double get()
+			{
+				return Ratio * m_nominalSampleRate;
+			}
+		}
+
+		property double DriftPpm
+		{
+			double get()
+			{
+				return (Ratio - 1.0) * 1000000.0;
+			}
+		}
+	};
+}
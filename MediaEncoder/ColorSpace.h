@@ -0,0 +1,18 @@
+#pragma once
+
+#include "pch.h"
+
+namespace MediaEncoder
+{
+	public enum class ColorSpace
+	{
+		BT601 = AVCOL_SPC_SMPTE170M,
+		BT709 = AVCOL_SPC_BT709,
+	};
+
+	public enum class ColorRange
+	{
+		Limited = AVCOL_RANGE_MPEG,
+		Full = AVCOL_RANGE_JPEG,
+	};
+}
@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "Compositor.h"
+
+#include <emmintrin.h>
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	static inline uint8_t Div255(int value)
+	{
+		return static_cast<uint8_t>((value + 128 + ((value + 128) >> 8)) >> 8);
+	}
+
+	// (x + 128 + ((x + 128) >> 8)) >> 8 is x / 255 rounded for every x up to 255 * 255.
+	static inline __m128i Div255(__m128i value)
+	{
+		value = _mm_add_epi16(value, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+	}
+
+	// "over" onto an opaque destination: dst = src * a + dst * (1 - a), alpha stays opaque.
+	static void BlendRowC(uint8_t* dst, const uint8_t* src, int count, int opacity, bool useAlpha)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			int a = useAlpha ? Div255(src[3] * opacity) : opacity;
+			dst[0] = Div255(src[0] * a + dst[0] * (255 - a));
+			dst[1] = Div255(src[1] * a + dst[1] * (255 - a));
+			dst[2] = Div255(src[2] * a + dst[2] * (255 - a));
+			dst[3] = 255;
+			src += 4;
+			dst += 4;
+		}
+	}
+
+	// Four pixels per iteration, two per 16-bit half; identical results to BlendRowC.
+	static void BlendRowSse2(uint8_t* dst, const uint8_t* src, int count, int opacity, bool useAlpha)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16(255);
+		const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+		const __m128i opacityVec = _mm_set1_epi16(static_cast<short>(opacity));
+
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i * 4));
+			__m128i sLo = _mm_unpacklo_epi8(s, zero);
+			__m128i sHi = _mm_unpackhi_epi8(s, zero);
+			__m128i dLo = _mm_unpacklo_epi8(d, zero);
+			__m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+			__m128i aLo = opacityVec;
+			__m128i aHi = opacityVec;
+			if (useAlpha)
+			{
+				// broadcast each pixel's alpha to its four lanes
+				aLo = Div255(_mm_mullo_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, 0xFF), 0xFF), opacityVec));
+				aHi = Div255(_mm_mullo_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, 0xFF), 0xFF), opacityVec));
+			}
+
+			__m128i tLo = _mm_add_epi16(_mm_mullo_epi16(sLo, aLo), _mm_mullo_epi16(dLo, _mm_sub_epi16(full, aLo)));
+			__m128i tHi = _mm_add_epi16(_mm_mullo_epi16(sHi, aHi), _mm_mullo_epi16(dHi, _mm_sub_epi16(full, aHi)));
+			__m128i result = _mm_or_si128(_mm_packus_epi16(Div255(tLo), Div255(tHi)), opaque);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), result);
+		}
+
+		BlendRowC(dst + i * 4, src + i * 4, count - i, opacity, useAlpha);
+	}
+
+	static void BlendRect(uint8_t* dst, int dstStride, const uint8_t* src, int srcStride, int width, int height,
+	                      int opacity, bool useAlpha)
+	{
+		bool copy = opacity == 255 && !useAlpha;
+		for (int y = 0; y < height; y++)
+		{
+			if (copy)
+				memcpy(dst, src, static_cast<size_t>(width) * 4);
+			else
+				BlendRowSse2(dst, src, width, opacity, useAlpha);
+			dst += dstStride;
+			src += srcStride;
+		}
+	}
+
+	static void FillRect(uint8_t* dst, int dstStride, int width, int height, uint32_t color)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			auto row = reinterpret_cast<uint32_t*>(dst);
+			for (int x = 0; x < width; x++)
+				row[x] = color;
+			dst += dstStride;
+		}
+	}
+#pragma managed(pop)
+
+	Compositor::Compositor(int width, int height)
+		: m_nextLayerId(0), m_backgroundColor(static_cast<int>(0xFF000000)), m_disposed(false)
+	{
+		if (width <= 0)
+			throw gcnew ArgumentOutOfRangeException("width");
+		if (height <= 0)
+			throw gcnew ArgumentOutOfRangeException("height");
+
+		m_canvas = gcnew VideoFrame(width, height, PixelFormat::BGRA);
+		m_layers = gcnew List<CompositorLayer^>();
+		m_dirtyRects = gcnew List<Rectangle>();
+		m_scaler = gcnew Scaler(4);
+		Invalidate(Rectangle(0, 0, width, height));
+	}
+
+	Compositor::~Compositor()
+	{
+		if (m_disposed)
+			return;
+
+		for each (CompositorLayer^ layer in m_layers)
+			delete layer->Pixels;
+		m_layers->Clear();
+		delete m_scaler;
+		delete m_canvas;
+		m_disposed = true;
+	}
+
+	CompositorLayer^ Compositor::GetLayer(int layer)
+	{
+		for each (CompositorLayer^ item in m_layers)
+		{
+			if (item->Id == layer)
+				return item;
+		}
+		throw gcnew ArgumentException("The layer does not exist.", "layer");
+	}
+
+	void Compositor::Invalidate(Rectangle rect)
+	{
+		rect = Rectangle::Intersect(rect, Rectangle(0, 0, m_canvas->Width, m_canvas->Height));
+		if (rect.Width <= 0 || rect.Height <= 0)
+			return;
+
+		// overlapping rects are merged so no pixel is blended twice in one Compose
+		for (int i = 0; i < m_dirtyRects->Count; i++)
+		{
+			if (m_dirtyRects[i].IntersectsWith(rect))
+			{
+				rect = Rectangle::Union(rect, m_dirtyRects[i]);
+				m_dirtyRects->RemoveAt(i);
+				i = -1;
+			}
+		}
+
+		if (m_dirtyRects->Count >= 16)
+		{
+			for each (Rectangle dirtyRect in m_dirtyRects)
+				rect = Rectangle::Union(rect, dirtyRect);
+			m_dirtyRects->Clear();
+		}
+		m_dirtyRects->Add(rect);
+	}
+
+	int Compositor::AddLayer(int x, int y, int width, int height)
+	{
+		CheckIfDisposed();
+		if (width <= 0)
+			throw gcnew ArgumentOutOfRangeException("width");
+		if (height <= 0)
+			throw gcnew ArgumentOutOfRangeException("height");
+
+		auto layer = gcnew CompositorLayer();
+		layer->Id = m_nextLayerId++;
+		layer->Bounds = Rectangle(x, y, width, height);
+		layer->Opacity = 255;
+		layer->UseAlpha = false;
+		layer->Pixels = nullptr;
+		m_layers->Add(layer);
+		return layer->Id;
+	}
+
+	void Compositor::RemoveLayer(int layer)
+	{
+		CheckIfDisposed();
+
+		CompositorLayer^ item = GetLayer(layer);
+		if (item->Pixels != nullptr)
+		{
+			Invalidate(item->Bounds);
+			delete item->Pixels;
+		}
+		m_layers->Remove(item);
+	}
+
+	void Compositor::SetLayerBounds(int layer, int x, int y, int width, int height)
+	{
+		CheckIfDisposed();
+		if (width <= 0)
+			throw gcnew ArgumentOutOfRangeException("width");
+		if (height <= 0)
+			throw gcnew ArgumentOutOfRangeException("height");
+
+		CompositorLayer^ item = GetLayer(layer);
+		Rectangle bounds(x, y, width, height);
+		if (item->Bounds == bounds)
+			return;
+
+		if (item->Pixels != nullptr)
+		{
+			Invalidate(item->Bounds);
+			if (item->Bounds.Size != bounds.Size)
+			{
+				// until the next UpdateLayer the cached content is shown rescaled
+				auto pixels = gcnew VideoFrame(width, height, PixelFormat::BGRA);
+				m_scaler->Convert(item->Pixels, pixels);
+				delete item->Pixels;
+				item->Pixels = pixels;
+			}
+			Invalidate(bounds);
+		}
+		item->Bounds = bounds;
+	}
+
+	void Compositor::SetLayerBlend(int layer, float opacity, bool useAlpha)
+	{
+		CheckIfDisposed();
+
+		CompositorLayer^ item = GetLayer(layer);
+		int value = static_cast<int>(lrintf((opacity < 0.0f ? 0.0f : (opacity > 1.0f ? 1.0f : opacity)) * 255.0f));
+		if (item->Opacity == value && item->UseAlpha == useAlpha)
+			return;
+
+		item->Opacity = value;
+		item->UseAlpha = useAlpha;
+		if (item->Pixels != nullptr)
+			Invalidate(item->Bounds);
+	}
+
+	void Compositor::UpdateLayer(int layer, VideoFrame^ frame)
+	{
+		CheckIfDisposed();
+		if (frame == nullptr)
+			throw gcnew ArgumentNullException("frame");
+
+		CompositorLayer^ item = GetLayer(layer);
+		if (item->Pixels == nullptr)
+			item->Pixels = gcnew VideoFrame(item->Bounds.Width, item->Bounds.Height, PixelFormat::BGRA);
+
+		if (frame->Width == item->Bounds.Width && frame->Height == item->Bounds.Height && frame->PixelFormat ==
+			PixelFormat::BGRA)
+		{
+			av_frame_copy(static_cast<AVFrame*>(item->Pixels->NativePointer.ToPointer()),
+			              static_cast<AVFrame*>(frame->NativePointer.ToPointer()));
+		}
+		else if (!m_scaler->Convert(frame, item->Pixels))
+		{
+			throw gcnew IOException("Scaler::Convert");
+		}
+		Invalidate(item->Bounds);
+	}
+
+	void Compositor::ComposeRect(Rectangle rect)
+	{
+		auto canvas = static_cast<AVFrame*>(m_canvas->NativePointer.ToPointer());
+
+		// everything below the topmost opaque layer that covers the whole rect is hidden
+		int first = 0;
+		bool covered = false;
+		for (int i = m_layers->Count - 1; i >= 0 && !covered; i--)
+		{
+			CompositorLayer^ layer = m_layers[i];
+			if (layer->Pixels != nullptr && layer->Opacity == 255 && !layer->UseAlpha && layer->Bounds.Contains(rect))
+			{
+				first = i;
+				covered = true;
+			}
+		}
+
+		if (!covered)
+		{
+			FillRect(canvas->data[0] + static_cast<ptrdiff_t>(rect.Y) * canvas->linesize[0] + rect.X * 4,
+			         canvas->linesize[0], rect.Width, rect.Height,
+			         static_cast<uint32_t>(m_backgroundColor) | 0xFF000000);
+		}
+
+		for (int i = first; i < m_layers->Count; i++)
+		{
+			CompositorLayer^ layer = m_layers[i];
+			if (layer->Pixels == nullptr || layer->Opacity == 0)
+				continue;
+
+			Rectangle part = Rectangle::Intersect(rect, layer->Bounds);
+			if (part.Width <= 0 || part.Height <= 0)
+				continue;
+
+			auto pixels = static_cast<AVFrame*>(layer->Pixels->NativePointer.ToPointer());
+			const uint8_t* src = pixels->data[0] + static_cast<ptrdiff_t>(part.Y - layer->Bounds.Y) * pixels->
+				linesize[0] + (part.X - layer->Bounds.X) * 4;
+			uint8_t* dst = canvas->data[0] + static_cast<ptrdiff_t>(part.Y) * canvas->linesize[0] + part.X * 4;
+			BlendRect(dst, canvas->linesize[0], src, pixels->linesize[0], part.Width, part.Height, layer->Opacity,
+			          layer->UseAlpha);
+		}
+	}
+
+	bool Compositor::Compose()
+	{
+		CheckIfDisposed();
+
+		if (m_dirtyRects->Count == 0)
+			return false;
+
+		for each (Rectangle rect in m_dirtyRects)
+			ComposeRect(rect);
+		m_dirtyRects->Clear();
+		return true;
+	}
+}
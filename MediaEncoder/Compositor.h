@@ -0,0 +1,123 @@
+#pragma once
+
+using namespace System;
+using namespace Collections::Generic;
+using namespace Drawing;
+
+#include "VideoFrame.h"
+#include "Scaler.h"
+
+namespace MediaEncoder
+{
+	// One source placed on the canvas. Pixels holds the source already scaled to Bounds, so recomposing a
+	// region never touches the scaler.
+	private ref class CompositorLayer
+	{
+	public:
+		int Id;
+		Rectangle Bounds;
+		int Opacity; // 0..255
+		bool UseAlpha;
+		VideoFrame^ Pixels;
+	};
+
+	// Headless compositor that alpha-blends any number of VideoFrame layers onto an opaque BGRA canvas.
+	// Layers are blended in the order they were added. Only the regions touched by layers that changed since the
+	// last Compose are recomposed, so a static layer costs nothing until something above or below it moves.
+	public ref class Compositor : IDisposable
+	{
+	private:
+		VideoFrame^ m_canvas;
+		List<CompositorLayer^>^ m_layers;
+		List<Rectangle>^ m_dirtyRects;
+		Scaler^ m_scaler;
+		int m_nextLayerId;
+		int m_backgroundColor;
+		bool m_disposed;
+
+		void CheckIfDisposed()
+		{
+			if (m_disposed)
+				throw gcnew ObjectDisposedException("The object was already disposed.");
+		}
+
+		CompositorLayer^ GetLayer(int layer);
+		void Invalidate(Rectangle rect);
+		void ComposeRect(Rectangle rect);
+
+	public:
+		Compositor(int width, int height);
+
+		~Compositor();
+
+		// Adds a layer above the existing ones and returns its id. The layer stays empty until UpdateLayer.
+		int AddLayer(int x, int y, int width, int height);
+		void RemoveLayer(int layer);
+		void SetLayerBounds(int layer, int x, int y, int width, int height);
+
+		// opacity is multiplied with the source alpha when useAlpha is set; otherwise the source alpha channel
+		// is ignored, which is what captured desktops need.
+		void SetLayerBlend(int layer, float opacity, bool useAlpha);
+
+		// Scales (or copies) frame into the layer's own buffer; the caller may reuse frame right away.
+		void UpdateLayer(int layer, VideoFrame^ frame);
+
+		// Recomposes the dirty regions; returns false when nothing changed since the last call.
+		bool Compose();
+
+	public:
+		property VideoFrame^ Canvas
+		{
+			VideoFrame^ get()
+			{
+				CheckIfDisposed();
+				return m_canvas;
+			}
+		}
+
+		property int Width
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_canvas->Width;
+			}
+		}
+
+		property int Height
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_canvas->Height;
+			}
+		}
+
+		// 0xAARRGGBB shown where no layer covers the canvas; the alpha byte is ignored.
+		property int BackgroundColor
+		{
+			int get()
+			{
+				return m_backgroundColor;
+			}
+			void set(int value)
+			{
+				CheckIfDisposed();
+				if (m_backgroundColor != value)
+				{
+					m_backgroundColor = value;
+					Invalidate(Rectangle(0, 0, m_canvas->Width, m_canvas->Height));
+				}
+			}
+		}
+
+		property int DirtyRectCount
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_dirtyRects->Count;
+			}
+		}
+	};
+}
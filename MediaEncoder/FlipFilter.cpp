@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "FlipFilter.h"
+#include "ParallelRows.h"
+
+#include <immintrin.h>
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	struct FlipContext
+	{
+		uint8_t* data;
+		int stride;
+		int width;
+		int height;
+		bool horizontal;
+		bool vertical;
+		bool avx2;
+	};
+
+	// a[j] <-> b[j], or a[j] <-> b[width - 1 - j] when reversed; a == b reverses a single row in place.
+	static void SwapRowsC(uint32_t* a, uint32_t* b, int width, bool reversed, int from)
+	{
+		if (a == b)
+		{
+			for (int l = from, r = width - 1 - from; l < r; l++, r--)
+			{
+				uint32_t t = a[l];
+				a[l] = a[r];
+				a[r] = t;
+			}
+			return;
+		}
+
+		for (int j = from; j < width; j++)
+		{
+			uint32_t* other = reversed ? b + width - 1 - j : b + j;
+			uint32_t t = a[j];
+			a[j] = *other;
+			*other = t;
+		}
+	}
+
+	static void SwapRowsAvx2(uint32_t* a, uint32_t* b, int width, bool reversed)
+	{
+		const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+		if (a == b)
+		{
+			int l = 0, r = width;
+			for (; r - l >= 16; l += 8, r -= 8)
+			{
+				__m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + l));
+				__m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + r - 8));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(a + l), _mm256_permutevar8x32_epi32(right, reverse));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(a + r - 8), _mm256_permutevar8x32_epi32(left, reverse));
+			}
+			for (r--; l < r; l++, r--)
+			{
+				uint32_t t = a[l];
+				a[l] = a[r];
+				a[r] = t;
+			}
+			return;
+		}
+
+		// every 8-pixel chunk is read and written in the same iteration, so the rows can be swapped in place
+		int j = 0;
+		for (; j + 8 <= width; j += 8)
+		{
+			uint32_t* other = reversed ? b + width - 8 - j : b + j;
+			__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + j));
+			__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other));
+			if (reversed)
+			{
+				va = _mm256_permutevar8x32_epi32(va, reverse);
+				vb = _mm256_permutevar8x32_epi32(vb, reverse);
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(a + j), vb);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(other), va);
+		}
+		SwapRowsC(a, b, width, reversed, j);
+	}
+
+	// rows are the upper half for vertical flips (each paired with its mirror), every row otherwise
+	static void FlipRows(void* context, int firstRow, int lastRow)
+	{
+		auto c = static_cast<const FlipContext*>(context);
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			auto a = reinterpret_cast<uint32_t*>(c->data + static_cast<ptrdiff_t>(y) * c->stride);
+			auto b = c->vertical
+				         ? reinterpret_cast<uint32_t*>(c->data + static_cast<ptrdiff_t>(c->height - 1 - y) * c->stride)
+				         : a;
+			if (a == b && !c->horizontal)
+				continue;
+
+			if (c->avx2)
+				SwapRowsAvx2(a, b, c->width, c->horizontal);
+			else
+				SwapRowsC(a, b, c->width, c->horizontal, 0);
+		}
+	}
+
+	static bool HasAvx2()
+	{
+		return (av_get_cpu_flags() & AV_CPU_FLAG_AVX2) != 0;
+	}
+#pragma managed(pop)
+
+	FlipFilter::FlipFilter() : m_horizontalFlip(false), m_verticalFlip(false)
+	{
+	}
+
+	String^ FlipFilter::Kernel::get()
+	{
+		return HasAvx2() ? "avx2" : "c";
+	}
+
+	void FlipFilter::Apply(VideoFrame^ frame)
+	{
+		if (frame == nullptr)
+			throw gcnew ArgumentNullException("frame");
+		if (!m_horizontalFlip && !m_verticalFlip)
+			return;
+
+		auto avFrame = static_cast<AVFrame*>(frame->NativePointer.ToPointer());
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(avFrame->format));
+		if (desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_PLANAR) || av_get_padded_bits_per_pixel(desc) != 32)
+			throw gcnew NotSupportedException("FlipFilter needs a 32-bit packed pixel format.");
+		if (av_frame_make_writable(avFrame) < 0)
+			throw gcnew OutOfMemoryException("av_frame_make_writable");
+
+		FlipContext context;
+		context.data = avFrame->data[0];
+		context.stride = avFrame->linesize[0];
+		context.width = avFrame->width;
+		context.height = avFrame->height;
+		context.horizontal = m_horizontalFlip;
+		context.vertical = m_verticalFlip;
+		context.avx2 = HasAvx2();
+
+		// for vertical flips each band owns a set of row pairs; the middle row of an odd height is only mirrored
+		int rows = m_verticalFlip ? (avFrame->height + 1) / 2 : avFrame->height;
+		ParallelRows(rows, 32, FlipRows, &context);
+	}
+}
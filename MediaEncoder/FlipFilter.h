@@ -0,0 +1,52 @@
+#pragma once
+
+using namespace System;
+
+#include "VideoFrame.h"
+
+namespace MediaEncoder
+{
+	// CPU counterpart of FlipFilterShader for hosts without a usable D3D11 device. Works in place on frames with
+	// 32-bit packed pixels (BGRA, RGBA, BGR0, ...), rows are split across the thread pool.
+	public ref class FlipFilter
+	{
+	private:
+		bool m_horizontalFlip;
+		bool m_verticalFlip;
+
+	public:
+		FlipFilter();
+
+		void Apply(VideoFrame^ frame);
+
+		// Name of the row kernel picked for this CPU ("avx2" or "c").
+		static property String^ Kernel
+		{
+			String^ get();
+		}
+
+		property bool HorizontalFlip
+		{
+			bool get()
+			{
+				return m_horizontalFlip;
+			}
+			void set(bool value)
+			{
+				m_horizontalFlip = value;
+			}
+		}
+
+		property bool VerticalFlip
+		{
+			bool get()
+			{
+				return m_verticalFlip;
+			}
+			void set(bool value)
+			{
+				m_verticalFlip = value;
+			}
+		}
+	};
+}
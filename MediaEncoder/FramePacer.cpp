@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "FramePacer.h"
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	static int64_t QueryCounter()
+	{
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart;
+	}
+
+	FrameClock* FrameClock::Create(int rateNumerator, int rateDenominator, int64_t origin)
+	{
+		HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+		                                      TIMER_ALL_ACCESS);
+		bool highResolution = timer != nullptr;
+		if (timer == nullptr)
+			timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+		if (timer == nullptr)
+			return nullptr;
+
+		auto clock = new FrameClock();
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		clock->m_timer = timer;
+		clock->m_highResolution = highResolution;
+		clock->m_frequency = frequency.QuadPart;
+		clock->m_origin = origin;
+		clock->m_rateNumerator = rateNumerator;
+		clock->m_rateDenominator = rateDenominator;
+		clock->m_missedTicks = 0;
+
+		// start at the first tick that is not already past
+		int64_t elapsed = QueryCounter() - origin;
+		clock->m_nextIndex = elapsed <= 0
+			                     ? 0
+			                     : (elapsed * rateNumerator + frequency.QuadPart * rateDenominator - 1) /
+			                     (frequency.QuadPart * rateDenominator);
+		return clock;
+	}
+
+	void FrameClock::Destroy(FrameClock* clock)
+	{
+		if (clock == nullptr)
+			return;
+
+		CloseHandle(clock->m_timer);
+		delete clock;
+	}
+
+	int64_t FrameClock::Deadline(int64_t index) const
+	{
+		// index * frequency * denominator / numerator without overflowing on long runs
+		int64_t scale = m_frequency * m_rateDenominator;
+		return m_origin + (index / m_rateNumerator) * scale + (index % m_rateNumerator) * scale / m_rateNumerator;
+	}
+
+	bool FrameClock::Wait(DWORD timeoutMs, bool catchUp, int64_t* index, int64_t* deadline, int64_t* lateness)
+	{
+		int64_t now = QueryCounter();
+		int64_t due = Deadline(m_nextIndex);
+
+		if (!catchUp && now >= Deadline(m_nextIndex + 1))
+		{
+			int64_t latest = (now - m_origin) * m_rateNumerator / (m_frequency * m_rateDenominator);
+			m_missedTicks += latest - m_nextIndex;
+			m_nextIndex = latest;
+			due = Deadline(m_nextIndex);
+		}
+
+		if (now < due)
+		{
+			int64_t timeout = static_cast<int64_t>(timeoutMs) * m_frequency / 1000;
+			bool timedOut = due - now > timeout;
+			int64_t wakeUp = timedOut ? now + timeout : due;
+
+			// a plain timer only has scheduler resolution, so it is armed a little early and the rest is spun
+			int64_t margin = m_highResolution ? 0 : m_frequency / 500;
+			if (wakeUp - margin > now)
+			{
+				LARGE_INTEGER dueTime;
+				dueTime.QuadPart = -((wakeUp - margin - now) * 10000000 / m_frequency);
+				if (dueTime.QuadPart < 0 && SetWaitableTimerEx(m_timer, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+					WaitForSingleObject(m_timer, INFINITE);
+			}
+			if (timedOut)
+				return false;
+
+			while ((now = QueryCounter()) < due)
+				YieldProcessor();
+		}
+
+		*index = m_nextIndex;
+		*deadline = due;
+		*lateness = now - due;
+		m_nextIndex++;
+		return true;
+	}
+#pragma managed(pop)
+
+	FramePacer::FramePacer(int rateNumerator, int rateDenominator)
+		: m_clock(nullptr), m_catchUp(true), m_index(-1), m_deadline(0), m_disposed(false)
+	{
+		Initialize(rateNumerator, rateDenominator, Diagnostics::Stopwatch::GetTimestamp());
+	}
+
+	FramePacer::FramePacer(int rateNumerator, int rateDenominator, Int64 origin)
+		: m_clock(nullptr), m_catchUp(true), m_index(-1), m_deadline(0), m_disposed(false)
+	{
+		Initialize(rateNumerator, rateDenominator, origin);
+	}
+
+	void FramePacer::Initialize(int rateNumerator, int rateDenominator, Int64 origin)
+	{
+		if (rateNumerator <= 0)
+			throw gcnew ArgumentOutOfRangeException("rateNumerator");
+		if (rateDenominator <= 0)
+			throw gcnew ArgumentOutOfRangeException("rateDenominator");
+
+		m_clock = FrameClock::Create(rateNumerator, rateDenominator, origin);
+		if (m_clock == nullptr)
+			throw gcnew InvalidOperationException("CreateWaitableTimerExW");
+
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		m_frequency = frequency.QuadPart;
+		m_jitter = gcnew LatencyHistogram();
+	}
+
+	bool FramePacer::WaitNext(int millisecondsTimeout)
+	{
+		CheckIfDisposed();
+
+		DWORD timeout = millisecondsTimeout < 0 ? INFINITE : static_cast<DWORD>(millisecondsTimeout);
+		int64_t index, deadline, lateness;
+		if (!m_clock->Wait(timeout, m_catchUp, &index, &deadline, &lateness))
+			return false;
+
+		m_index = index;
+		m_deadline = deadline;
+		m_jitter->Record(lateness * 1000000 / m_frequency);
+		return true;
+	}
+
+	Int64 FramePacer::GetDeadline(Int64 index)
+	{
+		CheckIfDisposed();
+		return m_clock->Deadline(index);
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+using namespace System;
+
+#include "LatencyHistogram.h"
+
+namespace MediaEncoder
+{
+	// Deadline clock behind FramePacer. Tick n is due at origin + n / rate on the QueryPerformanceCounter
+	// timeline, so waking up late never shifts later ticks. Waits sleep on a high-resolution waitable timer
+	// (plain one with a short spin at the end on systems without it) instead of polling.
+	class FrameClock
+	{
+	public:
+		static FrameClock* Create(int rateNumerator, int rateDenominator, int64_t origin);
+		static void Destroy(FrameClock* clock);
+
+		// Waits for the next tick for at most timeoutMs. Returns false on timeout; otherwise fills in the tick's
+		// index, deadline and how late (in QPC ticks) the caller was released.
+		bool Wait(DWORD timeoutMs, bool catchUp, int64_t* index, int64_t* deadline, int64_t* lateness);
+
+		int64_t Deadline(int64_t index) const;
+		int64_t NextIndex() const { return m_nextIndex; }
+		int64_t MissedTicks() const { return m_missedTicks; }
+		bool HighResolution() const { return m_highResolution; }
+
+	private:
+		FrameClock() = default;
+
+		HANDLE m_timer;
+		bool m_highResolution;
+		int64_t m_frequency;
+		int64_t m_origin;
+		int m_rateNumerator;
+		int m_rateDenominator;
+		int64_t m_nextIndex;
+		int64_t m_missedTicks;
+	};
+
+	// Frame clock with absolute deadlines. Each WaitNext releases the caller for exactly one frame index; when
+	// the caller falls behind, the missed indices are handed out back to back (CatchUp) or skipped and counted
+	// (MissedTicks), instead of being lost silently. How late each wake-up was is recorded in Jitter.
+	public ref class FramePacer : IDisposable
+	{
+	private:
+		FrameClock* m_clock;
+		bool m_catchUp;
+		Int64 m_index;
+		Int64 m_deadline;
+		LatencyHistogram^ m_jitter;
+		LONGLONG m_frequency;
+		bool m_disposed;
+
+		void CheckIfDisposed()
+		{
+			if (m_disposed)
+				throw gcnew ObjectDisposedException("The object was already disposed.");
+		}
+
+		void Initialize(int rateNumerator, int rateDenominator, Int64 origin);
+
+	protected:
+		!FramePacer()
+		{
+			if (m_clock != nullptr)
+			{
+				FrameClock::Destroy(m_clock);
+				m_clock = nullptr;
+			}
+		}
+
+	public:
+		FramePacer(int rateNumerator, int rateDenominator);
+
+		// Pacers created with the same origin (Stopwatch ticks) and rate tick on the same grid.
+		FramePacer(int rateNumerator, int rateDenominator, Int64 origin);
+
+		~FramePacer()
+		{
+			this->!FramePacer();
+			m_disposed = true;
+		}
+
+		// Returns true once the next frame is due, false if millisecondsTimeout passed first.
+		bool WaitNext(int millisecondsTimeout);
+
+		// Stopwatch ticks at which frame index is due.
+		Int64 GetDeadline(Int64 index);
+
+		// Index and deadline of the frame released by the last successful WaitNext.
+		property Int64 Index
+		{
+			Int64 get()
+			{
+				return m_index;
+			}
+		}
+
+		property Int64 Deadline
+		{
+			Int64 get()
+			{
+				return m_deadline;
+			}
+		}
+
+		// Hand out missed frames one after another (default) instead of skipping to the latest one.
+		property bool CatchUp
+		{
+			bool get()
+			{
+				return m_catchUp;
+			}
+			void set(bool value)
+			{
+				m_catchUp = value;
+			}
+		}
+
+		property Int64 MissedTicks
+		{
+			Int64 get()
+			{
+				CheckIfDisposed();
+				return m_clock->MissedTicks();
+			}
+		}
+
+		// Lateness of each release against its deadline, in microseconds. Catch-up releases are included.
+		property LatencyHistogram^ Jitter
+		{
+			LatencyHistogram^ get()
+			{
+				return m_jitter;
+			}
+		}
+
+		property bool HighResolution
+		{
+			bool get()
+			{
+				CheckIfDisposed();
+				return m_clock->HighResolution();
+			}
+		}
+	};
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+using namespace System;
+
+namespace MediaEncoder
+{
+	// Pointers and strides of up to four planes, passed by value so that hot paths can hand them around
+	// without putting anything on the managed heap. Unused planes are IntPtr::Zero with a stride of 0.
+	public value struct FramePlanes
+	{
+		IntPtr Data0, Data1, Data2, Data3;
+		int Stride0, Stride1, Stride2, Stride3;
+
+		FramePlanes(IntPtr data0, int stride0)
+			: Data0(data0), Data1(IntPtr::Zero), Data2(IntPtr::Zero), Data3(IntPtr::Zero),
+			  Stride0(stride0), Stride1(0), Stride2(0), Stride3(0)
+		{
+		}
+
+		FramePlanes(IntPtr data0, int stride0, IntPtr data1, int stride1)
+			: Data0(data0), Data1(data1), Data2(IntPtr::Zero), Data3(IntPtr::Zero),
+			  Stride0(stride0), Stride1(stride1), Stride2(0), Stride3(0)
+		{
+		}
+
+		FramePlanes(IntPtr data0, int stride0, IntPtr data1, int stride1, IntPtr data2, int stride2)
+			: Data0(data0), Data1(data1), Data2(data2), Data3(IntPtr::Zero),
+			  Stride0(stride0), Stride1(stride1), Stride2(stride2), Stride3(0)
+		{
+		}
+
+		IntPtr GetData(int plane)
+		{
+			switch (plane)
+			{
+			case 0: return Data0;
+			case 1: return Data1;
+			case 2: return Data2;
+			case 3: return Data3;
+			default: throw gcnew ArgumentOutOfRangeException("plane");
+			}
+		}
+
+		int GetStride(int plane)
+		{
+			switch (plane)
+			{
+			case 0: return Stride0;
+			case 1: return Stride1;
+			case 2: return Stride2;
+			case 3: return Stride3;
+			default: throw gcnew ArgumentOutOfRangeException("plane");
+			}
+		}
+
+	internal:
+		static FramePlanes FromPointers(uint8_t* const data[4], const int linesize[4])
+		{
+			FramePlanes planes;
+			planes.Data0 = IntPtr(data[0]);
+			planes.Data1 = IntPtr(data[1]);
+			planes.Data2 = IntPtr(data[2]);
+			planes.Data3 = IntPtr(data[3]);
+			planes.Stride0 = linesize[0];
+			planes.Stride1 = linesize[1];
+			planes.Stride2 = linesize[2];
+			planes.Stride3 = linesize[3];
+			return planes;
+		}
+
+		static FramePlanes FromAVFrame(const AVFrame* frame)
+		{
+			return FromPointers(frame->data, frame->linesize);
+		}
+
+		void CopyTo(uint8_t* data[4], int linesize[4])
+		{
+			data[0] = static_cast<uint8_t*>(Data0.ToPointer());
+			data[1] = static_cast<uint8_t*>(Data1.ToPointer());
+			data[2] = static_cast<uint8_t*>(Data2.ToPointer());
+			data[3] = static_cast<uint8_t*>(Data3.ToPointer());
+			linesize[0] = Stride0;
+			linesize[1] = Stride1;
+			linesize[2] = Stride2;
+			linesize[3] = Stride3;
+		}
+	};
+}
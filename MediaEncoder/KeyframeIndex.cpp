@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "KeyframeIndex.h"
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	KeyframeIndexWriter* KeyframeIndexWriter::Create(const wchar_t* path, AVRational timeBase)
+	{
+		HANDLE file = CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+		                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		uint32_t header[4] = {Magic, Version, static_cast<uint32_t>(timeBase.num), static_cast<uint32_t>(timeBase.den)};
+		DWORD written;
+		if (!WriteFile(file, header, sizeof(header), &written, nullptr) || written != sizeof(header))
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		auto writer = new KeyframeIndexWriter();
+		writer->m_file = file;
+		writer->m_count = 0;
+		return writer;
+	}
+
+	void KeyframeIndexWriter::Destroy(KeyframeIndexWriter* writer)
+	{
+		if (writer == nullptr)
+			return;
+
+		writer->Flush();
+		CloseHandle(writer->m_file);
+		delete writer;
+	}
+
+	void KeyframeIndexWriter::Append(int64_t pts)
+	{
+		m_buffer[m_count] = pts;
+		if (++m_count == BufferEntries)
+			Flush();
+	}
+
+	bool KeyframeIndexWriter::Flush()
+	{
+		if (m_count == 0)
+			return true;
+
+		DWORD size = static_cast<DWORD>(m_count * sizeof(int64_t));
+		DWORD written;
+		bool succeeded = WriteFile(m_file, m_buffer, size, &written, nullptr) && written == size;
+		m_count = 0;
+		return succeeded;
+	}
+#pragma managed(pop)
+
+	KeyframeIndex^ KeyframeIndex::Load(String^ path)
+	{
+		if (path == nullptr)
+			throw gcnew ArgumentNullException("path");
+
+		array<Byte>^ data = File::ReadAllBytes(path);
+		if (data->Length < 16 || BitConverter::ToUInt32(data, 0) != KeyframeIndexWriter::Magic)
+			throw gcnew InvalidDataException("Not a keyframe index.");
+		if (BitConverter::ToUInt32(data, 4) != KeyframeIndexWriter::Version)
+			throw gcnew InvalidDataException("Unsupported keyframe index version.");
+
+		auto index = gcnew KeyframeIndex();
+		index->m_timeBaseNumerator = BitConverter::ToInt32(data, 8);
+		index->m_timeBaseDenominator = BitConverter::ToInt32(data, 12);
+		if (index->m_timeBaseNumerator <= 0 || index->m_timeBaseDenominator <= 0)
+			throw gcnew InvalidDataException("Invalid keyframe index time base.");
+
+		// a trailing partial entry is left over from an interrupted write
+		index->m_count = (data->Length - 16) / 8;
+		index->m_pts = gcnew array<Int64>(index->m_count);
+		for (int i = 0; i < index->m_count; i++)
+		{
+			index->m_pts[i] = BitConverter::ToInt64(data, 16 + i * 8);
+		}
+		return index;
+	}
+
+	int KeyframeIndex::Find(TimeSpan time)
+	{
+		int64_t pts = av_rescale_q(time.Ticks, av_make_q(1, 10000000),
+		                           av_make_q(m_timeBaseNumerator, m_timeBaseDenominator));
+		int index = Array::BinarySearch(m_pts, 0, m_count, pts);
+		// not found: ~index is the first entry after pts
+		return index >= 0 ? index : ~index - 1;
+	}
+
+	Int64 KeyframeIndex::GetPts(int index)
+	{
+		if (index < 0 || index >= m_count)
+			throw gcnew ArgumentOutOfRangeException("index");
+		return m_pts[index];
+	}
+
+	TimeSpan KeyframeIndex::GetTime(int index)
+	{
+		return TimeSpan(av_rescale_q(GetPts(index), av_make_q(m_timeBaseNumerator, m_timeBaseDenominator),
+		                             av_make_q(1, 10000000)));
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+using namespace System;
+using namespace IO;
+
+namespace MediaEncoder
+{
+	// Sidecar next to a recording (<file>.kfi) listing the pts of the video keyframes as they were muxed:
+	//   header  "SRKI", uint32 version, int32 time base numerator, int32 time base denominator
+	//   entries int64 pts (stream time base)
+	// all little-endian. Entries have a fixed size and are appended in order, so the file can be binary
+	// searched and is still usable up to the last flushed entry if the recording was cut off.
+	// Byte offsets are not stored, because write_frame has no reliable position to record:
+	//  - av_interleaved_write_frame may keep a keyframe queued until the other stream catches up, so avio_tell
+	//    after the call is where some earlier packet ended, not where the keyframe starts;
+	//  - once the muxer does write it, the keyframe lands inside its own buffering (a Matroska cluster, a TS
+	//    PES), and libavformat does not report that position back for a file opened with avio_open;
+	//  - in MP4, the default output, the sample offsets live in the moov and a position inside mdat is no
+	//    place to start demuxing.
+	// Consumers seek the container to a listed pts instead, which lands on the keyframe in every format.
+	class KeyframeIndexWriter
+	{
+	public:
+		static const uint32_t Magic = 0x494b5253; // "SRKI"
+		static const uint32_t Version = 1;
+
+		static KeyframeIndexWriter* Create(const wchar_t* path, AVRational timeBase);
+		static void Destroy(KeyframeIndexWriter* writer);
+
+		void Append(int64_t pts);
+		bool Flush();
+
+	private:
+		static const int BufferEntries = 256;
+
+		KeyframeIndexWriter() = default;
+
+		HANDLE m_file;
+		int m_count;
+		int64_t m_buffer[BufferEntries];
+	};
+
+	public ref class KeyframeIndex
+	{
+	private:
+		array<Int64>^ m_pts;
+		int m_timeBaseNumerator;
+		int m_timeBaseDenominator;
+		int m_count;
+
+		KeyframeIndex() : m_timeBaseNumerator(0), m_timeBaseDenominator(1), m_count(0)
+		{
+		}
+
+	public:
+		// Path of the sidecar MediaWriter writes for mediaPath.
+		static String^ GetPath(String^ mediaPath)
+		{
+			if (mediaPath == nullptr)
+				throw gcnew ArgumentNullException("mediaPath");
+			return mediaPath + ".kfi";
+		}
+
+		static KeyframeIndex^ Load(String^ path);
+
+		// Index of the last keyframe at or before time, or -1 if time is before the first keyframe.
+		int Find(TimeSpan time);
+
+		Int64 GetPts(int index);
+		TimeSpan GetTime(int index);
+
+		property int Count
+		{
+			int get()
+			{
+				return m_count;
+			}
+		}
+
+		property int TimeBaseNumerator
+		{
+			int get()
+			{
+				return m_timeBaseNumerator;
+			}
+		}
+
+		property int TimeBaseDenominator
+		{
+			int get()
+			{
+				return m_timeBaseDenominator;
+			}
+		}
+	};
+}
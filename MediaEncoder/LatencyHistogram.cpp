@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "LatencyHistogram.h"
+
+using namespace Threading;
+
+namespace MediaEncoder
+{
+	LatencyHistogram::LatencyHistogram()
+		: m_totalCount(0), m_sum(0), m_min(Int64::MaxValue), m_max(0)
+	{
+		m_counts = gcnew array<Int64>(SubBucketCount + MaxShift * SubBucketHalfCount);
+	}
+
+	int LatencyHistogram::IndexOf(Int64 value)
+	{
+		if (value < SubBucketCount)
+			return static_cast<int>(value);
+
+		// shift so that the value lands in the upper half of the sub-buckets, [64, 128)
+		int shift = 1;
+		while ((value >> shift) >= SubBucketCount)
+			shift++;
+		if (shift > MaxShift)
+			return SubBucketCount + MaxShift * SubBucketHalfCount - 1;
+
+		return SubBucketCount + (shift - 1) * SubBucketHalfCount + static_cast<int>((value >> shift) -
+			SubBucketHalfCount);
+	}
+
+	Int64 LatencyHistogram::HighestEquivalentValue(int index)
+	{
+		if (index < SubBucketCount)
+			return index;
+
+		int shift = (index - SubBucketCount) / SubBucketHalfCount + 1;
+		Int64 subBucket = (index - SubBucketCount) % SubBucketHalfCount + SubBucketHalfCount;
+		return ((subBucket + 1) << shift) - 1;
+	}
+
+	void LatencyHistogram::Record(Int64 microseconds)
+	{
+		if (microseconds < 0)
+			microseconds = 0;
+
+		Interlocked::Increment(m_counts[IndexOf(microseconds)]);
+		Interlocked::Add(m_sum, microseconds);
+		Interlocked::Increment(m_totalCount);
+
+		// a single writer per histogram, so plain stores are enough for the extremes
+		if (microseconds < m_min)
+			m_min = microseconds;
+		if (microseconds > m_max)
+			m_max = microseconds;
+	}
+
+	Int64 LatencyHistogram::GetPercentile(double percentile)
+	{
+		Int64 totalCount = Count;
+		if (totalCount == 0)
+			return 0;
+
+		percentile = Math::Min(Math::Max(percentile, 0.0), 100.0);
+		auto target = Math::Max(static_cast<Int64>(Math::Ceiling(percentile / 100.0 * totalCount)), 1LL);
+
+		Int64 seen = 0;
+		for (int i = 0; i < m_counts->Length; i++)
+		{
+			seen += Interlocked::Read(m_counts[i]);
+			if (seen >= target)
+				return Math::Min(HighestEquivalentValue(i), m_max);
+		}
+		return m_max;
+	}
+
+	void LatencyHistogram::Reset()
+	{
+		for (int i = 0; i < m_counts->Length; i++)
+			Interlocked::Exchange(m_counts[i], 0LL);
+		Interlocked::Exchange(m_sum, 0LL);
+		Interlocked::Exchange(m_totalCount, 0LL);
+		m_min = Int64::MaxValue;
+		m_max = 0;
+	}
+
+	String^ LatencyHistogram::ToString()
+	{
+		return String::Format("n={0} p50={1:0.0}ms p90={2:0.0}ms p99={3:0.0}ms max={4:0.0}ms", Count,
+		                      GetPercentile(50) / 1000.0, GetPercentile(90) / 1000.0, GetPercentile(99) / 1000.0,
+		                      Max / 1000.0);
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+using namespace System;
+
+namespace MediaEncoder
+{
+	// Log-linear histogram of latencies in microseconds, in the spirit of HdrHistogram: values below 128 are
+	// counted exactly, larger ones in 64 sub-buckets per power of two, so every recorded value is reported
+	// within 1/64 (about 1.6%) of itself. Recording is allocation-free and safe against concurrent readers.
+	public ref class LatencyHistogram
+	{
+	private:
+		static const int SubBucketCount = 128;
+		static const int SubBucketHalfCount = 64;
+		static const int MaxShift = 30; // values up to 2^37 microseconds, about 38 hours
+
+		array<Int64>^ m_counts;
+		Int64 m_totalCount;
+		Int64 m_sum;
+		Int64 m_min;
+		Int64 m_max;
+
+		static int IndexOf(Int64 value);
+		static Int64 HighestEquivalentValue(int index);
+
+	public:
+		LatencyHistogram();
+
+		void Record(Int64 microseconds);
+
+		// Smallest value that percentile percent (0..100) of the recorded values are at or below.
+		Int64 GetPercentile(double percentile);
+
+		// Not synchronized with Record; counts recorded at the same time may survive.
+		void Reset();
+
+		// Compact summary for logs, e.g. "n=600 p50=8.1ms p99=16.3ms max=21.0ms".
+		String^ ToString() override;
+
+		property Int64 Count
+		{
+			Int64 get()
+			{
+				return Threading::Interlocked::Read(m_totalCount);
+			}
+		}
+
+		property Int64 Min
+		{
+			Int64 get()
+			{
+				return Count > 0 ? m_min : 0;
+			}
+		}
+
+		property Int64 Max
+		{
+			Int64 get()
+			{
+				return m_max;
+			}
+		}
+
+		property double Mean
+		{
+			double get()
+			{
+				Int64 count = Count;
+				return count > 0 ? static_cast<double>(Threading::Interlocked::Read(m_sum)) / count : 0.0;
+			}
+		}
+	};
+}
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	MappedFile* MappedFile::Create(const wchar_t* path)
+	{
+		HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		auto data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		auto mappedFile = new MappedFile();
+		mappedFile->m_references = 1;
+		mappedFile->m_file = file;
+		mappedFile->m_mapping = mapping;
+		mappedFile->m_data = data;
+		mappedFile->m_size = size.QuadPart;
+		return mappedFile;
+	}
+
+	void MappedFile::AddRef()
+	{
+		InterlockedIncrement(&m_references);
+	}
+
+	void MappedFile::Release()
+	{
+		if (InterlockedDecrement(&m_references) != 0)
+			return;
+
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		delete this;
+	}
+#pragma managed(pop)
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+namespace MediaEncoder
+{
+	// Read-only view of a whole file. Reference counted so that zero-copy frames pointing into the view can
+	// outlive the reader that opened it; the view is unmapped when the last reference is released.
+	class MappedFile
+	{
+	public:
+		static MappedFile* Create(const wchar_t* path);
+
+		void AddRef();
+		void Release();
+
+		const uint8_t* Data() const { return m_data; }
+		int64_t Size() const { return m_size; }
+
+	private:
+		MappedFile() = default;
+
+		volatile LONG m_references;
+		HANDLE m_file;
+		HANDLE m_mapping;
+		const uint8_t* m_data;
+		int64_t m_size;
+	};
+}
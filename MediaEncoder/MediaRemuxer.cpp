@@ -0,0 +1,357 @@
+#include "pch.h"
+#include "MediaRemuxer.h"
+
+using namespace Runtime::InteropServices;
+
+namespace MediaEncoder
+{
+	static char* ToUtf8(String^ value)
+	{
+		IntPtr unicodePointer = Marshal::StringToHGlobalUni(value);
+		auto unicode = static_cast<wchar_t*>(unicodePointer.ToPointer());
+		int size = WideCharToMultiByte(CP_UTF8, 0, unicode, -1, nullptr, 0, nullptr, nullptr);
+		auto utf8 = new char[size];
+		WideCharToMultiByte(CP_UTF8, 0, unicode, -1, utf8, size, nullptr, nullptr);
+		Marshal::FreeHGlobal(unicodePointer);
+		return utf8;
+	}
+
+	static int64_t TimeSpanToAVTime(TimeSpan value)
+	{
+		// TimeSpan ticks are 100 ns
+		return av_rescale(value.Ticks, AV_TIME_BASE, 10000000);
+	}
+
+	static int64_t StartTime(const AVFormatContext* input)
+	{
+		return input->start_time != AV_NOPTS_VALUE ? input->start_time : 0;
+	}
+
+	static int64_t Duration(const AVFormatContext* input)
+	{
+		return input->duration != AV_NOPTS_VALUE ? input->duration : 0;
+	}
+
+	// Whether packets of other can be appended to a stream created from first without the decoder noticing.
+	static String^ CheckCompatible(const AVCodecParameters* first, const AVCodecParameters* other)
+	{
+		if (first->codec_type != other->codec_type || first->codec_id != other->codec_id)
+			return "different codecs";
+		if (first->codec_type == AVMEDIA_TYPE_VIDEO && (first->width != other->width || first->height != other->
+			height || first->format != other->format))
+			return "different video size or pixel format";
+		if (first->codec_type == AVMEDIA_TYPE_AUDIO && (first->sample_rate != other->sample_rate || first->
+			channels != other->channels || first->format != other->format))
+			return "different audio sample rate, channels or sample format";
+		// the output keeps the first file's headers (SPS/PPS, AudioSpecificConfig), so they have to match
+		if (first->extradata_size != other->extradata_size || (first->extradata_size > 0 && memcmp(
+			first->extradata, other->extradata, first->extradata_size) != 0))
+			return "different codec headers";
+		return nullptr;
+	}
+
+	MediaRemuxer::MediaRemuxer()
+		: m_fastStart(false), m_cancel(false), m_packetsCopied(0), m_bytesCopied(0), m_progress(0)
+	{
+	}
+
+	void MediaRemuxer::Remux(String^ inputUrl, String^ outputUrl, String^ format)
+	{
+		if (inputUrl == nullptr)
+			throw gcnew ArgumentNullException("inputUrl");
+
+		Run(gcnew array<String^>{inputUrl}, outputUrl, format, AV_NOPTS_VALUE, AV_NOPTS_VALUE, false);
+	}
+
+	void MediaRemuxer::Trim(String^ inputUrl, String^ outputUrl, TimeSpan start, TimeSpan end)
+	{
+		if (inputUrl == nullptr)
+			throw gcnew ArgumentNullException("inputUrl");
+		if (start < TimeSpan::Zero || end <= start)
+			throw gcnew ArgumentOutOfRangeException("end");
+
+		Run(gcnew array<String^>{inputUrl}, outputUrl, nullptr,
+		    start > TimeSpan::Zero ? TimeSpanToAVTime(start) : AV_NOPTS_VALUE,
+		    end != TimeSpan::MaxValue ? TimeSpanToAVTime(end) : AV_NOPTS_VALUE, true);
+	}
+
+	void MediaRemuxer::Concatenate(array<String^>^ inputUrls, String^ outputUrl)
+	{
+		if (inputUrls == nullptr || inputUrls->Length == 0)
+			throw gcnew ArgumentNullException("inputUrls");
+		for each (String^ inputUrl in inputUrls)
+		{
+			if (inputUrl == nullptr)
+				throw gcnew ArgumentNullException("inputUrls");
+		}
+
+		Run(inputUrls, outputUrl, nullptr, AV_NOPTS_VALUE, AV_NOPTS_VALUE, true);
+	}
+
+	void MediaRemuxer::Run(array<String^>^ inputUrls, String^ outputUrl, String^ format, int64_t start, int64_t end,
+	                       bool rebase)
+	{
+		if (outputUrl == nullptr)
+			throw gcnew ArgumentNullException("outputUrl");
+
+		m_cancel = false;
+		m_packetsCopied = 0;
+		m_bytesCopied = 0;
+		m_progress = 0;
+
+		int inputCount = inputUrls->Length;
+		char* nativeOutput = ToUtf8(outputUrl);
+		char* nativeFormat = format != nullptr ? ToUtf8(format) : nullptr;
+
+		auto inputs = new AVFormatContext*[inputCount]();
+		AVFormatContext* output = nullptr;
+		int* streamMap = nullptr;
+		bool headerWritten = false;
+		try
+		{
+			int64_t totalDuration = 0;
+			for (int i = 0; i < inputCount; i++)
+			{
+				char* nativeInput = ToUtf8(inputUrls[i]);
+				int ret = avformat_open_input(&inputs[i], nativeInput, nullptr, nullptr);
+				delete[] nativeInput;
+				if (ret < 0)
+					throw gcnew IOException(String::Format("avformat_open_input: {0}", inputUrls[i]));
+				if (avformat_find_stream_info(inputs[i], nullptr) < 0)
+					throw gcnew IOException("avformat_find_stream_info");
+				totalDuration += Duration(inputs[i]);
+			}
+			if (end != AV_NOPTS_VALUE)
+				totalDuration = min(totalDuration, end);
+			if (start != AV_NOPTS_VALUE)
+				totalDuration -= min(totalDuration, start);
+
+			if (avformat_alloc_output_context2(&output, nullptr, nativeFormat, nativeOutput) < 0 || output == nullptr)
+				throw gcnew IOException("avformat_alloc_output_context2");
+
+			// the output streams are laid out after the first input; later ones have to match it
+			AVFormatContext* first = inputs[0];
+			streamMap = new int[first->nb_streams];
+			int outputStreams = 0;
+			for (unsigned int i = 0; i < first->nb_streams; i++)
+			{
+				AVStream* inStream = first->streams[i];
+				AVCodecParameters* parameters = inStream->codecpar;
+				streamMap[i] = -1;
+
+				if (parameters->codec_type != AVMEDIA_TYPE_VIDEO && parameters->codec_type != AVMEDIA_TYPE_AUDIO &&
+					parameters->codec_type != AVMEDIA_TYPE_SUBTITLE)
+					continue;
+				if (avformat_query_codec(output->oformat, parameters->codec_id, FF_COMPLIANCE_NORMAL) == 0)
+				{
+					av_log(nullptr, AV_LOG_WARNING, "MediaRemuxer: %s can not hold %s, stream %u dropped\n",
+					       output->oformat->name, avcodec_get_name(parameters->codec_id), i);
+					continue;
+				}
+
+				AVStream* outStream = avformat_new_stream(output, nullptr);
+				if (outStream == nullptr)
+					throw gcnew OutOfMemoryException("avformat_new_stream");
+				if (avcodec_parameters_copy(outStream->codecpar, parameters) < 0)
+					throw gcnew IOException("avcodec_parameters_copy");
+				// the tag belongs to the input container; the muxer picks its own
+				outStream->codecpar->codec_tag = 0;
+				outStream->time_base = inStream->time_base;
+				outStream->disposition = inStream->disposition;
+				av_dict_copy(&outStream->metadata, inStream->metadata, 0);
+				streamMap[i] = outputStreams++;
+			}
+			if (outputStreams == 0)
+				throw gcnew IOException("MediaRemuxer: no stream can be copied to the output format.");
+
+			for (int i = 1; i < inputCount; i++)
+			{
+				if (inputs[i]->nb_streams != first->nb_streams)
+					throw gcnew NotSupportedException(String::Format(
+						"MediaRemuxer: {0} has a different number of streams.", inputUrls[i]));
+				for (unsigned int j = 0; j < first->nb_streams; j++)
+				{
+					String^ reason = streamMap[j] >= 0
+						                 ? CheckCompatible(first->streams[j]->codecpar, inputs[i]->streams[j]->codecpar)
+						                 : nullptr;
+					if (reason != nullptr)
+						throw gcnew NotSupportedException(String::Format("MediaRemuxer: stream {0} of {1}: {2}.",
+						                                                 j, inputUrls[i], reason));
+				}
+			}
+
+			av_dict_copy(&output->metadata, first->metadata, 0);
+
+			if (!(output->oformat->flags & AVFMT_NOFILE) && avio_open(&output->pb, nativeOutput, AVIO_FLAG_WRITE) < 0)
+				throw gcnew IOException("avio_open");
+
+			AVDictionary* options = nullptr;
+			if (m_fastStart)
+				av_dict_set(&options, "movflags", "+faststart", 0);
+			int ret = avformat_write_header(output, &options);
+			av_dict_free(&options);
+			if (ret < 0)
+				throw gcnew IOException("avformat_write_header");
+			headerWritten = true;
+
+			int64_t offset = 0;
+			int64_t doneDuration = 0;
+			for (int i = 0; i < inputCount && !m_cancel; i++)
+			{
+				offset = CopyPackets(inputs[i], output, streamMap, start, end, offset, rebase, totalDuration,
+				                     doneDuration);
+				doneDuration += Duration(inputs[i]);
+			}
+
+			headerWritten = false;
+			if (av_write_trailer(output) < 0)
+				throw gcnew IOException("av_write_trailer");
+			if (!m_cancel)
+				m_progress = 1.0;
+		}
+		finally
+		{
+			// on errors the output is still closed properly, up to the last packet written
+			if (headerWritten)
+				av_write_trailer(output);
+			if (output != nullptr)
+			{
+				if (!(output->oformat->flags & AVFMT_NOFILE))
+					avio_closep(&output->pb);
+				avformat_free_context(output);
+			}
+			for (int i = 0; i < inputCount; i++)
+			{
+				if (inputs[i] != nullptr)
+					avformat_close_input(&inputs[i]);
+			}
+
+			delete[] inputs;
+			delete[] streamMap;
+			delete[] nativeOutput;
+			delete[] nativeFormat;
+		}
+	}
+
+	// Copies the packets of input in [start, end) (AV_TIME_BASE, relative to the input's start) and returns where
+	// the copied range ends on the output timeline. With rebase, the first packet written (the keyframe at or
+	// before start) lands at offset; otherwise timestamps are kept as they are.
+	int64_t MediaRemuxer::CopyPackets(AVFormatContext* input, AVFormatContext* output, const int* streamMap,
+	                                  int64_t start, int64_t end, int64_t offset, bool rebase, int64_t totalDuration,
+	                                  int64_t doneDuration)
+	{
+		int64_t inputStart = StartTime(input);
+		int videoIndex = av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+		if (videoIndex >= 0 && streamMap[videoIndex] < 0)
+			videoIndex = -1;
+
+		if (start != AV_NOPTS_VALUE && av_seek_frame(input, -1, inputStart + start, AVSEEK_FLAG_BACKWARD) < 0)
+			throw gcnew IOException("av_seek_frame");
+
+		int remaining = 0;
+		auto done = gcnew array<bool>(input->nb_streams);
+		for (unsigned int i = 0; i < input->nb_streams; i++)
+		{
+			if (streamMap[i] >= 0)
+				remaining++;
+		}
+
+		// input time that is written at offset; found on the first video keyframe when rebasing
+		int64_t cut = rebase ? AV_NOPTS_VALUE : 0;
+		int64_t rangeStart = start != AV_NOPTS_VALUE ? start : 0;
+		int64_t last = offset;
+
+		AVPacket* packet = av_packet_alloc();
+		if (packet == nullptr)
+			throw gcnew OutOfMemoryException("av_packet_alloc");
+		try
+		{
+			while (!m_cancel && remaining > 0)
+			{
+				int ret = av_read_frame(input, packet);
+				if (ret == AVERROR_EOF)
+					break;
+				if (ret < 0)
+					throw gcnew IOException("av_read_frame");
+
+				int inIndex = packet->stream_index;
+				int outIndex = streamMap[inIndex];
+				if (outIndex < 0 || done[inIndex])
+				{
+					av_packet_unref(packet);
+					continue;
+				}
+
+				AVStream* inStream = input->streams[inIndex];
+				AVStream* outStream = output->streams[outIndex];
+				int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+				bool known = timestamp != AV_NOPTS_VALUE;
+				int64_t time = known ? av_rescale_q(timestamp, inStream->time_base, AV_TIME_BASE_Q) - inputStart : 0;
+
+				if (cut == AV_NOPTS_VALUE)
+				{
+					// nothing before the first keyframe can be decoded
+					bool key = videoIndex < 0 || (inIndex == videoIndex && (packet->flags & AV_PKT_FLAG_KEY));
+					if (!key || !known)
+					{
+						av_packet_unref(packet);
+						continue;
+					}
+					cut = time;
+				}
+
+				if (known && inIndex != videoIndex && time < cut)
+				{
+					av_packet_unref(packet);
+					continue;
+				}
+				// with B-frames, video packets that display before end can follow one that displays after it, so
+				// video is cut in decode order: every packet a frame before end depends on has a smaller dts
+				int64_t decodeTime = time;
+				if (inIndex == videoIndex && packet->dts != AV_NOPTS_VALUE)
+					decodeTime = av_rescale_q(packet->dts, inStream->time_base, AV_TIME_BASE_Q) - inputStart;
+				if (known && end != AV_NOPTS_VALUE && decodeTime >= end)
+				{
+					done[inIndex] = true;
+					remaining--;
+					av_packet_unref(packet);
+					continue;
+				}
+
+				if (known && totalDuration > 0)
+					m_progress = Math::Min(Math::Max(static_cast<double>(doneDuration + time - rangeStart) /
+					                                 totalDuration, m_progress), 1.0);
+				if (known)
+				{
+					int64_t duration = av_rescale_q(packet->duration, inStream->time_base, AV_TIME_BASE_Q);
+					last = max(last, offset + (time - cut) + duration);
+				}
+
+				int size = packet->size;
+				packet->stream_index = outIndex;
+				av_packet_rescale_ts(packet, inStream->time_base, outStream->time_base);
+				if (rebase)
+				{
+					int64_t shift = av_rescale_q(offset - cut - inputStart, AV_TIME_BASE_Q, outStream->time_base);
+					if (packet->pts != AV_NOPTS_VALUE)
+						packet->pts += shift;
+					if (packet->dts != AV_NOPTS_VALUE)
+						packet->dts += shift;
+				}
+				packet->pos = -1;
+
+				// takes ownership of the packet's reference
+				if (av_interleaved_write_frame(output, packet) < 0)
+					throw gcnew IOException("av_interleaved_write_frame");
+
+				Threading::Interlocked::Increment(m_packetsCopied);
+				Threading::Interlocked::Add(m_bytesCopied, size);
+			}
+		}
+		finally
+		{
+			av_packet_free(&packet);
+		}
+		return last;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+using namespace System;
+using namespace IO;
+
+namespace MediaEncoder
+{
+	// Copies the audio, video and subtitle packets of a finished recording into another container without
+	// decoding them, e.g. MKV to MP4 for upload. Runs at disk speed; streams the output container cannot hold
+	// are left out.
+	public ref class MediaRemuxer
+	{
+	private:
+		bool m_fastStart;
+		volatile bool m_cancel;
+		Int64 m_packetsCopied;
+		Int64 m_bytesCopied;
+		double m_progress;
+
+		void Run(array<String^>^ inputUrls, String^ outputUrl, String^ format, int64_t start, int64_t end,
+		         bool rebase);
+		int64_t CopyPackets(AVFormatContext* input, AVFormatContext* output, const int* streamMap, int64_t start,
+		                    int64_t end, int64_t offset, bool rebase, int64_t totalDuration, int64_t doneDuration);
+
+	public:
+		MediaRemuxer();
+
+		// format is the short name of the output container ("mp4", "matroska", ...); nullptr guesses it from
+		// outputUrl. Blocks until the copy is done or Cancel is called; a cancelled output is incomplete.
+		void Remux(String^ inputUrl, String^ outputUrl, String^ format);
+
+		void Remux(String^ inputUrl, String^ outputUrl)
+		{
+			Remux(inputUrl, outputUrl, nullptr);
+		}
+
+		// Copies [start, end) of the input, widened to the keyframe at or before start so that the output
+		// decodes from its first packet; the output starts at 0. TimeSpan::Zero and TimeSpan::MaxValue leave
+		// the respective end open. Nothing is re-encoded, so cuts are only as precise as the GOP length; video
+		// stops at the first packet decoded at or after end, which can keep a frame or two displayed after it.
+		void Trim(String^ inputUrl, String^ outputUrl, TimeSpan start, TimeSpan end);
+
+		// Joins the inputs back to back by packet copy. They must have the same streams with the same codec
+		// parameters, as segments of one recording do; otherwise NotSupportedException is thrown.
+		void Concatenate(array<String^>^ inputUrls, String^ outputUrl);
+
+		// Can be called from any thread while Remux runs.
+		void Cancel()
+		{
+			m_cancel = true;
+		}
+
+		// Move the MP4/MOV index in front of the media data so that playback can start before the whole file
+		// is downloaded. Costs a second pass over the output when the trailer is written.
+		property bool FastStart
+		{
+			bool get()
+			{
+				return m_fastStart;
+			}
+			void set(bool value)
+			{
+				m_fastStart = value;
+			}
+		}
+
+		property Int64 PacketsCopied
+		{
+			Int64 get()
+			{
+				return Threading::Interlocked::Read(m_packetsCopied);
+			}
+		}
+
+		property Int64 BytesCopied
+		{
+			Int64 get()
+			{
+				return Threading::Interlocked::Read(m_bytesCopied);
+			}
+		}
+
+		// Fraction of the input's duration copied so far, 0..1.
+		property double Progress
+		{
+			double get()
+			{
+				return m_progress;
+			}
+		}
+	};
+}
@@ -1,8 +1,81 @@
 #include "pch.h"
 #include "MediaWriter.h"
+#include "VideoFilterGraph.h"
+#include "Scaler.h"
+#include "PixelConverter.h"
+#include "AVSync.h"
+#include "KeyframeIndex.h"
 
 namespace MediaEncoder
 {
+	// Follows frames through one encoder: the capture timestamp is remembered by pts when the frame is sent and
+	// looked up again when a packet with that pts comes out, which also works across B-frame reordering.
+	ref class StreamLatency
+	{
+	private:
+		static const int Capacity = 512; // deeper than any encoder delay (x264 lookahead is at most 250)
+
+		array<Int64>^ m_pts;
+		array<Int64>^ m_captureTimestamps;
+		int m_next;
+		LONGLONG m_frequency;
+		LatencyHistogram^ m_encoded;
+		LatencyHistogram^ m_muxed;
+
+		Int64 Elapsed(Int64 captureTimestamp)
+		{
+			LARGE_INTEGER now;
+			QueryPerformanceCounter(&now);
+			return (now.QuadPart - captureTimestamp) * 1000000 / m_frequency;
+		}
+
+	public:
+		StreamLatency(LatencyHistogram^ encoded, LatencyHistogram^ muxed)
+			: m_next(0), m_encoded(encoded), m_muxed(muxed)
+		{
+			m_pts = gcnew array<Int64>(Capacity);
+			m_captureTimestamps = gcnew array<Int64>(Capacity);
+
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			m_frequency = frequency.QuadPart;
+		}
+
+		void Sent(const AVFrame* frame)
+		{
+			auto captureTimestamp = reinterpret_cast<intptr_t>(frame->opaque);
+			if (captureTimestamp == 0)
+				return;
+
+			m_pts[m_next] = frame->pts;
+			m_captureTimestamps[m_next] = captureTimestamp;
+			m_next = (m_next + 1) % Capacity;
+		}
+
+		// Returns the capture timestamp of the frame behind pts, or 0 if it wasn't tracked.
+		Int64 Encoded(int64_t pts)
+		{
+			for (int i = 1; i <= Capacity; i++)
+			{
+				int index = (m_next - i + Capacity) % Capacity;
+				if (m_captureTimestamps[index] != 0 && m_pts[index] == pts)
+				{
+					Int64 captureTimestamp = m_captureTimestamps[index];
+					m_captureTimestamps[index] = 0;
+					m_encoded->Record(Elapsed(captureTimestamp));
+					return captureTimestamp;
+				}
+			}
+			return 0;
+		}
+
+		void Muxed(Int64 captureTimestamp)
+		{
+			if (captureTimestamp != 0)
+				m_muxed->Record(Elapsed(captureTimestamp));
+		}
+	};
+
 	ref struct WriterPrivateData
 	{
 	public:
@@ -27,9 +100,30 @@ namespace MediaEncoder
 
 		int SwsSrcWidth, SwsSrcHeight;
 		AVPixelFormat SwsSrcFormat;
+		ScaleMode SwsScaleMode;
+		struct BorderState* BorderState;
+		struct BgraScaleScratch* BgraScratch;
+
+		AVSampleFormat SwrSrcFormat;
+		int SwrSrcSampleRate;
+		uint64_t SwrSrcChannelLayout;
+		ResamplerProfile SwrProfile;
+
+		VideoFilterGraph* FilterGraph;
+		AVFrame* FilterFrame;
+		String^ FilterDescription;
+		int FilterThreads;
+		int64_t NextFilterPts;
 
 		AVBufferRef* HardwareDeviceContext;
 
+		StreamLatency^ VideoLatency;
+		StreamLatency^ AudioLatency;
+
+		struct AVSyncState* SyncState;
+
+		KeyframeIndexWriter* KeyframeIndex;
+
 		WriterPrivateData()
 		{
 			FormatContext = nullptr;
@@ -56,12 +150,35 @@ namespace MediaEncoder
 			SwsSrcWidth = 0;
 			SwsSrcHeight = 0;
 			SwsSrcFormat = AV_PIX_FMT_NONE;
+			SwsScaleMode = ScaleMode::Stretch;
+			BorderState = new struct BorderState();
+			BgraScratch = new struct BgraScaleScratch();
+
+			SwrSrcFormat = AV_SAMPLE_FMT_NONE;
+			SwrSrcSampleRate = 0;
+			SwrSrcChannelLayout = 0;
+			SwrProfile = ResamplerProfile::Balanced;
+
+			FilterGraph = nullptr;
+			FilterFrame = nullptr;
+			FilterDescription = nullptr;
+			FilterThreads = 0;
+			NextFilterPts = 0;
 
 			HardwareDeviceContext = nullptr;
+
+			VideoLatency = nullptr;
+			AudioLatency = nullptr;
+
+			SyncState = new struct AVSyncState();
+			InitAVSync(SyncState);
+
+			KeyframeIndex = nullptr;
 		}
 	};
 
-	static int write_frame(AVFormatContext* fmt_ctx, AVCodecContext* c, AVStream* st, AVFrame* frame)
+	static int write_frame(AVFormatContext* fmt_ctx, AVCodecContext* c, AVStream* st, AVFrame* frame,
+	                       StreamLatency^ latency, KeyframeIndexWriter* index)
 	{
 		int ret;
 		ret = avcodec_send_frame(c, frame);
@@ -69,6 +186,8 @@ namespace MediaEncoder
 		{
 			throw gcnew IOException("avcodec_send_frame");
 		}
+		if (frame != nullptr)
+			latency->Sent(frame);
 
 		while (ret >= 0)
 		{
@@ -85,9 +204,15 @@ namespace MediaEncoder
 			if (pkt.duration == 0 && frame == nullptr)
 				pkt.duration = 1;
 
+			// audio encoders shift packet pts back by their priming samples
+			Int64 captureTimestamp = latency->Encoded(pkt.pts + c->initial_padding);
+
 			av_packet_rescale_ts(&pkt, c->time_base, st->time_base);
 			pkt.stream_index = st->index;
 
+			if (index != nullptr && (pkt.flags & AV_PKT_FLAG_KEY))
+				index->Append(pkt.pts);
+
 			ret = av_interleaved_write_frame(fmt_ctx, &pkt);
 
 			av_packet_unref(&pkt);
@@ -95,6 +220,7 @@ namespace MediaEncoder
 			{
 				throw gcnew IOException("av_interleaved_write_frame");
 			}
+			latency->Muxed(captureTimestamp);
 		}
 
 		return ret == AVERROR_EOF ? 1 : 0;
@@ -139,9 +265,16 @@ namespace MediaEncoder
 		AudioCodec audio_codec, int audio_bitrate)
 		: m_width(width), m_height(height), m_videoNumerator(video_numerator), m_videoDenominator(video_denominator),
 		  m_videoBitrate(video_bitrate), m_videoCodec(static_cast<AVCodecID>(video_codec)),
-		  m_audioBitrate(audio_bitrate), m_audioCodec(static_cast<AVCodecID>(audio_codec)), m_data(nullptr),
-		  m_disposed(false)
+		  m_audioBitrate(audio_bitrate), m_audioCodec(static_cast<AVCodecID>(audio_codec)),
+		  m_scaleMode(MediaEncoder::ScaleMode::Stretch),
+		  m_resamplerProfile(MediaEncoder::ResamplerProfile::Balanced), m_videoFilter(nullptr), m_filterThreads(0),
+		  m_timestampSync(false), m_writeKeyframeIndex(false), m_data(nullptr), m_disposed(false)
 	{
+		m_videoEncodeLatency = gcnew LatencyHistogram();
+		m_videoMuxLatency = gcnew LatencyHistogram();
+		m_audioEncodeLatency = gcnew LatencyHistogram();
+		m_audioMuxLatency = gcnew LatencyHistogram();
+
 		avformat_network_init();
 	}
 
@@ -158,6 +291,13 @@ namespace MediaEncoder
 		m_videoFramesCount = 0;
 		m_audioSamplesCount = 0;
 
+		m_videoEncodeLatency->Reset();
+		m_videoMuxLatency->Reset();
+		m_audioEncodeLatency->Reset();
+		m_audioMuxLatency->Reset();
+		m_data->VideoLatency = gcnew StreamLatency(m_videoEncodeLatency, m_videoMuxLatency);
+		m_data->AudioLatency = gcnew StreamLatency(m_audioEncodeLatency, m_audioMuxLatency);
+
 		IntPtr urlStringPointer = Marshal::StringToHGlobalUni(url);
 		auto nativeUrlUnicode = static_cast<wchar_t*>(urlStringPointer.ToPointer());
 		int utf8UrlStringSize = WideCharToMultiByte(CP_UTF8, 0, nativeUrlUnicode, -1, nullptr, 0, nullptr, nullptr);
@@ -406,6 +546,18 @@ namespace MediaEncoder
 			throw gcnew IOException("avformat_write_header error");
 		}
 
+		// stream time bases are final once the header is written
+		if (m_writeKeyframeIndex && m_data->VideoStream != nullptr && !(m_data->FormatContext->oformat->flags &
+			AVFMT_NOFILE) && strcmp(avio_find_protocol_name(nativeUrl), "file") == 0)
+		{
+			IntPtr indexPathPointer = Marshal::StringToHGlobalUni(KeyframeIndex::GetPath(url));
+			m_data->KeyframeIndex = KeyframeIndexWriter::Create(static_cast<wchar_t*>(indexPathPointer.ToPointer()),
+			                                                    m_data->VideoStream->time_base);
+			Marshal::FreeHGlobal(indexPathPointer);
+			if (m_data->KeyframeIndex == nullptr)
+				System::Diagnostics::Debug::WriteLine("KeyframeIndexWriter::Create: {0}", KeyframeIndex::GetPath(url));
+		}
+
 		if (m_data->VideoCodecContext != nullptr)
 		{
 			m_data->VideoFrame = av_frame_alloc();
@@ -456,16 +608,39 @@ namespace MediaEncoder
 				m_data->AudioFrame->nb_samples = m_data->AudioCodecContext->frame_size;
 			av_frame_get_buffer(m_data->AudioFrame, 0);
 
-			m_data->SwrContext = swr_alloc_set_opts(
-				nullptr,
-				m_data->AudioCodecContext->channel_layout,
-				m_data->AudioCodecContext->sample_fmt,
-				m_data->AudioCodecContext->sample_rate,
-				AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16, 48000, 0, nullptr);
-			swr_init(m_data->SwrContext);
+			// The SwrContext is created from the first frame, so any input format is accepted; with
+			// PreferredSampleFormat it only has to interleave (or copy) the samples.
 		}
 	}
 
+	SampleFormat MediaWriter::PreferredSampleFormat::get()
+	{
+		CheckIfWriterIsInitialized();
+		if (m_data->AudioCodecContext == nullptr)
+			return SampleFormat::NONE;
+		return static_cast<SampleFormat>(av_get_packed_sample_fmt(m_data->AudioCodecContext->sample_fmt));
+	}
+
+	Int64 MediaWriter::DroppedVideoFrames::get()
+	{
+		CheckIfWriterIsInitialized();
+		return m_data->SyncState->droppedVideoFrames;
+	}
+
+	Int64 MediaWriter::DuplicatedVideoFrames::get()
+	{
+		CheckIfWriterIsInitialized();
+		return m_data->SyncState->duplicatedVideoFrames;
+	}
+
+	double MediaWriter::AudioDriftMilliseconds::get()
+	{
+		CheckIfWriterIsInitialized();
+		if (m_data->AudioCodecContext == nullptr)
+			return 0.0;
+		return m_data->SyncState->audioDrift * 1000.0 / m_data->AudioCodecContext->sample_rate;
+	}
+
 	void MediaWriter::Close()
 	{
 		if (m_data == nullptr)
@@ -473,10 +648,34 @@ namespace MediaEncoder
 
 		AVFormatContext* formatContext = m_data->FormatContext;
 
+		if (m_data->FilterGraph != nullptr)
+		{
+			// frames still held by the graph (fps, tmix, ...) are written before the encoder is flushed
+			m_data->FilterGraph->Push(nullptr);
+			try
+			{
+				DrainVideoFilter();
+			}
+			catch (IOException^ e)
+			{
+				System::Diagnostics::Debug::WriteLine(e);
+			}
+			VideoFilterGraph::Destroy(m_data->FilterGraph);
+			m_data->FilterGraph = nullptr;
+		}
+		if (m_data->FilterFrame != nullptr)
+		{
+			AVFrame* frame = m_data->FilterFrame;
+			av_frame_free(&frame);
+			m_data->FilterFrame = nullptr;
+		}
+
 		if (m_data->VideoCodecContext != nullptr && m_data->VideoFrame != nullptr)
-			write_frame(formatContext, m_data->VideoCodecContext, m_data->VideoStream, nullptr);
+			write_frame(formatContext, m_data->VideoCodecContext, m_data->VideoStream, nullptr, m_data->VideoLatency,
+			            m_data->KeyframeIndex);
 		if (m_data->AudioCodecContext != nullptr && m_data->AudioFrame != nullptr)
-			write_frame(formatContext, m_data->AudioCodecContext, m_data->AudioStream, nullptr);
+			write_frame(formatContext, m_data->AudioCodecContext, m_data->AudioStream, nullptr, m_data->AudioLatency,
+			            nullptr);
 		if (m_data->AudioFrame != nullptr || m_data->VideoFrame != nullptr)
 			av_write_trailer(formatContext);
 		avformat_close_input(&formatContext);
@@ -493,6 +692,11 @@ namespace MediaEncoder
 
 		if (m_data->SwsContext != nullptr)
 			sws_freeContext(m_data->SwsContext);
+		delete m_data->BorderState;
+		FreeBgraScaleScratch(m_data->BgraScratch);
+		delete m_data->BgraScratch;
+		delete m_data->SyncState;
+		KeyframeIndexWriter::Destroy(m_data->KeyframeIndex);
 		if (m_data->SwrContext != nullptr)
 		{
 			SwrContext* c = m_data->SwrContext;
@@ -513,75 +717,196 @@ namespace MediaEncoder
 			VideoCodecContext == nullptr)
 			return;
 
-		auto avFrame = static_cast<AVFrame*>(videoFrame->NativePointer.ToPointer());
+		SubmitVideoFrame(static_cast<AVFrame*>(videoFrame->NativePointer.ToPointer()));
+	}
 
-		if (avFrame->width != m_data->SwsSrcWidth || avFrame->height != m_data->SwsSrcHeight || avFrame->format !=
-			m_data->SwsSrcFormat)
+	void MediaWriter::EncodeVideoFrames(array<VideoFrame^>^ videoFrames, int offset, int count)
+	{
+		if (videoFrames == nullptr)
+			throw gcnew ArgumentNullException("videoFrames");
+		if (offset < 0 || count < 0 || offset > videoFrames->Length - count)
+			throw gcnew ArgumentOutOfRangeException("count");
+		if (m_data == nullptr || m_data->VideoCodecContext == nullptr)
+			return;
+
+		for (int i = offset; i < offset + count; i++)
 		{
-			if (m_data->SwsContext != nullptr)
+			VideoFrame^ videoFrame = videoFrames[i];
+			if (videoFrame == nullptr)
+				continue;
+
+			auto avFrame = static_cast<AVFrame*>(videoFrame->NativePointer.ToPointer());
+			if (avFrame != nullptr)
+				SubmitVideoFrame(avFrame);
+		}
+	}
+
+	void MediaWriter::SubmitVideoFrame(AVFrame* avFrame)
+	{
+		if (String::IsNullOrEmpty(m_videoFilter) && m_data->FilterGraph == nullptr)
+			WriteVideoFrame(avFrame);
+		else
+			FilterVideoFrame(avFrame);
+	}
+
+	void MediaWriter::FilterVideoFrame(AVFrame* avFrame)
+	{
+		auto srcFormat = static_cast<AVPixelFormat>(avFrame->format);
+		if (m_data->FilterGraph == nullptr || !m_data->FilterGraph->Matches(avFrame->width, avFrame->height,
+		                                                                   srcFormat) ||
+			!String::Equals(m_data->FilterDescription, m_videoFilter) || m_data->FilterThreads != m_filterThreads)
+		{
+			if (m_data->FilterGraph != nullptr)
 			{
-				sws_freeContext(m_data->SwsContext);
-				m_data->SwsContext = nullptr;
+				m_data->FilterGraph->Push(nullptr);
+				DrainVideoFilter();
+				VideoFilterGraph::Destroy(m_data->FilterGraph);
+				m_data->FilterGraph = nullptr;
 			}
 
-			if (m_data->VideoCodecContext->hw_frames_ctx != nullptr)
+			m_data->FilterDescription = m_videoFilter;
+			m_data->FilterThreads = m_filterThreads;
+			if (String::IsNullOrEmpty(m_videoFilter))
 			{
-				if (avFrame->width != m_data->VideoCodecContext->width || avFrame->height != m_data->VideoCodecContext->
-					height || avFrame->format != AV_PIX_FMT_NV12)
-				{
-					m_data->SwsContext = sws_getContext(avFrame->width, avFrame->height,
-					                                    static_cast<AVPixelFormat>(avFrame->format),
-					                                    m_data->VideoCodecContext->width,
-					                                    m_data->VideoCodecContext->height, AV_PIX_FMT_NV12,
-					                                    SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
-				}
-				m_data->SwsSrcWidth = avFrame->width;
-				m_data->SwsSrcHeight = avFrame->height;
-				m_data->SwsSrcFormat = static_cast<AVPixelFormat>(avFrame->format);
+				WriteVideoFrame(avFrame);
+				return;
 			}
-			else
+
+			if (m_data->FilterFrame == nullptr)
+				m_data->FilterFrame = av_frame_alloc();
+
+			AVFrame* target = m_data->VideoCodecContext->hw_frames_ctx != nullptr
+				                  ? m_data->SoftwareVideoFrame
+				                  : m_data->VideoFrame;
+			IntPtr filters = Marshal::StringToHGlobalAnsi(m_videoFilter);
+			VideoFilterGraph* graph;
+			int ret = VideoFilterGraph::Create(static_cast<const char*>(filters.ToPointer()), m_filterThreads,
+			                                   avFrame->width, avFrame->height, srcFormat,
+			                                   m_data->VideoCodecContext->time_base,
+			                                   static_cast<AVPixelFormat>(target->format), &graph);
+			Marshal::FreeHGlobal(filters);
+			if (ret < 0)
+				throw gcnew IOException("avfilter_graph_parse_ptr");
+			m_data->FilterGraph = graph;
+			// the graph's output geometry may take the passthrough path or change the layout under the same buffer
+			InvalidateBorders(m_data->BorderState);
+		}
+
+		// a new reference is handed to the graph; the caller keeps its own
+		if (av_frame_ref(m_data->FilterFrame, avFrame) < 0)
+			throw gcnew OutOfMemoryException("av_frame_ref");
+		m_data->FilterFrame->pts = m_data->NextFilterPts++;
+		if (m_data->FilterGraph->Push(m_data->FilterFrame) < 0)
+		{
+			av_frame_unref(m_data->FilterFrame);
+			throw gcnew IOException("av_buffersrc_add_frame_flags");
+		}
+
+		DrainVideoFilter();
+	}
+
+	void MediaWriter::DrainVideoFilter()
+	{
+		int ret;
+		while ((ret = m_data->FilterGraph->Pull(m_data->FilterFrame)) >= 0)
+		{
+			WriteVideoFrame(m_data->FilterFrame);
+			av_frame_unref(m_data->FilterFrame);
+		}
+
+		if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+			throw gcnew IOException("av_buffersink_get_frame");
+	}
+
+	void MediaWriter::WriteVideoFrame(AVFrame* avFrame)
+	{
+		auto captureTimestamp = reinterpret_cast<intptr_t>(avFrame->opaque);
+		if (m_timestampSync && captureTimestamp != 0)
+		{
+			int repeat = SyncVideoFrame(m_data->SyncState, captureTimestamp, m_data->NextVideoPts,
+			                            m_data->VideoCodecContext->time_base);
+			if (repeat < 0)
+				return;
+
+			// the previous picture stays on screen for the frames that never arrived
+			if (m_videoFramesCount == 0)
+				m_data->NextVideoPts += repeat;
+			for (int i = 0; i < repeat && m_videoFramesCount > 0; i++)
 			{
-				m_data->SwsContext = sws_getContext(avFrame->width, avFrame->height,
-				                                    static_cast<AVPixelFormat>(avFrame->format),
-				                                    m_data->VideoCodecContext->width, m_data->VideoCodecContext->height,
-				                                    m_data->VideoCodecContext->pix_fmt,
-				                                    SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
-				m_data->SwsSrcWidth = avFrame->width;
-				m_data->SwsSrcHeight = avFrame->height;
-				m_data->SwsSrcFormat = static_cast<AVPixelFormat>(avFrame->format);
+				m_data->VideoFrame->pts = m_data->NextVideoPts++;
+				m_data->VideoFrame->opaque = nullptr;
+				write_frame(m_data->FormatContext, m_data->VideoCodecContext, m_data->VideoStream,
+				            m_data->VideoFrame, m_data->VideoLatency, m_data->KeyframeIndex);
+				m_videoFramesCount++;
 			}
 		}
 
-		if (m_data->VideoCodecContext->hw_frames_ctx != nullptr)
+		auto srcFormat = static_cast<AVPixelFormat>(avFrame->format);
+
+		bool hardware = m_data->VideoCodecContext->hw_frames_ctx != nullptr;
+		AVFrame* target = hardware ? m_data->SoftwareVideoFrame : m_data->VideoFrame;
+		auto targetFormat = static_cast<AVPixelFormat>(target->format);
+		bool passthrough = avFrame->width == target->width && avFrame->height == target->height && srcFormat ==
+			targetFormat;
+		ScaleLayout layout = ComputeScaleLayout(avFrame->width, avFrame->height, target->width, target->height,
+		                                        m_scaleMode);
+
+		if (avFrame->width != m_data->SwsSrcWidth || avFrame->height != m_data->SwsSrcHeight || srcFormat !=
+			m_data->SwsSrcFormat || m_scaleMode != m_data->SwsScaleMode)
 		{
-			if (m_data->SwsContext != nullptr && (avFrame->width != m_data->VideoCodecContext->width || avFrame->height
-				!= m_data->VideoCodecContext->height || avFrame->format != AV_PIX_FMT_NV12))
+			if (m_data->SwsContext != nullptr)
 			{
-				sws_scale(m_data->SwsContext, avFrame->data, avFrame->linesize, 0, avFrame->height,
-				          m_data->SoftwareVideoFrame->data, m_data->SoftwareVideoFrame->linesize);
-				av_hwframe_transfer_data(m_data->VideoFrame, m_data->SoftwareVideoFrame, 0);
+				sws_freeContext(m_data->SwsContext);
+				m_data->SwsContext = nullptr;
 			}
-			else
+
+			if (!passthrough)
 			{
-				av_hwframe_transfer_data(m_data->VideoFrame, avFrame, 0);
+				m_data->SwsContext = CreateSlicedSwsContext(layout.srcW, layout.srcH, srcFormat, layout.dstW,
+				                                            layout.dstH, targetFormat, SWS_FAST_BILINEAR, 0);
 			}
+			m_data->SwsSrcWidth = avFrame->width;
+			m_data->SwsSrcHeight = avFrame->height;
+			m_data->SwsSrcFormat = srcFormat;
+			m_data->SwsScaleMode = m_scaleMode;
 		}
-		else
+
+		if (passthrough)
 		{
-			if (m_data->SwsContext != nullptr && (avFrame->width != m_data->VideoCodecContext->width || avFrame->height
-				!= m_data->VideoCodecContext->height || avFrame->format != m_data->VideoCodecContext->pix_fmt))
-			{
-				sws_scale(m_data->SwsContext, avFrame->data, avFrame->linesize, 0, avFrame->height,
-				          m_data->VideoFrame->data, m_data->VideoFrame->linesize);
-			}
+			// the copy covers the whole target, bars included
+			InvalidateBorders(m_data->BorderState);
+			if (hardware)
+				av_hwframe_transfer_data(m_data->VideoFrame, avFrame, 0);
 			else
-			{
 				av_frame_copy(m_data->VideoFrame, avFrame);
+		}
+		else
+		{
+			// The bars of a letterboxed frame are painted once per geometry; each frame only writes the content.
+			const uint8_t* srcRect[4];
+			uint8_t* dstRect[4];
+			OffsetPlanes(srcFormat, avFrame->data, avFrame->linesize, layout.srcX, layout.srcY, srcRect);
+			OffsetPlanes(targetFormat, target->data, target->linesize, layout.dstX, layout.dstY, dstRect);
+			UpdateBorders(m_data->BorderState, targetFormat, target->data, target->linesize, target->width,
+			              target->height, layout, m_data->VideoCodecContext->color_range);
+
+			if (!ConvertWithKernels(layout.srcW, layout.srcH, srcFormat, srcRect, avFrame->linesize, layout.dstW,
+			                        layout.dstH, targetFormat, dstRect, target->linesize,
+			                        m_data->VideoCodecContext->colorspace, m_data->VideoCodecContext->color_range,
+			                        m_data->BgraScratch) && m_data->SwsContext != nullptr)
+			{
+				ScaleSliced(m_data->SwsContext, layout.srcW, layout.srcH, srcFormat, srcRect, avFrame->linesize,
+				            layout.dstW, layout.dstH, targetFormat, dstRect, target->linesize);
 			}
+
+			if (hardware)
+				av_hwframe_transfer_data(m_data->VideoFrame, target, 0);
 		}
 
 		m_data->VideoFrame->pts = m_data->NextVideoPts++;
-		write_frame(m_data->FormatContext, m_data->VideoCodecContext, m_data->VideoStream, m_data->VideoFrame);
+		m_data->VideoFrame->opaque = avFrame->opaque;
+		write_frame(m_data->FormatContext, m_data->VideoCodecContext, m_data->VideoStream, m_data->VideoFrame,
+		            m_data->VideoLatency, m_data->KeyframeIndex);
 
 		//printf("%d %d", m_data->VideoCodecContext->time_base, m_data->VideoStream->time_base);
 
@@ -594,16 +919,100 @@ namespace MediaEncoder
 			AudioCodecContext == nullptr)
 			return;
 
-		auto avFrame = static_cast<AVFrame*>(audioFrame->NativePointer.ToPointer());
+		WriteAudioFrame(static_cast<AVFrame*>(audioFrame->NativePointer.ToPointer()));
+	}
 
+	void MediaWriter::EncodeAudioFrames(array<AudioFrame^>^ audioFrames, int offset, int count)
+	{
+		if (audioFrames == nullptr)
+			throw gcnew ArgumentNullException("audioFrames");
+		if (offset < 0 || count < 0 || offset > audioFrames->Length - count)
+			throw gcnew ArgumentOutOfRangeException("count");
+		if (m_data == nullptr || m_data->AudioCodecContext == nullptr)
+			return;
+
+		for (int i = offset; i < offset + count; i++)
+		{
+			AudioFrame^ audioFrame = audioFrames[i];
+			if (audioFrame == nullptr)
+				continue;
+
+			auto avFrame = static_cast<AVFrame*>(audioFrame->NativePointer.ToPointer());
+			if (avFrame != nullptr)
+				WriteAudioFrame(avFrame);
+		}
+	}
+
+	void MediaWriter::WriteAudioFrame(AVFrame* avFrame)
+	{
+		auto srcFormat = static_cast<AVSampleFormat>(avFrame->format);
+		if (m_data->SwrContext == nullptr || srcFormat != m_data->SwrSrcFormat || avFrame->sample_rate != m_data->
+			SwrSrcSampleRate || avFrame->channel_layout != m_data->SwrSrcChannelLayout || m_resamplerProfile != m_data->
+			SwrProfile)
+		{
+			if (m_data->SwrContext != nullptr)
+			{
+				SwrContext* c = m_data->SwrContext;
+				swr_free(&c);
+				m_data->SwrContext = nullptr;
+			}
+
+			m_data->SwrContext = swr_alloc_set_opts(
+				nullptr,
+				m_data->AudioCodecContext->channel_layout,
+				m_data->AudioCodecContext->sample_fmt,
+				m_data->AudioCodecContext->sample_rate,
+				avFrame->channel_layout, srcFormat, avFrame->sample_rate, 0, nullptr);
+			if (m_data->SwrContext == nullptr)
+				throw gcnew IOException("swr_alloc_set_opts");
+			ApplyResamplerProfile(m_data->SwrContext, m_resamplerProfile);
+			// compensation needs the resampler even for 1:1 rates; enabling it later would re-init swr and
+			// drop the samples it still buffers
+			if (m_timestampSync)
+				av_opt_set_int(m_data->SwrContext, "flags", SWR_FLAG_RESAMPLE, 0);
+			if (swr_init(m_data->SwrContext) < 0)
+				throw gcnew IOException("swr_init");
+
+			m_data->SwrSrcFormat = srcFormat;
+			m_data->SwrSrcSampleRate = avFrame->sample_rate;
+			m_data->SwrSrcChannelLayout = avFrame->channel_layout;
+			m_data->SwrProfile = m_resamplerProfile;
+		}
+
+		// frames drained from the resampler's delay line are attributed to the input that pushed them out
+		void* captureTimestamp = avFrame->opaque;
+		if (m_timestampSync && captureTimestamp != nullptr)
+		{
+			int sampleRate = m_data->AudioCodecContext->sample_rate;
+			// this frame comes out after what the resampler still holds
+			int64_t position = m_data->NextAudioPts + swr_get_delay(m_data->SwrContext, sampleRate);
+			int64_t gap;
+			int delta = SyncAudioFrame(m_data->SyncState, reinterpret_cast<intptr_t>(captureTimestamp), position,
+			                           sampleRate, sampleRate, &gap);
+			// silence is injected at the input rate and precedes this frame; dropping cuts the oldest output
+			if (gap > 0 && swr_inject_silence(m_data->SwrContext,
+			                                  static_cast<int>(av_rescale(gap, avFrame->sample_rate, sampleRate))) < 0)
+				throw gcnew IOException("swr_inject_silence");
+			if (gap < 0 && swr_drop_output(m_data->SwrContext, static_cast<int>(-gap)) < 0)
+				throw gcnew IOException("swr_drop_output");
+			// swr resets the compensation after distance samples, so it is re-armed with every frame
+			if (delta != 0 || m_data->SyncState->audioCompensation != 0)
+			{
+				if (swr_set_compensation(m_data->SwrContext, delta, sampleRate) < 0)
+					throw gcnew IOException("swr_set_compensation");
+				m_data->SyncState->audioCompensation = delta;
+			}
+		}
 		do
 		{
 			if (swr_convert_frame(m_data->SwrContext, m_data->AudioFrame, avFrame) < 0)
 				break;
 
 			m_data->AudioFrame->pts = m_data->NextAudioPts;
+			m_data->AudioFrame->opaque = captureTimestamp;
 			m_data->NextAudioPts += m_data->AudioFrame->nb_samples;
-			write_frame(m_data->FormatContext, m_data->AudioCodecContext, m_data->AudioStream, m_data->AudioFrame);
+			write_frame(m_data->FormatContext, m_data->AudioCodecContext, m_data->AudioStream, m_data->AudioFrame,
+			            m_data->AudioLatency, nullptr);
 			m_audioSamplesCount += m_data->AudioFrame->nb_samples;
 			avFrame = nullptr;
 		}
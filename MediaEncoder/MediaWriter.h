@@ -7,6 +7,9 @@ using namespace Runtime::InteropServices;
 
 #include "VideoFrame.h"
 #include "AudioFrame.h"
+#include "ScaleMode.h"
+#include "ResamplerProfile.h"
+#include "LatencyHistogram.h"
 
 namespace MediaEncoder
 {
@@ -106,6 +109,16 @@ namespace MediaEncoder
 	private:
 		String^ m_format;
 		String^ m_url;
+		MediaEncoder::ScaleMode m_scaleMode;
+		MediaEncoder::ResamplerProfile m_resamplerProfile;
+		String^ m_videoFilter;
+		int m_filterThreads;
+		bool m_timestampSync;
+		bool m_writeKeyframeIndex;
+		LatencyHistogram^ m_videoEncodeLatency;
+		LatencyHistogram^ m_videoMuxLatency;
+		LatencyHistogram^ m_audioEncodeLatency;
+		LatencyHistogram^ m_audioMuxLatency;
 
 		WriterPrivateData^ m_data;
 		bool m_disposed;
@@ -122,6 +135,12 @@ namespace MediaEncoder
 				throw gcnew ObjectDisposedException("The object was already disposed.");
 		}
 
+		void SubmitVideoFrame(AVFrame* avFrame);
+		void FilterVideoFrame(AVFrame* avFrame);
+		void DrainVideoFilter();
+		void WriteVideoFrame(AVFrame* avFrame);
+		void WriteAudioFrame(AVFrame* avFrame);
+
 	protected:
 		!MediaWriter()
 		{
@@ -165,6 +184,114 @@ namespace MediaEncoder
 			}
 		}
 
+		// How sources whose aspect ratio differs from Width/Height are mapped onto the encoded frame.
+		property MediaEncoder::ScaleMode ScaleMode
+		{
+			MediaEncoder::ScaleMode get()
+			{
+				return m_scaleMode;
+			}
+			void set(MediaEncoder::ScaleMode value)
+			{
+				CheckIfDisposed();
+				m_scaleMode = value;
+			}
+		}
+
+		// Optional avfilter description (e.g. "hqdn3d,fps=30") that every video frame passes through before it is
+		// scaled and encoded; null or empty disables the stage. Changes rebuild the graph on the next frame.
+		property String^ VideoFilter
+		{
+			String^ get()
+			{
+				return m_videoFilter;
+			}
+			void set(String^ value)
+			{
+				CheckIfDisposed();
+				m_videoFilter = value;
+			}
+		}
+
+		// AVFilterGraph::nb_threads for VideoFilter; 0 lets libavfilter decide.
+		property int FilterThreads
+		{
+			int get()
+			{
+				return m_filterThreads;
+			}
+			void set(int value)
+			{
+				CheckIfDisposed();
+				if (value < 0)
+					throw gcnew ArgumentOutOfRangeException("value");
+				m_filterThreads = value;
+			}
+		}
+
+		// Place frames on the timeline by their CaptureTimestamp instead of by counting them: video frames are
+		// repeated or dropped to stay on the capture clock. Audio drifting by more than 10 ms is stretched by up
+		// to 1% to follow it; a gap of more than 100 ms (sampleRate / 10, e.g. after a capture stall) is closed
+		// at once by inserting silence when audio lags, or by dropping the oldest samples when it runs ahead.
+		// Frames without a timestamp are still placed by counting.
+		property bool TimestampSync
+		{
+			bool get()
+			{
+				return m_timestampSync;
+			}
+			void set(bool value)
+			{
+				CheckIfDisposed();
+				m_timestampSync = value;
+			}
+		}
+
+		// Writes a KeyframeIndex sidecar (KeyframeIndex::GetPath) next to file outputs, listing the pts of each
+		// video keyframe; KeyframeIndex.h explains why it holds no byte offsets. Takes effect on Open.
+		property bool WriteKeyframeIndex
+		{
+			bool get()
+			{
+				return m_writeKeyframeIndex;
+			}
+			void set(bool value)
+			{
+				CheckIfDisposed();
+				m_writeKeyframeIndex = value;
+			}
+		}
+
+		property Int64 DroppedVideoFrames
+		{
+			Int64 get();
+		}
+
+		property Int64 DuplicatedVideoFrames
+		{
+			Int64 get();
+		}
+
+		// Smoothed offset of the audio stream from the capture clock; positive when audio lags.
+		property double AudioDriftMilliseconds
+		{
+			double get();
+		}
+
+		// Filter used when the audio has to be resampled, e.g. to 44100 Hz for rtmp.
+		property MediaEncoder::ResamplerProfile ResamplerProfile
+		{
+			MediaEncoder::ResamplerProfile get()
+			{
+				return m_resamplerProfile;
+			}
+			void set(MediaEncoder::ResamplerProfile value)
+			{
+				CheckIfDisposed();
+				m_resamplerProfile = value;
+			}
+		}
+
 		property int VideoNumerator
 		{
 			int get()
@@ -210,6 +337,47 @@ namespace MediaEncoder
 			}
 		}
 
+		// Capture-to-encoded and capture-to-muxed latency per frame, in microseconds, measured from the
+		// CaptureTimestamp of the frames passed in (frames without one are not counted). Reset by Open.
+		property LatencyHistogram^ VideoEncodeLatency
+		{
+			LatencyHistogram^ get()
+			{
+				return m_videoEncodeLatency;
+			}
+		}
+
+		property LatencyHistogram^ VideoMuxLatency
+		{
+			LatencyHistogram^ get()
+			{
+				return m_videoMuxLatency;
+			}
+		}
+
+		property LatencyHistogram^ AudioEncodeLatency
+		{
+			LatencyHistogram^ get()
+			{
+				return m_audioEncodeLatency;
+			}
+		}
+
+		property LatencyHistogram^ AudioMuxLatency
+		{
+			LatencyHistogram^ get()
+			{
+				return m_audioMuxLatency;
+			}
+		}
+
+		// Packed layout of the audio encoder's input format (FLT for AAC). Frames in this format only need to be
+		// interleaved by the writer; other formats are still accepted and converted.
+		property SampleFormat PreferredSampleFormat
+		{
+			SampleFormat get();
+		}
+
 		property bool IsInitialized
 		{
 			bool get()
@@ -240,5 +408,20 @@ namespace MediaEncoder
 
 		void EncodeVideoFrame(VideoFrame^ videoFrame);
 		void EncodeAudioFrame(AudioFrame^ audioFrame);
+
+		// Encode count frames starting at offset in one call, so that bursts of small audio packets or frames
+		// queued up during a stall cost a single transition. Null entries are skipped.
+		void EncodeVideoFrames(array<VideoFrame^>^ videoFrames, int offset, int count);
+		void EncodeAudioFrames(array<AudioFrame^>^ audioFrames, int offset, int count);
+
+		void EncodeVideoFrames(array<VideoFrame^>^ videoFrames)
+		{
+			EncodeVideoFrames(videoFrames, 0, videoFrames == nullptr ? 0 : videoFrames->Length);
+		}
+
+		void EncodeAudioFrames(array<AudioFrame^>^ audioFrames)
+		{
+			EncodeAudioFrames(audioFrames, 0, audioFrames == nullptr ? 0 : audioFrames->Length);
+		}
 	};
 }
@@ -0,0 +1,38 @@
+#include "pch.h"
+#include "ParallelRows.h"
+
+namespace MediaEncoder
+{
+	ref class RowsJob
+	{
+	public:
+		RowsKernel Kernel;
+		void* Context;
+		int Rows;
+		int Bands;
+
+		void Run(int band)
+		{
+			int firstRow = static_cast<int>(static_cast<int64_t>(Rows) * band / Bands);
+			int lastRow = static_cast<int>(static_cast<int64_t>(Rows) * (band + 1) / Bands);
+			Kernel(Context, firstRow, lastRow);
+		}
+	};
+
+	void ParallelRows(int rows, int minRowsPerBand, RowsKernel kernel, void* context)
+	{
+		int bands = min(Environment::ProcessorCount, rows / max(minRowsPerBand, 1));
+		if (bands <= 1)
+		{
+			kernel(context, 0, rows);
+			return;
+		}
+
+		auto job = gcnew RowsJob();
+		job->Kernel = kernel;
+		job->Context = context;
+		job->Rows = rows;
+		job->Bands = bands;
+		Threading::Tasks::Parallel::For(0, bands, gcnew Action<int>(job, &RowsJob::Run));
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace MediaEncoder
+{
+	typedef void (*RowsKernel)(void* context, int firstRow, int lastRow);
+
+	// Splits [0, rows) into at most one band per processor, each at least minRowsPerBand rows, and runs kernel on
+	// the thread pool. Returns once every band is done; small images run inline on the calling thread.
+	void ParallelRows(int rows, int minRowsPerBand, RowsKernel kernel, void* context);
+}
@@ -0,0 +1,647 @@
+#include "pch.h"
+#include "PixelConverter.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	// 15 bit fixed point. Luma is computed per pixel, chroma from the sum of each 2x2 block, hence the extra
+	// two bits of shift. ug/vg and yg absorb the rounding so gray maps exactly to 128 and white to 235/255.
+	struct YuvCoefficients
+	{
+		int16_t yb, yg, yr;
+		int16_t ub, ug, ur;
+		int16_t vb, vg, vr;
+		int yOffset;
+	};
+
+	static YuvCoefficients GetYuvCoefficients(AVColorSpace colorSpace, AVColorRange colorRange)
+	{
+		double kr = 0.299, kb = 0.114;
+		if (colorSpace == AVCOL_SPC_BT709)
+		{
+			kr = 0.2126;
+			kb = 0.0722;
+		}
+		double kg = 1.0 - kr - kb;
+
+		bool full = colorRange == AVCOL_RANGE_JPEG;
+		double yScale = full ? 1.0 : 219.0 / 255.0;
+		double cScale = full ? 1.0 : 224.0 / 255.0;
+
+		YuvCoefficients k;
+		int ySum = static_cast<int>(lrint(yScale * 32768));
+		k.yr = static_cast<int16_t>(lrint(kr * yScale * 32768));
+		k.yb = static_cast<int16_t>(lrint(kb * yScale * 32768));
+		k.yg = static_cast<int16_t>(FFMIN(ySum - k.yr - k.yb, INT16_MAX));
+
+		k.ub = static_cast<int16_t>(lrint(0.5 * cScale * 32768));
+		k.ur = static_cast<int16_t>(lrint(-kr / (2.0 * (1.0 - kb)) * cScale * 32768));
+		k.ug = static_cast<int16_t>(-k.ub - k.ur);
+
+		k.vr = k.ub;
+		k.vb = static_cast<int16_t>(lrint(-kb / (2.0 * (1.0 - kr)) * cScale * 32768));
+		k.vg = static_cast<int16_t>(-k.vr - k.vb);
+
+		k.yOffset = full ? 0 : 16;
+		return k;
+	}
+
+	static inline uint8_t ClampByte(int value)
+	{
+		return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+	}
+
+	static inline uint8_t BgraToY(const uint8_t* p, const YuvCoefficients& k, int round)
+	{
+		return ClampByte((k.yb * p[0] + k.yg * p[1] + k.yr * p[2] + round) >> 15);
+	}
+
+	// Reference version, also used for the columns left over by the vector kernels. An odd last column or row
+	// reuses its neighbour for the chroma block; y1 is nullptr when row1 only duplicates row0.
+	static void BgraRowsToYuvC(const uint8_t* row0, const uint8_t* row1, uint8_t* y0, uint8_t* y1, uint8_t* u,
+	                           uint8_t* v, int uvStep, int x, int width, const YuvCoefficients& k)
+	{
+		const int yRound = (k.yOffset << 15) + (1 << 14);
+		const int cRound = (128 << 17) + (1 << 16);
+
+		for (; x < width; x += 2)
+		{
+			int x1 = (x + 1 < width) ? x + 1 : x;
+			const uint8_t* p00 = row0 + x * 4;
+			const uint8_t* p01 = row0 + x1 * 4;
+			const uint8_t* p10 = row1 + x * 4;
+			const uint8_t* p11 = row1 + x1 * 4;
+
+			y0[x] = BgraToY(p00, k, yRound);
+			y0[x1] = BgraToY(p01, k, yRound);
+			if (y1 != nullptr)
+			{
+				y1[x] = BgraToY(p10, k, yRound);
+				y1[x1] = BgraToY(p11, k, yRound);
+			}
+
+			int b = p00[0] + p01[0] + p10[0] + p11[0];
+			int g = p00[1] + p01[1] + p10[1] + p11[1];
+			int r = p00[2] + p01[2] + p10[2] + p11[2];
+			u[(x / 2) * uvStep] = ClampByte((k.ub * b + k.ug * g + k.ur * r + cRound) >> 17);
+			v[(x / 2) * uvStep] = ClampByte((k.vb * b + k.vg * g + k.vr * r + cRound) >> 17);
+		}
+	}
+
+	static void SplitUvRowC(const uint8_t* uv, uint8_t* u, uint8_t* v, int x, int chromaWidth)
+	{
+		for (; x < chromaWidth; x++)
+		{
+			u[x] = uv[x * 2];
+			v[x] = uv[x * 2 + 1];
+		}
+	}
+
+	// The kernels below are written once against these wrappers. The AVX2 and AVX-512 packs and shuffles work
+	// within 128 bit lanes, so every step behaves like the SSE2 version run on each lane; OrderDwords and
+	// OrderQwords put the lanes back in memory order at the end.
+	struct Sse2
+	{
+		typedef __m128i V;
+		static const int Bytes = 16;
+
+		static __forceinline V Load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const V*>(p)); }
+		static __forceinline void Store(uint8_t* p, V v) { _mm_storeu_si128(reinterpret_cast<V*>(p), v); }
+		static __forceinline void StoreHalves(uint8_t* lo, uint8_t* hi, V v)
+		{
+			_mm_storel_epi64(reinterpret_cast<V*>(lo), v);
+			_mm_storel_epi64(reinterpret_cast<V*>(hi), _mm_unpackhi_epi64(v, v));
+		}
+		static __forceinline V Zero() { return _mm_setzero_si128(); }
+		static __forceinline V Set16(uint64_t q) { return _mm_set1_epi64x(static_cast<long long>(q)); }
+		static __forceinline V Set32(int value) { return _mm_set1_epi32(value); }
+		static __forceinline V UnpackLo8(V a, V b) { return _mm_unpacklo_epi8(a, b); }
+		static __forceinline V UnpackHi8(V a, V b) { return _mm_unpackhi_epi8(a, b); }
+		static __forceinline V UnpackLo64(V a, V b) { return _mm_unpacklo_epi64(a, b); }
+		static __forceinline V UnpackHi64(V a, V b) { return _mm_unpackhi_epi64(a, b); }
+		static __forceinline V Add16(V a, V b) { return _mm_add_epi16(a, b); }
+		static __forceinline V Add32(V a, V b) { return _mm_add_epi32(a, b); }
+		static __forceinline V Madd(V a, V b) { return _mm_madd_epi16(a, b); }
+		static __forceinline V Srai32(V a, int n) { return _mm_srai_epi32(a, n); }
+		static __forceinline V Srli16(V a, int n) { return _mm_srli_epi16(a, n); }
+		static __forceinline V And(V a, V b) { return _mm_and_si128(a, b); }
+		static __forceinline V Packs32(V a, V b) { return _mm_packs_epi32(a, b); }
+		static __forceinline V PackUs16(V a, V b) { return _mm_packus_epi16(a, b); }
+		static __forceinline V PairSum(V a, V b)
+		{
+			__m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+			return _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0))),
+			                     _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1))));
+		}
+		static __forceinline V Shuffle3120(V a) { return _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)); }
+		static __forceinline V OrderDwords(V a) { return a; }
+		static __forceinline V OrderQwords(V a) { return a; }
+		static __forceinline void End() {}
+	};
+
+	struct Avx2
+	{
+		typedef __m256i V;
+		static const int Bytes = 32;
+
+		static __forceinline V Load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const V*>(p)); }
+		static __forceinline void Store(uint8_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<V*>(p), v); }
+		static __forceinline void StoreHalves(uint8_t* lo, uint8_t* hi, V v)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lo), _mm256_castsi256_si128(v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(hi), _mm256_extracti128_si256(v, 1));
+		}
+		static __forceinline V Zero() { return _mm256_setzero_si256(); }
+		static __forceinline V Set16(uint64_t q) { return _mm256_set1_epi64x(static_cast<long long>(q)); }
+		static __forceinline V Set32(int value) { return _mm256_set1_epi32(value); }
+		static __forceinline V UnpackLo8(V a, V b) { return _mm256_unpacklo_epi8(a, b); }
+		static __forceinline V UnpackHi8(V a, V b) { return _mm256_unpackhi_epi8(a, b); }
+		static __forceinline V UnpackLo64(V a, V b) { return _mm256_unpacklo_epi64(a, b); }
+		static __forceinline V UnpackHi64(V a, V b) { return _mm256_unpackhi_epi64(a, b); }
+		static __forceinline V Add16(V a, V b) { return _mm256_add_epi16(a, b); }
+		static __forceinline V Add32(V a, V b) { return _mm256_add_epi32(a, b); }
+		static __forceinline V Madd(V a, V b) { return _mm256_madd_epi16(a, b); }
+		static __forceinline V Srai32(V a, int n) { return _mm256_srai_epi32(a, n); }
+		static __forceinline V Srli16(V a, int n) { return _mm256_srli_epi16(a, n); }
+		static __forceinline V And(V a, V b) { return _mm256_and_si256(a, b); }
+		static __forceinline V Packs32(V a, V b) { return _mm256_packs_epi32(a, b); }
+		static __forceinline V PackUs16(V a, V b) { return _mm256_packus_epi16(a, b); }
+		static __forceinline V PairSum(V a, V b)
+		{
+			__m256 fa = _mm256_castsi256_ps(a), fb = _mm256_castsi256_ps(b);
+			return _mm256_add_epi32(_mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0))),
+			                        _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1))));
+		}
+		static __forceinline V Shuffle3120(V a) { return _mm256_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)); }
+		static __forceinline V OrderDwords(V a)
+		{
+			return _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+		}
+		static __forceinline V OrderQwords(V a) { return _mm256_permute4x64_epi64(a, _MM_SHUFFLE(3, 1, 2, 0)); }
+		static __forceinline void End() { _mm256_zeroupper(); }
+	};
+
+	struct Avx512
+	{
+		typedef __m512i V;
+		static const int Bytes = 64;
+
+		static __forceinline V Load(const uint8_t* p) { return _mm512_loadu_si512(p); }
+		static __forceinline void Store(uint8_t* p, V v) { _mm512_storeu_si512(p, v); }
+		static __forceinline void StoreHalves(uint8_t* lo, uint8_t* hi, V v)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(lo), _mm512_castsi512_si256(v));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(hi), _mm512_extracti64x4_epi64(v, 1));
+		}
+		static __forceinline V Zero() { return _mm512_setzero_si512(); }
+		static __forceinline V Set16(uint64_t q) { return _mm512_set1_epi64(static_cast<long long>(q)); }
+		static __forceinline V Set32(int value) { return _mm512_set1_epi32(value); }
+		static __forceinline V UnpackLo8(V a, V b) { return _mm512_unpacklo_epi8(a, b); }
+		static __forceinline V UnpackHi8(V a, V b) { return _mm512_unpackhi_epi8(a, b); }
+		static __forceinline V UnpackLo64(V a, V b) { return _mm512_unpacklo_epi64(a, b); }
+		static __forceinline V UnpackHi64(V a, V b) { return _mm512_unpackhi_epi64(a, b); }
+		static __forceinline V Add16(V a, V b) { return _mm512_add_epi16(a, b); }
+		static __forceinline V Add32(V a, V b) { return _mm512_add_epi32(a, b); }
+		static __forceinline V Madd(V a, V b) { return _mm512_madd_epi16(a, b); }
+		static __forceinline V Srai32(V a, int n) { return _mm512_srai_epi32(a, n); }
+		static __forceinline V Srli16(V a, int n) { return _mm512_srli_epi16(a, n); }
+		static __forceinline V And(V a, V b) { return _mm512_and_si512(a, b); }
+		static __forceinline V Packs32(V a, V b) { return _mm512_packs_epi32(a, b); }
+		static __forceinline V PackUs16(V a, V b) { return _mm512_packus_epi16(a, b); }
+		static __forceinline V PairSum(V a, V b)
+		{
+			__m512 fa = _mm512_castsi512_ps(a), fb = _mm512_castsi512_ps(b);
+			return _mm512_add_epi32(_mm512_castps_si512(_mm512_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0))),
+			                        _mm512_castps_si512(_mm512_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1))));
+		}
+		static __forceinline V Shuffle3120(V a)
+		{
+			return _mm512_shuffle_epi32(a, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(3, 1, 2, 0)));
+		}
+		static __forceinline V OrderDwords(V a)
+		{
+			return _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15),
+			                                a);
+		}
+		static __forceinline V OrderQwords(V a)
+		{
+			return _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7), a);
+		}
+		static __forceinline void End() { _mm256_zeroupper(); }
+	};
+
+	static inline uint64_t PackWords(int16_t a, int16_t b, int16_t c, int16_t d)
+	{
+		return static_cast<uint64_t>(static_cast<uint16_t>(a)) | static_cast<uint64_t>(static_cast<uint16_t>(b)) <<
+			16 | static_cast<uint64_t>(static_cast<uint16_t>(c)) << 32 | static_cast<uint64_t>(static_cast<uint16_t>(d))
+			<< 48;
+	}
+
+	// Converts one pair of rows, one register of luma per row per iteration. Returns the number of pixels done;
+	// the caller finishes the row with the scalar version.
+	template <class S, bool Interleaved>
+	static int BgraRowsToYuv(const uint8_t* row0, const uint8_t* row1, uint8_t* y0, uint8_t* y1, uint8_t* u,
+	                         uint8_t* v, int width, const YuvCoefficients& k)
+	{
+		typedef typename S::V V;
+
+		const V yCoef = S::Set16(PackWords(k.yb, k.yg, k.yr, 0));
+		const V uCoef = S::Set16(PackWords(k.ub, k.ug, k.ur, 0));
+		const V vCoef = S::Set16(PackWords(k.vb, k.vg, k.vr, 0));
+		const V yRound = S::Set32((k.yOffset << 15) + (1 << 14));
+		const V cRound = S::Set32((128 << 17) + (1 << 16));
+		const V lowBytes = S::Set16(0x00FF00FF00FF00FFull);
+		const V zero = S::Zero();
+
+		int x = 0;
+		for (; x + S::Bytes <= width; x += S::Bytes)
+		{
+			V luma0[4], luma1[4], chroma[4];
+			for (int i = 0; i < 4; i++)
+			{
+				V a = S::Load(row0 + x * 4 + i * S::Bytes);
+				V b = S::Load(row1 + x * 4 + i * S::Bytes);
+				V aLo = S::UnpackLo8(a, zero), aHi = S::UnpackHi8(a, zero);
+				V bLo = S::UnpackLo8(b, zero), bHi = S::UnpackHi8(b, zero);
+
+				luma0[i] = S::Srai32(S::Add32(S::PairSum(S::Madd(aLo, yCoef), S::Madd(aHi, yCoef)), yRound), 15);
+				luma1[i] = S::Srai32(S::Add32(S::PairSum(S::Madd(bLo, yCoef), S::Madd(bHi, yCoef)), yRound), 15);
+
+				// B G R A sums of the two 2x2 blocks of these four columns.
+				V lo = S::Add16(aLo, bLo), hi = S::Add16(aHi, bHi);
+				V sums = S::Add16(S::UnpackLo64(lo, hi), S::UnpackHi64(lo, hi));
+				V uv = S::PairSum(S::Madd(sums, uCoef), S::Madd(sums, vCoef));
+				chroma[i] = S::Srai32(S::Add32(S::Shuffle3120(uv), cRound), 17);
+			}
+
+			S::Store(y0 + x, S::OrderDwords(S::PackUs16(S::Packs32(luma0[0], luma0[1]),
+			                                            S::Packs32(luma0[2], luma0[3]))));
+			if (y1 != nullptr)
+				S::Store(y1 + x, S::OrderDwords(S::PackUs16(S::Packs32(luma1[0], luma1[1]),
+				                                            S::Packs32(luma1[2], luma1[3]))));
+
+			V uv = S::OrderDwords(S::PackUs16(S::Packs32(chroma[0], chroma[1]), S::Packs32(chroma[2], chroma[3])));
+			if (Interleaved)
+				S::Store(u + x, uv);
+			else
+				S::StoreHalves(u + x / 2, v + x / 2,
+				               S::OrderQwords(S::PackUs16(S::And(uv, lowBytes), S::Srli16(uv, 8))));
+		}
+
+		S::End();
+		return x;
+	}
+
+	template <class S>
+	static int SplitUvRow(const uint8_t* uv, uint8_t* u, uint8_t* v, int chromaWidth)
+	{
+		typedef typename S::V V;
+
+		const V lowBytes = S::Set16(0x00FF00FF00FF00FFull);
+
+		int x = 0;
+		for (; x + S::Bytes <= chromaWidth; x += S::Bytes)
+		{
+			V a = S::Load(uv + x * 2);
+			V b = S::Load(uv + x * 2 + S::Bytes);
+			S::Store(u + x, S::OrderQwords(S::PackUs16(S::And(a, lowBytes), S::And(b, lowBytes))));
+			S::Store(v + x, S::OrderQwords(S::PackUs16(S::Srli16(a, 8), S::Srli16(b, 8))));
+		}
+
+		S::End();
+		return x;
+	}
+
+	static int BgraRowsToYuvNone(const uint8_t* row0, const uint8_t* row1, uint8_t* y0, uint8_t* y1, uint8_t* u,
+	                             uint8_t* v, int width, const YuvCoefficients& k)
+	{
+		return 0;
+	}
+
+	static int SplitUvRowNone(const uint8_t* uv, uint8_t* u, uint8_t* v, int chromaWidth)
+	{
+		return 0;
+	}
+
+	typedef int (*BgraRowsFunc)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, int,
+	                            const YuvCoefficients&);
+	typedef int (*SplitUvRowFunc)(const uint8_t*, uint8_t*, uint8_t*, int);
+
+	struct PixelKernels
+	{
+		const char* Name;
+		BgraRowsFunc BgraToNv12;
+		BgraRowsFunc BgraToYuv420p;
+		SplitUvRowFunc SplitUv;
+	};
+
+	// Widest first; the last entry is the scalar path and always usable.
+	static const PixelKernels AllPixelKernels[] = {
+		{"avx512", BgraRowsToYuv<Avx512, true>, BgraRowsToYuv<Avx512, false>, SplitUvRow<Avx512>},
+		{"avx2", BgraRowsToYuv<Avx2, true>, BgraRowsToYuv<Avx2, false>, SplitUvRow<Avx2>},
+		{"sse2", BgraRowsToYuv<Sse2, true>, BgraRowsToYuv<Sse2, false>, SplitUvRow<Sse2>},
+		{"c", BgraRowsToYuvNone, BgraRowsToYuvNone, SplitUvRowNone},
+	};
+	static const int AllPixelKernelFlags[] = {AV_CPU_FLAG_AVX512, AV_CPU_FLAG_AVX2, AV_CPU_FLAG_SSE2, 0};
+	static const int PixelKernelCount = sizeof(AllPixelKernels) / sizeof(AllPixelKernels[0]);
+
+	static uint32_t NextRandom(uint32_t* state)
+	{
+		// xorshift32, only needs to be fixed and cheap
+		uint32_t x = *state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		*state = x;
+		return x;
+	}
+
+	// Runs the vector kernels plus the scalar tail, as the converters do, against the scalar version alone on
+	// random pixels, for widths around every register size, both row pair shapes and all coefficient sets.
+	static bool VerifyKernels(const PixelKernels& kernels)
+	{
+		const int MaxWidth = 64 * 4 + 5;
+		const int Planes = 4;
+		uint8_t rows[2][MaxWidth * 4];
+		uint8_t expected[Planes][MaxWidth + 64];
+		uint8_t actual[Planes][MaxWidth + 64];
+
+		uint32_t seed = 0x9E3779B9;
+		for (int i = 0; i < 2; i++)
+		{
+			for (int j = 0; j < MaxWidth * 4; j++)
+				rows[i][j] = static_cast<uint8_t>(NextRandom(&seed) >> 24);
+		}
+
+		static const int widths[] = {1, 2, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, MaxWidth};
+		static const AVColorSpace spaces[] = {AVCOL_SPC_SMPTE170M, AVCOL_SPC_BT709};
+		static const AVColorRange ranges[] = {AVCOL_RANGE_MPEG, AVCOL_RANGE_JPEG};
+
+		for (int width : widths)
+		{
+			for (int variant = 0; variant < 4; variant++)
+			{
+				bool interleaved = (variant & 1) != 0;
+				bool pair = (variant & 2) != 0;
+				BgraRowsFunc function = interleaved ? kernels.BgraToNv12 : kernels.BgraToYuv420p;
+				int uvStep = interleaved ? 2 : 1;
+				const uint8_t* row1 = pair ? rows[1] : rows[0];
+
+				for (AVColorSpace space : spaces)
+				{
+					for (AVColorRange range : ranges)
+					{
+						YuvCoefficients k = GetYuvCoefficients(space, range);
+						memset(expected, 0, sizeof(expected));
+						memset(actual, 0, sizeof(actual));
+
+						BgraRowsToYuvC(rows[0], row1, expected[0], pair ? expected[1] : nullptr, expected[2],
+						               interleaved ? expected[2] + 1 : expected[3], uvStep, 0, width, k);
+						int x = function(rows[0], row1, actual[0], pair ? actual[1] : nullptr, actual[2],
+						                 interleaved ? actual[2] + 1 : actual[3], width, k);
+						BgraRowsToYuvC(rows[0], row1, actual[0], pair ? actual[1] : nullptr, actual[2],
+						               interleaved ? actual[2] + 1 : actual[3], uvStep, x, width, k);
+						if (memcmp(expected, actual, sizeof(expected)) != 0)
+							return false;
+					}
+				}
+			}
+
+			// rows[0] doubles as interleaved chroma of up to MaxWidth * 2 samples
+			memset(expected, 0, sizeof(expected));
+			memset(actual, 0, sizeof(actual));
+			SplitUvRowC(rows[0], expected[0], expected[1], 0, width);
+			int x = kernels.SplitUv(rows[0], actual[0], actual[1], width);
+			SplitUvRowC(rows[0], actual[0], actual[1], x, width);
+			if (memcmp(expected, actual, sizeof(expected)) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	// Index into AllPixelKernels, -1 until the first call picks it.
+	static volatile LONG SelectedPixelKernels = -1;
+
+	static PixelKernels SelectPixelKernels()
+	{
+		LONG selected = SelectedPixelKernels;
+		if (selected < 0)
+		{
+			// av_get_cpu_flags runs CPUID once and also checks that the OS saves the wider registers. A variant
+			// that does not reproduce the scalar output is skipped; concurrent first calls pick the same one.
+			int flags = av_get_cpu_flags();
+			for (selected = 0; selected < PixelKernelCount - 1; selected++)
+			{
+				if (!(flags & AllPixelKernelFlags[selected]))
+					continue;
+				if (VerifyKernels(AllPixelKernels[selected]))
+					break;
+				av_log(nullptr, AV_LOG_ERROR, "PixelConverter: %s kernels differ from the scalar path, not used\n",
+				       AllPixelKernels[selected].Name);
+			}
+			InterlockedExchange(&SelectedPixelKernels, selected);
+		}
+		return AllPixelKernels[selected];
+	}
+
+	static void ConvertBgraToYuv(const PixelKernels& kernels, int width, int height, const uint8_t* src,
+	                             int srcStride, uint8_t* const dst[4], const int dstStride[4], bool interleaved,
+	                             const YuvCoefficients& k)
+	{
+		BgraRowsFunc rows = interleaved ? kernels.BgraToNv12 : kernels.BgraToYuv420p;
+		uint8_t* dstU = dst[1];
+		uint8_t* dstV = interleaved ? dst[1] + 1 : dst[2];
+		int uStride = dstStride[1];
+		int vStride = interleaved ? dstStride[1] : dstStride[2];
+		int uvStep = interleaved ? 2 : 1;
+
+		for (int y = 0; y < height; y += 2)
+		{
+			bool pair = y + 1 < height;
+			const uint8_t* row0 = src + static_cast<ptrdiff_t>(y) * srcStride;
+			const uint8_t* row1 = pair ? row0 + srcStride : row0;
+			uint8_t* y0 = dst[0] + static_cast<ptrdiff_t>(y) * dstStride[0];
+			uint8_t* y1 = pair ? y0 + dstStride[0] : nullptr;
+			uint8_t* u = dstU + static_cast<ptrdiff_t>(y / 2) * uStride;
+			uint8_t* v = dstV + static_cast<ptrdiff_t>(y / 2) * vStride;
+
+			int x = rows(row0, row1, y0, y1, u, v, width, k);
+			BgraRowsToYuvC(row0, row1, y0, y1, u, v, uvStep, x, width, k);
+		}
+	}
+
+	static void ConvertNv12ToYuv420p(const PixelKernels& kernels, int width, int height, const uint8_t* const src[4],
+	                                 const int srcStride[4], uint8_t* const dst[4], const int dstStride[4])
+	{
+		for (int y = 0; y < height; y++)
+			memcpy(dst[0] + static_cast<ptrdiff_t>(y) * dstStride[0],
+			       src[0] + static_cast<ptrdiff_t>(y) * srcStride[0], width);
+
+		int chromaWidth = (width + 1) / 2;
+		int chromaHeight = (height + 1) / 2;
+		for (int y = 0; y < chromaHeight; y++)
+		{
+			const uint8_t* uv = src[1] + static_cast<ptrdiff_t>(y) * srcStride[1];
+			uint8_t* u = dst[1] + static_cast<ptrdiff_t>(y) * dstStride[1];
+			uint8_t* v = dst[2] + static_cast<ptrdiff_t>(y) * dstStride[2];
+
+			int x = kernels.SplitUv(uv, u, v, chromaWidth);
+			SplitUvRowC(uv, u, v, x, chromaWidth);
+		}
+	}
+
+	static inline uint32_t AverageBgra(uint32_t p0, uint32_t p1, uint32_t p2, uint32_t p3)
+	{
+		uint32_t rb = (((p0 & 0x00FF00FF) + (p1 & 0x00FF00FF) + (p2 & 0x00FF00FF) + (p3 & 0x00FF00FF) + 0x00020002) >>
+			2) & 0x00FF00FF;
+		uint32_t ag = ((((p0 >> 8) & 0x00FF00FF) + ((p1 >> 8) & 0x00FF00FF) + ((p2 >> 8) & 0x00FF00FF) + ((p3 >> 8) &
+			0x00FF00FF) + 0x00020002) >> 2 & 0x00FF00FF) << 8;
+		return rb | ag;
+	}
+
+	static void HalveBgraRow(const uint8_t* src, int srcStride, int y, int dstW, uint32_t* dst)
+	{
+		auto row0 = reinterpret_cast<const uint32_t*>(src + static_cast<ptrdiff_t>(y * 2) * srcStride);
+		auto row1 = reinterpret_cast<const uint32_t*>(src + static_cast<ptrdiff_t>(y * 2 + 1) * srcStride);
+		for (int x = 0; x < dstW; x++)
+			dst[x] = AverageBgra(row0[x * 2], row0[x * 2 + 1], row1[x * 2], row1[x * 2 + 1]);
+	}
+
+	void FreeBgraScaleScratch(BgraScaleScratch* scratch)
+	{
+		av_freep(&scratch->data);
+		scratch->srcW = scratch->srcH = scratch->dstW = scratch->dstH = 0;
+	}
+
+	bool ScaleBgraToYuv(const uint8_t* src, int srcStride, int srcW, int srcH, AVPixelFormat dstFormat,
+	                    uint8_t* const dst[4], const int dstStride[4], int dstW, int dstH, AVColorSpace colorSpace,
+	                    AVColorRange colorRange, BgraScaleScratch* scratch)
+	{
+		if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0 || !CanConvertPixels(AV_PIX_FMT_BGRA, dstFormat))
+			return false;
+
+		// Only the exact 2:1 box is done here; any other ratio needs a filter whose support follows the ratio,
+		// which is what swscale is for.
+		if (dstW * 2 != srcW || dstH * 2 != srcH)
+			return false;
+
+		bool interleaved = dstFormat == AV_PIX_FMT_NV12;
+
+		// Two destination rows of BGRA, small enough to stay in cache while the row kernels turn them into YUV,
+		// so the source is read once and nothing full size is written twice.
+		size_t rowBytes = FFALIGN(static_cast<size_t>(dstW) * 4, 64);
+		if (scratch->data == nullptr || scratch->srcW != srcW || scratch->srcH != srcH || scratch->dstW != dstW ||
+			scratch->dstH != dstH)
+		{
+			FreeBgraScaleScratch(scratch);
+			scratch->data = static_cast<uint8_t*>(av_malloc(rowBytes * 2));
+			if (scratch->data == nullptr)
+				return false;
+			scratch->srcW = srcW;
+			scratch->srcH = srcH;
+			scratch->dstW = dstW;
+			scratch->dstH = dstH;
+		}
+
+		uint8_t* buffer = scratch->data;
+		auto rows = reinterpret_cast<uint32_t*>(buffer);
+
+		PixelKernels kernels = SelectPixelKernels();
+		BgraRowsFunc rowsToYuv = interleaved ? kernels.BgraToNv12 : kernels.BgraToYuv420p;
+		YuvCoefficients k = GetYuvCoefficients(colorSpace, colorRange);
+		uint8_t* dstU = dst[1];
+		uint8_t* dstV = interleaved ? dst[1] + 1 : dst[2];
+		int uStride = dstStride[1];
+		int vStride = interleaved ? dstStride[1] : dstStride[2];
+		auto row0 = reinterpret_cast<const uint8_t*>(rows);
+		auto row1 = row0 + rowBytes;
+
+		for (int y = 0; y < dstH; y += 2)
+		{
+			bool pair = y + 1 < dstH;
+			HalveBgraRow(src, srcStride, y, dstW, rows);
+			if (pair)
+				HalveBgraRow(src, srcStride, y + 1, dstW, reinterpret_cast<uint32_t*>(buffer + rowBytes));
+
+			uint8_t* y0 = dst[0] + static_cast<ptrdiff_t>(y) * dstStride[0];
+			uint8_t* y1 = pair ? y0 + dstStride[0] : nullptr;
+			uint8_t* u = dstU + static_cast<ptrdiff_t>(y / 2) * uStride;
+			uint8_t* v = dstV + static_cast<ptrdiff_t>(y / 2) * vStride;
+			const uint8_t* r1 = pair ? row1 : row0;
+
+			int x = rowsToYuv(row0, r1, y0, y1, u, v, dstW, k);
+			BgraRowsToYuvC(row0, r1, y0, y1, u, v, interleaved ? 2 : 1, x, dstW, k);
+		}
+
+		return true;
+	}
+
+	bool CanConvertPixels(AVPixelFormat srcFormat, AVPixelFormat dstFormat)
+	{
+		if (srcFormat == AV_PIX_FMT_BGRA)
+			return dstFormat == AV_PIX_FMT_NV12 || dstFormat == AV_PIX_FMT_YUV420P;
+		if (srcFormat == AV_PIX_FMT_NV12)
+			return dstFormat == AV_PIX_FMT_YUV420P;
+		return false;
+	}
+
+	bool ConvertPixels(int width, int height, AVPixelFormat srcFormat, const uint8_t* const src[4],
+	                   const int srcStride[4], AVPixelFormat dstFormat, uint8_t* const dst[4], const int dstStride[4],
+	                   AVColorSpace colorSpace, AVColorRange colorRange)
+	{
+		if (width <= 0 || height <= 0 || !CanConvertPixels(srcFormat, dstFormat))
+			return false;
+
+		PixelKernels kernels = SelectPixelKernels();
+		if (srcFormat == AV_PIX_FMT_BGRA)
+		{
+			ConvertBgraToYuv(kernels, width, height, src[0], srcStride[0], dst, dstStride,
+			                 dstFormat == AV_PIX_FMT_NV12, GetYuvCoefficients(colorSpace, colorRange));
+		}
+		else
+		{
+			ConvertNv12ToYuv420p(kernels, width, height, src, srcStride, dst, dstStride);
+		}
+		return true;
+	}
+
+	bool ConvertWithKernels(int srcW, int srcH, AVPixelFormat srcFormat, const uint8_t* const src[4],
+	                        const int srcStride[4], int dstW, int dstH, AVPixelFormat dstFormat, uint8_t* const dst[4],
+	                        const int dstStride[4], AVColorSpace colorSpace, AVColorRange colorRange,
+	                        BgraScaleScratch* scratch)
+	{
+		if (srcW == dstW && srcH == dstH)
+			return ConvertPixels(srcW, srcH, srcFormat, src, srcStride, dstFormat, dst, dstStride, colorSpace,
+			                     colorRange);
+
+		if (srcFormat == AV_PIX_FMT_BGRA)
+			return ScaleBgraToYuv(src[0], srcStride[0], srcW, srcH, dstFormat, dst, dstStride, dstW, dstH, colorSpace,
+			                      colorRange, scratch);
+
+		return false;
+	}
+
+	const char* GetPixelKernelName()
+	{
+		return SelectPixelKernels().Name;
+	}
+
+	bool VerifyPixelKernels()
+	{
+		int flags = av_get_cpu_flags();
+		for (int i = 0; i < PixelKernelCount - 1; i++)
+		{
+			if ((flags & AllPixelKernelFlags[i]) && !VerifyKernels(AllPixelKernels[i]))
+				return false;
+		}
+		return true;
+	}
+#pragma managed(pop)
+}
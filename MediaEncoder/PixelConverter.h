@@ -0,0 +1,39 @@
+#pragma once
+
+namespace MediaEncoder
+{
+	// Same-size conversions for the format pairs the capture pipeline produces most of the time
+	// (BGRA -> NV12, BGRA -> YUV420P, NV12 -> YUV420P), without going through swscale.
+	// The SSE2/AVX2/AVX-512 variants are picked from the CPU flags and all produce exactly the output of the
+	// scalar version; on first use the chosen variant is checked against it and skipped if it differs.
+	// Benchmark (pixels mode) compares the result with swscale for each colorspace and range.
+	bool CanConvertPixels(AVPixelFormat srcFormat, AVPixelFormat dstFormat);
+	bool ConvertPixels(int width, int height, AVPixelFormat srcFormat, const uint8_t* const src[4],
+	                   const int srcStride[4], AVPixelFormat dstFormat, uint8_t* const dst[4], const int dstStride[4],
+	                   AVColorSpace colorSpace, AVColorRange colorRange);
+
+	// Row buffers of ScaleBgraToYuv, kept by the caller between frames and only rebuilt when the geometry
+	// changes. Zero-initialize it and release it with FreeBgraScaleScratch.
+	struct BgraScaleScratch
+	{
+		uint8_t* data;
+		int srcW, srcH, dstW, dstH;
+	};
+
+	void FreeBgraScaleScratch(BgraScaleScratch* scratch);
+
+	// Halves a BGRA image (or a rectangle of one, by offsetting src) with an exact 2x2 box and converts it to
+	// NV12/YUV420P in one pass. Returns false for any other ratio, which is left to swscale.
+	bool ScaleBgraToYuv(const uint8_t* src, int srcStride, int srcW, int srcH, AVPixelFormat dstFormat,
+	                    uint8_t* const dst[4], const int dstStride[4], int dstW, int dstH, AVColorSpace colorSpace,
+	                    AVColorRange colorRange, BgraScaleScratch* scratch);
+	// ConvertPixels when the sizes match, ScaleBgraToYuv for BGRA sources of exactly twice the size; false
+	// otherwise, so the caller falls back to swscale.
+	bool ConvertWithKernels(int srcW, int srcH, AVPixelFormat srcFormat, const uint8_t* const src[4],
+	                        const int srcStride[4], int dstW, int dstH, AVPixelFormat dstFormat, uint8_t* const dst[4],
+	                        const int dstStride[4], AVColorSpace colorSpace, AVColorRange colorRange,
+	                        BgraScaleScratch* scratch);
+	const char* GetPixelKernelName();
+	// Checks every variant this CPU supports against the scalar version on random input.
+	bool VerifyPixelKernels();
+}
@@ -8,10 +8,29 @@ namespace MediaEncoder
 		m_swrContext(nullptr), m_srcChannels(-1),
 		m_destChannels(-1), m_srcSampleFormat(SampleFormat::NONE), m_destSampleFormat(SampleFormat::NONE),
 		m_srcSampleRate(-1), m_destSampleRate(-1), m_resampledBuffer(nullptr),
-		m_resampledBufferSampleSize(-1), m_resampledBufferSize(-1), m_disposed(false)
+		m_resampledBufferSampleSize(-1), m_resampledBufferSize(-1), m_outputBuffer(nullptr), m_outputSampleBytes(0),
+		m_flushed(false), m_framePool(nullptr), m_driftEstimator(nullptr), m_targetBufferedSamples(0),
+		m_averageBufferedSamples(0), m_compensationDelta(0), m_profile(ResamplerProfile::Balanced), m_disposed(false)
 	{
 	}
 
+	Resampler::Resampler(int destChannels, SampleFormat destSampleFormat, int destSampleRate, int bufferSamples)
+		:
+		m_swrContext(nullptr), m_srcChannels(-1),
+		m_destChannels(destChannels), m_srcSampleFormat(SampleFormat::NONE), m_destSampleFormat(destSampleFormat),
+		m_srcSampleRate(-1), m_destSampleRate(destSampleRate), m_resampledBuffer(nullptr),
+		m_resampledBufferSampleSize(-1), m_resampledBufferSize(-1), m_flushed(false), m_driftEstimator(nullptr),
+		m_targetBufferedSamples(0), m_averageBufferedSamples(0), m_compensationDelta(0),
+		m_profile(ResamplerProfile::Balanced), m_disposed(false)
+	{
+		if (av_sample_fmt_is_planar(static_cast<AVSampleFormat>(destSampleFormat)))
+			throw gcnew NotSupportedException("Streaming output requires a packed sample format.");
+
+		m_outputSampleBytes = av_get_bytes_per_sample(static_cast<AVSampleFormat>(destSampleFormat)) * destChannels;
+		m_outputBuffer = gcnew AudioRingBuffer(bufferSamples * m_outputSampleBytes);
+		m_framePool = gcnew AudioFramePool();
+	}
+
 	void Resampler::SwrContextValidation(int srcChannels, SampleFormat srcSampleFormat, int srcSampleRate,
 	                                     int destChannels, SampleFormat destSampleFormat, int destSampleRate)
 	{
@@ -35,7 +54,7 @@ namespace MediaEncoder
 			}
 
 			if (m_srcChannels != m_destChannels || m_srcSampleFormat != m_destSampleFormat || m_srcSampleRate !=
-				m_destSampleRate)
+				m_destSampleRate || m_driftEstimator != nullptr)
 			{
 				m_swrContext = swr_alloc_set_opts(
 					nullptr,
@@ -43,6 +62,17 @@ namespace MediaEncoder
 					m_destSampleRate,
 					av_get_default_channel_layout(m_srcChannels), static_cast<AVSampleFormat>(m_srcSampleFormat),
 					m_srcSampleRate, 0, nullptr);
+				ApplyResamplerProfile(m_swrContext, m_profile);
+				if (m_driftEstimator != nullptr)
+				{
+					// compensation needs the resampler even for 1:1 rates; enabling it later would re-init swr
+					av_opt_set_int(m_swrContext, "flags", SWR_FLAG_RESAMPLE, 0);
+					m_compensationDelta = 0;
+					if (m_driftEstimator->NominalSampleRate != m_srcSampleRate)
+						m_driftEstimator = gcnew ClockDriftEstimator(m_srcSampleRate);
+					else
+						m_driftEstimator->Reset();
+				}
 				if (swr_init(m_swrContext) < 0)
 				{
 					throw gcnew IOException("swr_init()");
@@ -113,4 +143,178 @@ namespace MediaEncoder
 		}
 		throw gcnew NullReferenceException("SwrContext");
 	}
+
+	int Resampler::Push(int srcChannels, SampleFormat srcSampleFormat, int srcSampleRate, IntPtr srcData,
+	                    int srcSamples)
+	{
+		CheckIfDisposed();
+		CheckIfStreaming();
+
+		if (m_flushed)
+		{
+			// the previous stream was drained, so start over with a fresh SwrContext
+			m_srcChannels = -1;
+			m_flushed = false;
+		}
+
+		SwrContextValidation(srcChannels, srcSampleFormat, srcSampleRate, m_destChannels, m_destSampleFormat,
+		                     m_destSampleRate);
+
+		if (m_driftEstimator != nullptr)
+			UpdateCompensation(srcSamples);
+
+		SpscRingBuffer* ringBuffer = m_outputBuffer->NativeRingBuffer;
+		if (m_swrContext == nullptr)
+		{
+			return ringBuffer->Write(static_cast<uint8_t*>(static_cast<void*>(srcData)),
+			                         srcSamples * m_outputSampleBytes) / m_outputSampleBytes;
+		}
+
+		uint8_t *first, *second;
+		int firstLength, secondLength;
+		ringBuffer->BeginWrite(swr_get_out_samples(m_swrContext, srcSamples) * m_outputSampleBytes, &first,
+		                       &firstLength, &second, &secondLength);
+
+		// swr writes straight into the free space of the ring; whatever does not fit stays buffered in swr
+		const uint8_t* pSrcBuffer = static_cast<uint8_t*>(static_cast<void*>(srcData));
+		int samples = swr_convert(m_swrContext, &first, firstLength / m_outputSampleBytes, &pSrcBuffer, srcSamples);
+		if (samples < 0)
+		{
+			throw gcnew IOException("swr_convert()");
+		}
+
+		int writtenSamples = samples;
+		if (samples == firstLength / m_outputSampleBytes && secondLength > 0)
+		{
+			// a non-null input with zero samples drains swr without flushing it
+			const uint8_t* pEmptyBuffer = nullptr;
+			samples = swr_convert(m_swrContext, &second, secondLength / m_outputSampleBytes, &pEmptyBuffer, 0);
+			if (samples < 0)
+			{
+				throw gcnew IOException("swr_convert()");
+			}
+			writtenSamples += samples;
+		}
+		ringBuffer->EndWrite(writtenSamples * m_outputSampleBytes);
+
+		int pendingSamples = swr_get_out_samples(m_swrContext, 0);
+		int bufferSamples = ringBuffer->Capacity() / m_outputSampleBytes;
+		if (pendingSamples > bufferSamples)
+		{
+			swr_drop_output(m_swrContext, pendingSamples - bufferSamples);
+		}
+
+		return writtenSamples;
+	}
+
+	AudioFrame^ Resampler::Pull(int samples)
+	{
+		CheckIfDisposed();
+		CheckIfStreaming();
+
+		int bufferedSamples = m_outputBuffer->Count / m_outputSampleBytes;
+		if (bufferedSamples < samples)
+		{
+			if (!m_flushed || bufferedSamples == 0)
+				return nullptr;
+			samples = bufferedSamples;
+		}
+
+		AudioFrame^ audioFrame = RentFrame(samples);
+		auto avFrame = static_cast<AVFrame*>(audioFrame->NativePointer.ToPointer());
+		m_outputBuffer->NativeRingBuffer->Read(avFrame->data[0], samples * m_outputSampleBytes);
+		return audioFrame;
+	}
+
+	AudioFrame^ Resampler::RentFrame(int samples)
+	{
+		CheckIfDisposed();
+		CheckIfStreaming();
+
+		// round the capacity up so that slightly varying request sizes can share frames
+		AudioFrame^ audioFrame = m_framePool->Rent(m_destSampleRate, m_destChannels, m_destSampleFormat,
+		                                           FFALIGN(samples, 64));
+		audioFrame->TrySetSamples(samples);
+		return audioFrame;
+	}
+
+	void Resampler::Recycle(AudioFrame^ audioFrame)
+	{
+		if (audioFrame == nullptr)
+			return;
+
+		if (m_disposed || m_framePool == nullptr)
+		{
+			delete audioFrame;
+			return;
+		}
+		m_framePool->Return(audioFrame);
+	}
+
+	void Resampler::Flush()
+	{
+		CheckIfDisposed();
+		CheckIfStreaming();
+
+		if (m_swrContext != nullptr && !m_flushed)
+		{
+			SpscRingBuffer* ringBuffer = m_outputBuffer->NativeRingBuffer;
+			uint8_t *first, *second;
+			int firstLength, secondLength;
+			ringBuffer->BeginWrite(swr_get_out_samples(m_swrContext, 0) * m_outputSampleBytes, &first, &firstLength,
+			                       &second, &secondLength);
+
+			int samples = swr_convert(m_swrContext, &first, firstLength / m_outputSampleBytes, nullptr, 0);
+			if (samples < 0)
+			{
+				throw gcnew IOException("swr_convert()");
+			}
+
+			int writtenSamples = samples;
+			if (samples == firstLength / m_outputSampleBytes && secondLength > 0)
+			{
+				samples = swr_convert(m_swrContext, &second, secondLength / m_outputSampleBytes, nullptr, 0);
+				if (samples > 0)
+					writtenSamples += samples;
+			}
+			ringBuffer->EndWrite(writtenSamples * m_outputSampleBytes);
+		}
+		m_flushed = true;
+	}
+
+	void Resampler::EnableDriftCompensation(int targetBufferedSamples)
+	{
+		CheckIfDisposed();
+		CheckIfStreaming();
+
+		m_driftEstimator = gcnew ClockDriftEstimator(m_srcSampleRate > 0 ? m_srcSampleRate : m_destSampleRate);
+		m_targetBufferedSamples = targetBufferedSamples;
+		m_averageBufferedSamples = targetBufferedSamples;
+		// force the SwrContext to be recreated with the resampler enabled
+		m_srcChannels = -1;
+	}
+
+	void Resampler::UpdateCompensation(int srcSamples)
+	{
+		// drift of the device clock, corrected over the compensation distance
+		m_driftEstimator->Update(srcSamples);
+		double drift = m_driftEstimator->Ratio - 1.0;
+
+		// buffer occupancy error, worked off over about ten seconds; the average hides consumer bursts
+		int bufferedSamples = m_outputBuffer->Count / m_outputSampleBytes;
+		m_averageBufferedSamples += (bufferedSamples - m_averageBufferedSamples) * 0.02;
+		double occupancy = (m_averageBufferedSamples - m_targetBufferedSamples) / (m_destSampleRate * 10.0);
+
+		// at most 0.5% of stretch, which stays inaudible
+		double correction = -(drift + occupancy);
+		correction = max(-0.005, min(0.005, correction));
+
+		// swr resets the compensation once the distance has been produced, so it is re-armed on every push
+		int compensationDistance = m_destSampleRate * 10;
+		m_compensationDelta = static_cast<int>(lround(correction * compensationDistance));
+		if (swr_set_compensation(m_swrContext, m_compensationDelta, compensationDistance) < 0)
+		{
+			throw gcnew IOException("swr_set_compensation()");
+		}
+	}
 }
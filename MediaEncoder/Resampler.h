@@ -9,6 +9,11 @@ using namespace Runtime::InteropServices;
 
 #include "Resampler.h"
 #include "SampleFormat.h"
+#include "AudioFrame.h"
+#include "AudioFramePool.h"
+#include "AudioRingBuffer.h"
+#include "ClockDriftEstimator.h"
+#include "ResamplerProfile.h"
 
 namespace MediaEncoder
 {
@@ -21,6 +26,15 @@ namespace MediaEncoder
 		int m_srcSampleRate, m_destSampleRate;
 		uint8_t* m_resampledBuffer;
 		int m_resampledBufferSampleSize, m_resampledBufferSize;
+		AudioRingBuffer^ m_outputBuffer;
+		int m_outputSampleBytes;
+		bool m_flushed;
+		AudioFramePool^ m_framePool;
+		ClockDriftEstimator^ m_driftEstimator;
+		int m_targetBufferedSamples;
+		double m_averageBufferedSamples;
+		int m_compensationDelta;
+		ResamplerProfile m_profile;
 		bool m_disposed;
 
 		void CheckIfDisposed()
@@ -46,15 +60,30 @@ namespace MediaEncoder
 			}
 		}
 
+		void CheckIfStreaming()
+		{
+			if (m_outputBuffer == nullptr)
+				throw gcnew InvalidOperationException("The resampler was not created for streaming.");
+		}
+
 		void SwrContextValidation(int srcChannels, SampleFormat srcSampleFormat, int srcSampleRate, int destChannels,
 		                          SampleFormat destSampleFormat, int destSampleRate);
+		void UpdateCompensation(int srcSamples);
 
 	public:
 		Resampler();
 
+		// Streaming mode: every pushed packet is converted to the given output format straight into
+		// OutputBuffer, which holds up to bufferSamples samples.
+		Resampler(int destChannels, SampleFormat destSampleFormat, int destSampleRate, int bufferSamples);
+
 		~Resampler()
 		{
 			this->!Resampler();
+			if (m_outputBuffer != nullptr)
+				delete m_outputBuffer;
+			if (m_framePool != nullptr)
+				delete m_framePool;
 			m_disposed = true;
 		}
 
@@ -65,5 +94,87 @@ namespace MediaEncoder
 		int MeasureResamplingOutputSamples(int srcChannels, SampleFormat srcSampleFormat, int srcSampleRate,
 		                                   int destChannels, SampleFormat destSampleFormat, int destSampleRate,
 		                                   int srcSamples);
+
+		// Producer side of the streaming mode.
+		int Push(int srcChannels, SampleFormat srcSampleFormat, int srcSampleRate, IntPtr srcData, int srcSamples);
+
+		// Consumer side of the streaming mode. Pull returns nullptr until enough samples are buffered,
+		// except after Flush, where the remaining samples are returned as a shorter frame.
+		AudioFrame^ Pull(int samples);
+		AudioFrame^ RentFrame(int samples);
+		void Recycle(AudioFrame^ audioFrame);
+		void Flush();
+
+		// Steers swr_set_compensation so that the source clock drift is absorbed and OutputBuffer stays
+		// around targetBufferedSamples. The SwrContext is kept even when no conversion is needed.
+		void EnableDriftCompensation(int targetBufferedSamples);
+
+		// frames handed out by Pull and RentFrame; exposed for its hit/miss counters
+		property AudioFramePool^ FramePool
+		{
+			AudioFramePool^ get()
+			{
+				CheckIfDisposed();
+				return m_framePool;
+			}
+		}
+
+		property ClockDriftEstimator^ DriftEstimator
+		{
+			ClockDriftEstimator^ get()
+			{
+				CheckIfDisposed();
+				return m_driftEstimator;
+			}
+		}
+
+		// Filter used when the rates differ. A change rebuilds the SwrContext on the next call, dropping the few
+		// samples still held in the filter.
+		property ResamplerProfile Profile
+		{
+			ResamplerProfile get()
+			{
+				return m_profile;
+			}
+			void set(ResamplerProfile value)
+			{
+				CheckIfDisposed();
+				if (m_profile != value)
+				{
+					m_profile = value;
+					m_srcChannels = -1;
+				}
+			}
+		}
+
+		// current correction applied to the output rate
+		property double CompensationPpm
+		{
+			double get()
+			{
+				CheckIfDisposed();
+				return m_compensationDelta * 1000000.0 / (static_cast<double>(m_destSampleRate) * 10);
+			}
+		}
+
+		property AudioRingBuffer^ OutputBuffer
+		{
+			AudioRingBuffer^ get()
+			{
+				CheckIfDisposed();
+				CheckIfStreaming();
+				return m_outputBuffer;
+			}
+		}
+
+		property int BufferedSamples
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				CheckIfStreaming();
+				return m_outputBuffer->Count / m_outputSampleBytes;
+			}
+		}
 	};
 }
@@ -0,0 +1,38 @@
+#include "pch.h"
+#include "ResamplerProfile.h"
+
+namespace MediaEncoder
+{
+	void ApplyResamplerProfile(struct SwrContext* swrContext, ResamplerProfile profile)
+	{
+		int filterSize, phaseShift, linearInterp;
+		double cutoff;
+
+		switch (profile)
+		{
+		case ResamplerProfile::Fast:
+			filterSize = 16;
+			phaseShift = 8;
+			linearInterp = 1;
+			cutoff = 0.9;
+			break;
+		case ResamplerProfile::HighQuality:
+			filterSize = 64;
+			phaseShift = 12;
+			linearInterp = 0;
+			cutoff = 0.98;
+			break;
+		default:
+			filterSize = 32;
+			phaseShift = 10;
+			linearInterp = 1;
+			cutoff = 0.97;
+			break;
+		}
+
+		av_opt_set_int(swrContext, "filter_size", filterSize, 0);
+		av_opt_set_int(swrContext, "phase_shift", phaseShift, 0);
+		av_opt_set_int(swrContext, "linear_interp", linearInterp, 0);
+		av_opt_set_double(swrContext, "cutoff", cutoff, 0);
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "pch.h"
+
+namespace MediaEncoder
+{
+	// Speed/fidelity trade-off of the swr polyphase filter, used whenever the sample rate changes
+	// (e.g. 48000 -> 44100 for rtmp). The figures below are for 48000 -> 44100 float as measured by
+	// Benchmark. That ratio is exact, so unless drift compensation is active phase_shift and linear_interp
+	// do not matter and the cost follows filter_size.
+	public enum class ResamplerProfile
+	{
+		// 16 taps, cutoff 0.9: about 1.3x Balanced, -0.4 dB at 16 kHz and -6.5 dB at 20 kHz.
+		Fast,
+		// The swr defaults: flat to 16 kHz, -1.3 dB at 20 kHz, a 23 kHz tone folds back at -20 dB.
+		Balanced,
+		// 64 taps, cutoff 0.98: about 0.7x Balanced, flat to 20 kHz, folded 23 kHz tone at -40 dB.
+		HighQuality,
+	};
+
+	// Sets filter_size, phase_shift, linear_interp and cutoff on an allocated but not yet initialized context.
+	void ApplyResamplerProfile(struct SwrContext* swrContext, ResamplerProfile profile);
+}
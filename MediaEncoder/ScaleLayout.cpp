@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "ScaleLayout.h"
+
+namespace MediaEncoder
+{
+	static int EvenSize(int64_t size, int limit)
+	{
+		int value = static_cast<int>((size + 1) & ~1LL);
+		if (value > limit)
+			value = limit;
+		return value < 1 ? 1 : value;
+	}
+
+	ScaleLayout ComputeScaleLayout(int srcW, int srcH, int dstW, int dstH, ScaleMode scaleMode)
+	{
+		ScaleLayout layout = {0, 0, srcW, srcH, 0, 0, dstW, dstH};
+		if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0)
+			return layout;
+
+		bool sourceIsWider = static_cast<int64_t>(srcW) * dstH > static_cast<int64_t>(dstW) * srcH;
+		switch (scaleMode)
+		{
+		case ScaleMode::Fit:
+			if (sourceIsWider)
+				layout.dstH = EvenSize(static_cast<int64_t>(dstW) * srcH / srcW, dstH);
+			else
+				layout.dstW = EvenSize(static_cast<int64_t>(dstH) * srcW / srcH, dstW);
+			layout.dstX = ((dstW - layout.dstW) / 2) & ~1;
+			layout.dstY = ((dstH - layout.dstH) / 2) & ~1;
+			break;
+		case ScaleMode::Fill:
+			if (sourceIsWider)
+				layout.srcW = EvenSize(static_cast<int64_t>(srcH) * dstW / dstH, srcW);
+			else
+				layout.srcH = EvenSize(static_cast<int64_t>(srcW) * dstH / dstW, srcH);
+			layout.srcX = ((srcW - layout.srcW) / 2) & ~1;
+			layout.srcY = ((srcH - layout.srcH) / 2) & ~1;
+			break;
+		default:
+			break;
+		}
+		return layout;
+	}
+
+	void OffsetPlanes(AVPixelFormat format, const uint8_t* const data[4], const int linesize[4], int x, int y,
+	                  const uint8_t* result[4])
+	{
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+		int bytes[4] = {0, 0, 0, 0};
+		if (desc == nullptr || av_image_fill_linesizes(bytes, format, x) < 0)
+		{
+			for (int i = 0; i < 4; i++)
+				result[i] = data[i];
+			return;
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (data[i] == nullptr)
+			{
+				result[i] = nullptr;
+				continue;
+			}
+			int rows = (i == 1 || i == 2) ? (y >> desc->log2_chroma_h) : y;
+			result[i] = data[i] + static_cast<ptrdiff_t>(rows) * linesize[i] + bytes[i];
+		}
+	}
+
+	void OffsetPlanes(AVPixelFormat format, uint8_t* const data[4], const int linesize[4], int x, int y,
+	                  uint8_t* result[4])
+	{
+		OffsetPlanes(format, data, linesize, x, y, const_cast<const uint8_t**>(result));
+	}
+
+	static void FillBlack(AVPixelFormat format, uint8_t* const data[4], const int linesize[4], int x, int y,
+	                      int width, int height, AVColorRange range)
+	{
+		if (width <= 0 || height <= 0)
+			return;
+
+		uint8_t* planes[4];
+		OffsetPlanes(format, data, linesize, x, y, planes);
+
+		ptrdiff_t linesizes[4];
+		for (int i = 0; i < 4; i++)
+			linesizes[i] = linesize[i];
+		av_image_fill_black(planes, linesizes, format, range, width, height);
+	}
+
+	void PaintBorders(AVPixelFormat format, uint8_t* const data[4], const int linesize[4], int width, int height,
+	                  const ScaleLayout& layout, AVColorRange range)
+	{
+		int bottom = layout.dstY + layout.dstH;
+		int right = layout.dstX + layout.dstW;
+		FillBlack(format, data, linesize, 0, 0, width, layout.dstY, range);
+		FillBlack(format, data, linesize, 0, bottom, width, height - bottom, range);
+		FillBlack(format, data, linesize, 0, layout.dstY, layout.dstX, layout.dstH, range);
+		FillBlack(format, data, linesize, right, layout.dstY, width - right, layout.dstH, range);
+	}
+
+	void InvalidateBorders(BorderState* state)
+	{
+		state->generation++;
+	}
+
+	void UpdateBorders(BorderState* state, AVPixelFormat format, uint8_t* const data[4], const int linesize[4],
+	                   int width, int height, const ScaleLayout& layout, AVColorRange range)
+	{
+		if (state->paintedGeneration == state->generation && state->format == format && state->range == range &&
+			state->width == width && state->height == height && memcmp(state->data, data, sizeof(state->data)) == 0 &&
+			memcmp(state->linesize, linesize, sizeof(state->linesize)) == 0 &&
+			memcmp(&state->layout, &layout, sizeof(ScaleLayout)) == 0)
+			return;
+
+		state->paintedGeneration = state->generation;
+		memcpy(state->data, data, sizeof(state->data));
+		memcpy(state->linesize, linesize, sizeof(state->linesize));
+		state->format = format;
+		state->range = range;
+		state->width = width;
+		state->height = height;
+		state->layout = layout;
+		PaintBorders(format, data, linesize, width, height, layout, range);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ScaleMode.h"
+
+namespace MediaEncoder
+{
+	// Source rectangle that is scaled into the destination rectangle. Offsets and sizes are kept even so the
+	// rectangles start on a chroma sample in 4:2:0 formats.
+	struct ScaleLayout
+	{
+		int srcX, srcY, srcW, srcH;
+		int dstX, dstY, dstW, dstH;
+	};
+
+	// Which destination buffer the padding was last filled in, and for what. The owner of the buffer calls
+	// InvalidateBorders whenever something else may have written over the padding.
+	struct BorderState
+	{
+		uint64_t generation;
+		uint64_t paintedGeneration;
+		uint8_t* data[4];
+		int linesize[4];
+		AVPixelFormat format;
+		AVColorRange range;
+		int width, height;
+		ScaleLayout layout;
+	};
+
+	ScaleLayout ComputeScaleLayout(int srcW, int srcH, int dstW, int dstH, ScaleMode scaleMode);
+	void OffsetPlanes(AVPixelFormat format, const uint8_t* const data[4], const int linesize[4], int x, int y,
+	                  const uint8_t* result[4]);
+	void OffsetPlanes(AVPixelFormat format, uint8_t* const data[4], const int linesize[4], int x, int y,
+	                  uint8_t* result[4]);
+
+	// Paints the area outside layout's destination rectangle black.
+	void PaintBorders(AVPixelFormat format, uint8_t* const data[4], const int linesize[4], int width, int height,
+	                  const ScaleLayout& layout, AVColorRange range);
+
+	void InvalidateBorders(BorderState* state);
+
+	// PaintBorders, skipped when neither the buffer, format, geometry nor the generation changed since the last
+	// call, so frames with a stable geometry only pay for the content.
+	void UpdateBorders(BorderState* state, AVPixelFormat format, uint8_t* const data[4], const int linesize[4],
+	                   int width, int height, const ScaleLayout& layout, AVColorRange range);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "pch.h"
+
+namespace MediaEncoder
+{
+	public enum class ScaleMode
+	{
+		// Scales to the destination size, ignoring the aspect ratio.
+		Stretch,
+		// Keeps the aspect ratio and pads the rest of the destination with black bars.
+		Fit,
+		// Keeps the aspect ratio and crops the source so it covers the whole destination.
+		Fill,
+	};
+}
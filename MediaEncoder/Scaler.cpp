@@ -3,100 +3,344 @@
 
 namespace MediaEncoder
 {
-	Scaler::Scaler()
-		:
-		sws_ctx(nullptr), srcW(0),
-		srcH(0), dstW(0), dstH(0),
-		srcFormat(PixelFormat::None), dstFormat(PixelFormat::None), disposed(false)
+	static void sws_no_free(void* opaque, uint8_t* data)
 	{
 	}
 
-	bool Scaler::Convert(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat,
-	                     IntPtr src, int srcStride, IntPtr dst, int dstStride)
+	static int sws_wrap_frame(AVFrame* frame, int width, int height, AVPixelFormat format, uint8_t* const data[4],
+	                          const int linesize[4])
 	{
-		if (this->srcW != srcW || this->srcH != srcH || this->srcFormat != srcFormat || this->dstW != dstW || this->dstH
-			!= dstH || this->dstFormat != dstFormat)
+		// sws_frame_start takes references on both frames; a non-owning buffer keeps it from copying them.
+		frame->buf[0] = av_buffer_create(data[0], 1, sws_no_free, nullptr, 0);
+		if (frame->buf[0] == nullptr)
+			return AVERROR(ENOMEM);
+
+		frame->width = width;
+		frame->height = height;
+		frame->format = format;
+		for (int i = 0; i < 4; i++)
 		{
-			if (this->sws_ctx != nullptr)
-			{
-				sws_freeContext(this->sws_ctx);
-				this->sws_ctx = nullptr;
-			}
+			frame->data[i] = data[i];
+			frame->linesize[i] = linesize[i];
+		}
+		return 0;
+	}
+
+	int GetDefaultScaleThreads()
+	{
+		// Past eight bands the per-band setup outweighs the gain for the frame sizes we capture.
+		return FFMIN(FFMAX(av_cpu_count(), 1), 8);
+	}
+
+	struct SwsContext* CreateSlicedSwsContext(int srcW, int srcH, AVPixelFormat srcFormat, int dstW, int dstH,
+	                                          AVPixelFormat dstFormat, int flags, int threads)
+	{
+		struct SwsContext* sws_ctx = sws_alloc_context();
+		if (sws_ctx == nullptr)
+			return nullptr;
+
+		av_opt_set_int(sws_ctx, "srcw", srcW, 0);
+		av_opt_set_int(sws_ctx, "srch", srcH, 0);
+		av_opt_set_int(sws_ctx, "src_format", srcFormat, 0);
+		av_opt_set_int(sws_ctx, "dstw", dstW, 0);
+		av_opt_set_int(sws_ctx, "dsth", dstH, 0);
+		av_opt_set_int(sws_ctx, "dst_format", dstFormat, 0);
+		av_opt_set_int(sws_ctx, "sws_flags", flags, 0);
+		av_opt_set_int(sws_ctx, "threads", threads > 0 ? threads : GetDefaultScaleThreads(), 0);
+
+		if (sws_init_context(sws_ctx, nullptr, nullptr) < 0)
+		{
+			sws_freeContext(sws_ctx);
+			return nullptr;
+		}
+		return sws_ctx;
+	}
+
+	int ScaleSliced(struct SwsContext* sws_ctx, int srcW, int srcH, AVPixelFormat srcFormat,
+	                const uint8_t* const src[4], const int srcStride[4], int dstW, int dstH, AVPixelFormat dstFormat,
+	                uint8_t* const dst[4], const int dstStride[4])
+	{
+		AVFrame* srcFrame = av_frame_alloc();
+		AVFrame* dstFrame = av_frame_alloc();
+
+		int ret = (srcFrame != nullptr && dstFrame != nullptr) ? 0 : AVERROR(ENOMEM);
+		if (ret >= 0)
+			ret = sws_wrap_frame(srcFrame, srcW, srcH, srcFormat, const_cast<uint8_t* const*>(src), srcStride);
+		if (ret >= 0)
+			ret = sws_wrap_frame(dstFrame, dstW, dstH, dstFormat, dst, dstStride);
+		if (ret >= 0)
+			ret = sws_scale_frame(sws_ctx, dstFrame, srcFrame);
+
+		av_frame_free(&srcFrame);
+		av_frame_free(&dstFrame);
+		return ret;
+	}
+
+	Scaler::Scaler() : Scaler(4, 0)
+	{
+	}
+
+	Scaler::Scaler(int cacheCapacity) : Scaler(cacheCapacity, 0)
+	{
+	}
 
-			this->srcW = srcW;
-			this->srcH = srcH;
-			this->srcFormat = srcFormat;
-			this->dstW = dstW;
-			this->dstH = dstH;
-			this->dstFormat = dstFormat;
+	Scaler::Scaler(int cacheCapacity, int threads)
+		:
+		cache(nullptr), cacheCapacity(cacheCapacity > 0 ? cacheCapacity : 1), borders(nullptr),
+		threads(threads > 0 ? threads : GetDefaultScaleThreads()), colorSpace(AVCOL_SPC_SMPTE170M),
+		colorRange(AVCOL_RANGE_MPEG), scaleMode(MediaEncoder::ScaleMode::Stretch), bgraScratch(nullptr),
+		usePixelKernels(true), useCounter(0), cacheHits(0), cacheMisses(0), disposed(false)
+	{
+		cache = new ScalerCacheEntry[this->cacheCapacity];
+		memset(cache, 0, sizeof(ScalerCacheEntry) * this->cacheCapacity);
+		borders = new ScalerBorderEntry[this->cacheCapacity];
+		memset(borders, 0, sizeof(ScalerBorderEntry) * this->cacheCapacity);
+		bgraScratch = new BgraScaleScratch();
+		memset(bgraScratch, 0, sizeof(BgraScaleScratch));
+	}
 
-			if (this->srcW > 0 && this->srcH > 0 && this->dstW > 0 && this->dstH > 0)
+	void Scaler::ClearCache()
+	{
+		for (int i = 0; i < cacheCapacity; i++)
+		{
+			if (cache[i].sws_ctx != nullptr)
 			{
-				this->sws_ctx = sws_getContext(this->srcW, this->srcH, static_cast<AVPixelFormat>(this->srcFormat),
-				                               this->dstW, this->dstH, static_cast<AVPixelFormat>(this->dstFormat),
-				                               /*SWS_BICUBIC*/SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+				sws_freeContext(cache[i].sws_ctx);
+				cache[i].sws_ctx = nullptr;
 			}
 		}
+	}
 
-		if (this->sws_ctx != nullptr)
+	BorderState* Scaler::GetBorderState(uint8_t* const dst[4])
+	{
+		ScalerBorderEntry* victim = &borders[0];
+		for (int i = 0; i < cacheCapacity; i++)
 		{
-			uint8_t* srcData[4] = {static_cast<uint8_t*>(static_cast<void*>(src)), nullptr, nullptr, nullptr};
-			int srcLinesize[4] = {srcStride, 0, 0, 0};
-			uint8_t* dstData[4] = {static_cast<uint8_t*>(static_cast<void*>(dst)), nullptr, nullptr, nullptr};
-			int dstLinesize[4] = {dstStride, 0, 0, 0};
+			ScalerBorderEntry* entry = &borders[i];
+			if (entry->lastUse != 0 && entry->state.data[0] == dst[0])
+			{
+				entry->lastUse = useCounter;
+				return &entry->state;
+			}
 
-			sws_scale(this->sws_ctx, srcData, srcLinesize, 0, srcH, dstData, dstLinesize);
-			return true;
+			if (victim->lastUse != 0 && (entry->lastUse == 0 || entry->lastUse < victim->lastUse))
+				victim = entry;
 		}
-		return false;
+
+		// a cleared state matches no buffer, so a buffer not seen recently is painted in full
+		memset(victim, 0, sizeof(ScalerBorderEntry));
+		victim->lastUse = useCounter;
+		return &victim->state;
 	}
 
-	bool Scaler::Convert(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat,
-	                     array<IntPtr>^ src, array<int>^ srcStride, array<IntPtr>^ dst, array<int>^ dstStride)
+	void Scaler::InvalidateBorders()
 	{
-		if (this->srcW != srcW || this->srcH != srcH || this->srcFormat != srcFormat || this->dstW != dstW || this->dstH
-			!= dstH || this->dstFormat != dstFormat)
+		CheckIfDisposed();
+
+		for (int i = 0; i < cacheCapacity; i++)
+			MediaEncoder::InvalidateBorders(&borders[i].state);
+	}
+
+	struct SwsContext* Scaler::GetContext(int srcW, int srcH, AVPixelFormat srcFormat, int dstW, int dstH,
+	                                      AVPixelFormat dstFormat)
+	{
+		if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0)
+			return nullptr;
+
+		useCounter++;
+
+		ScalerCacheEntry* victim = &cache[0];
+		for (int i = 0; i < cacheCapacity; i++)
 		{
-			if (this->sws_ctx != nullptr)
+			ScalerCacheEntry* entry = &cache[i];
+			if (entry->sws_ctx != nullptr && entry->srcW == srcW && entry->srcH == srcH && entry->srcFormat ==
+				srcFormat && entry->dstW == dstW && entry->dstH == dstH && entry->dstFormat == dstFormat)
 			{
-				sws_freeContext(this->sws_ctx);
-				this->sws_ctx = nullptr;
+				entry->lastUse = useCounter;
+				cacheHits++;
+				return entry->sws_ctx;
 			}
 
-			this->srcW = srcW;
-			this->srcH = srcH;
-			this->srcFormat = srcFormat;
-			this->dstW = dstW;
-			this->dstH = dstH;
-			this->dstFormat = dstFormat;
+			if (victim->sws_ctx != nullptr && (entry->sws_ctx == nullptr || entry->lastUse < victim->lastUse))
+				victim = entry;
+		}
 
-			if (this->srcW > 0 && this->srcH > 0 && this->dstW > 0 && this->dstH > 0)
-			{
-				this->sws_ctx = sws_getContext(this->srcW, this->srcH, static_cast<AVPixelFormat>(this->srcFormat),
-				                               this->dstW, this->dstH, static_cast<AVPixelFormat>(this->dstFormat),
-				                               /*SWS_BICUBIC*/SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
-			}
+		cacheMisses++;
+
+		if (victim->sws_ctx != nullptr)
+		{
+			sws_freeContext(victim->sws_ctx);
+			victim->sws_ctx = nullptr;
 		}
 
-		if (this->sws_ctx != nullptr)
+		victim->sws_ctx = CreateSlicedSwsContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat,
+		                                         /*SWS_BICUBIC*/SWS_FAST_BILINEAR, threads);
+		if (victim->sws_ctx == nullptr)
+			return nullptr;
+
+		int *invTable, *table;
+		int srcRange, dstRange, brightness, contrast, saturation;
+		if (sws_getColorspaceDetails(victim->sws_ctx, &invTable, &srcRange, &table, &dstRange, &brightness, &contrast,
+		                             &saturation) >= 0)
 		{
-			uint8_t* srcData[4];
-			int srcLinesize[4];
-			uint8_t* dstData[4];
-			int dstLinesize[4];
+			sws_setColorspaceDetails(victim->sws_ctx, invTable, srcRange,
+			                         sws_getCoefficients(colorSpace == AVCOL_SPC_BT709 ? SWS_CS_ITU709 : SWS_CS_ITU601),
+			                         colorRange == AVCOL_RANGE_JPEG, brightness, contrast, saturation);
+		}
 
-			for (int i = 0; i < 4; i++)
-			{
-				srcData[i] = (i < src->Length) ? static_cast<uint8_t*>(static_cast<void*>(src[i])) : nullptr;
-				srcLinesize[i] = (i < srcStride->Length) ? srcStride[i] : 0;
+		victim->srcW = srcW;
+		victim->srcH = srcH;
+		victim->srcFormat = srcFormat;
+		victim->dstW = dstW;
+		victim->dstH = dstH;
+		victim->dstFormat = dstFormat;
+		victim->lastUse = useCounter;
+		return victim->sws_ctx;
+	}
 
-				dstData[i] = (i < dst->Length) ? static_cast<uint8_t*>(static_cast<void*>(dst[i])) : nullptr;
-				dstLinesize[i] = (i < dstStride->Length) ? dstStride[i] : 0;
-			}
+	bool Scaler::ConvertCore(int srcW, int srcH, AVPixelFormat srcFormat, const uint8_t* const src[4],
+	                         const int srcStride[4], int dstW, int dstH, AVPixelFormat dstFormat,
+	                         uint8_t* const dst[4], const int dstStride[4])
+	{
+		CheckIfDisposed();
+
+		ScaleLayout layout = ComputeScaleLayout(srcW, srcH, dstW, dstH, scaleMode);
+		const uint8_t* srcRect[4];
+		uint8_t* dstRect[4];
+		OffsetPlanes(srcFormat, src, srcStride, layout.srcX, layout.srcY, srcRect);
+		OffsetPlanes(dstFormat, dst, dstStride, layout.dstX, layout.dstY, dstRect);
+		if (layout.dstW != dstW || layout.dstH != dstH)
+		{
+			useCounter++;
+			UpdateBorders(GetBorderState(dst), dstFormat, dst, dstStride, dstW, dstH, layout, colorRange);
+		}
 
-			sws_scale(this->sws_ctx, srcData, srcLinesize, 0, srcH, dstData, dstLinesize);
+		if (usePixelKernels && ConvertWithKernels(layout.srcW, layout.srcH, srcFormat, srcRect, srcStride,
+		                                          layout.dstW, layout.dstH, dstFormat, dstRect, dstStride, colorSpace,
+		                                          colorRange, bgraScratch))
 			return true;
+
+		struct SwsContext* sws_ctx = GetContext(layout.srcW, layout.srcH, srcFormat, layout.dstW, layout.dstH,
+		                                        dstFormat);
+		if (sws_ctx == nullptr)
+			return false;
+
+		return ScaleSliced(sws_ctx, layout.srcW, layout.srcH, srcFormat, srcRect, srcStride, layout.dstW,
+		                   layout.dstH, dstFormat, dstRect, dstStride) >= 0;
+	}
+
+	bool Scaler::Convert(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat,
+	                     IntPtr src, int srcStride, IntPtr dst, int dstStride)
+	{
+		const uint8_t* srcData[4] = {static_cast<uint8_t*>(static_cast<void*>(src)), nullptr, nullptr, nullptr};
+		int srcLinesize[4] = {srcStride, 0, 0, 0};
+		uint8_t* dstData[4] = {static_cast<uint8_t*>(static_cast<void*>(dst)), nullptr, nullptr, nullptr};
+		int dstLinesize[4] = {dstStride, 0, 0, 0};
+
+		return ConvertCore(srcW, srcH, static_cast<AVPixelFormat>(srcFormat), srcData, srcLinesize, dstW, dstH,
+		                   static_cast<AVPixelFormat>(dstFormat), dstData, dstLinesize);
+	}
+
+	static void GetPlanes(array<IntPtr>^ planes, array<int>^ strides, uint8_t* data[4], int linesize[4])
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			data[i] = (i < planes->Length) ? static_cast<uint8_t*>(static_cast<void*>(planes[i])) : nullptr;
+			linesize[i] = (i < strides->Length) ? strides[i] : 0;
 		}
-		return false;
+	}
+
+	bool Scaler::Convert(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat,
+	                     array<IntPtr>^ src, array<int>^ srcStride, array<IntPtr>^ dst, array<int>^ dstStride)
+	{
+		uint8_t* srcData[4];
+		int srcLinesize[4];
+		uint8_t* dstData[4];
+		int dstLinesize[4];
+		GetPlanes(src, srcStride, srcData, srcLinesize);
+		GetPlanes(dst, dstStride, dstData, dstLinesize);
+
+		return ConvertCore(srcW, srcH, static_cast<AVPixelFormat>(srcFormat), srcData, srcLinesize, dstW, dstH,
+		                   static_cast<AVPixelFormat>(dstFormat), dstData, dstLinesize);
+	}
+
+	bool Scaler::Convert(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat,
+	                     FramePlanes src, FramePlanes dst)
+	{
+		uint8_t* srcData[4];
+		int srcLinesize[4];
+		uint8_t* dstData[4];
+		int dstLinesize[4];
+		src.CopyTo(srcData, srcLinesize);
+		dst.CopyTo(dstData, dstLinesize);
+
+		return ConvertCore(srcW, srcH, static_cast<AVPixelFormat>(srcFormat), srcData, srcLinesize, dstW, dstH,
+		                   static_cast<AVPixelFormat>(dstFormat), dstData, dstLinesize);
+	}
+
+	bool Scaler::Convert(int srcW, int srcH, PixelFormat srcFormat, array<IntPtr>^ src, array<int>^ srcStride,
+	                     VideoFrame^ dest)
+	{
+		uint8_t* srcData[4];
+		int srcLinesize[4];
+		GetPlanes(src, srcStride, srcData, srcLinesize);
+		auto dstFrame = static_cast<AVFrame*>(dest->NativePointer.ToPointer());
+
+		return ConvertCore(srcW, srcH, static_cast<AVPixelFormat>(srcFormat), srcData, srcLinesize, dstFrame->width,
+		                   dstFrame->height, static_cast<AVPixelFormat>(dstFrame->format), dstFrame->data,
+		                   dstFrame->linesize);
+	}
+
+	bool Scaler::Convert(VideoFrame^ src, int dstW, int dstH, PixelFormat dstFormat, array<IntPtr>^ dst,
+	                     array<int>^ dstStride)
+	{
+		auto srcFrame = static_cast<AVFrame*>(src->NativePointer.ToPointer());
+		uint8_t* dstData[4];
+		int dstLinesize[4];
+		GetPlanes(dst, dstStride, dstData, dstLinesize);
+
+		return ConvertCore(srcFrame->width, srcFrame->height, static_cast<AVPixelFormat>(srcFrame->format),
+		                   srcFrame->data, srcFrame->linesize, dstW, dstH, static_cast<AVPixelFormat>(dstFormat),
+		                   dstData, dstLinesize);
+	}
+
+	bool Scaler::Convert(VideoFrame^ src, VideoFrame^ dest)
+	{
+		auto srcFrame = static_cast<AVFrame*>(src->NativePointer.ToPointer());
+		auto dstFrame = static_cast<AVFrame*>(dest->NativePointer.ToPointer());
+
+		return ConvertCore(srcFrame->width, srcFrame->height, static_cast<AVPixelFormat>(srcFrame->format),
+		                   srcFrame->data, srcFrame->linesize, dstFrame->width, dstFrame->height,
+		                   static_cast<AVPixelFormat>(dstFrame->format), dstFrame->data, dstFrame->linesize);
+	}
+
+	bool Scaler::ConvertRegion(IntPtr src, int srcStride, PixelFormat srcFormat, int regionX, int regionY,
+	                           int regionW, int regionH, int dstW, int dstH, PixelFormat dstFormat,
+	                           array<IntPtr>^ dst, array<int>^ dstStride)
+	{
+		uint8_t* dstData[4];
+		int dstLinesize[4];
+		GetPlanes(dst, dstStride, dstData, dstLinesize);
+
+		return ConvertRegion(src, srcStride, srcFormat, regionX, regionY, regionW, regionH, dstW, dstH, dstFormat,
+		                     FramePlanes::FromPointers(dstData, dstLinesize));
+	}
+
+	bool Scaler::ConvertRegion(IntPtr src, int srcStride, PixelFormat srcFormat, int regionX, int regionY,
+	                           int regionW, int regionH, int dstW, int dstH, PixelFormat dstFormat, FramePlanes dst)
+	{
+		CheckIfDisposed();
+
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(srcFormat));
+		if (desc == nullptr || (desc->flags & AV_PIX_FMT_FLAG_PLANAR) || desc->nb_components == 0)
+			throw gcnew NotSupportedException("ConvertRegion() needs a packed source format.");
+		if (regionX < 0 || regionY < 0 || regionW <= 0 || regionH <= 0)
+			throw gcnew ArgumentOutOfRangeException("region");
+
+		int bytesPerPixel = av_get_padded_bits_per_pixel(desc) / 8;
+		IntPtr regionPointer = IntPtr(static_cast<uint8_t*>(src.ToPointer()) + static_cast<ptrdiff_t>(regionY) *
+			srcStride + static_cast<ptrdiff_t>(regionX) * bytesPerPixel);
+
+		return Convert(regionW, regionH, srcFormat, dstW, dstH, dstFormat, FramePlanes(regionPointer, srcStride), dst);
 	}
 }
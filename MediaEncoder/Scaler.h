@@ -8,15 +8,55 @@ using namespace IO;
 using namespace Runtime::InteropServices;
 
 #include "VideoFrame.h"
+#include "ColorSpace.h"
+#include "PixelConverter.h"
+#include "ScaleLayout.h"
 
 namespace MediaEncoder
 {
+	// Contexts created here split each conversion into horizontal bands processed by swscale's persistent
+	// slice threads, each band with its own context. Band edges follow sws_receive_slice_alignment and every
+	// band sees the whole source, so the output is identical to a single threaded sws_scale; Benchmark (scaler
+	// mode) checks this at several heights and times the thread counts.
+	int GetDefaultScaleThreads();
+	struct SwsContext* CreateSlicedSwsContext(int srcW, int srcH, AVPixelFormat srcFormat, int dstW, int dstH,
+	                                          AVPixelFormat dstFormat, int flags, int threads);
+	int ScaleSliced(struct SwsContext* sws_ctx, int srcW, int srcH, AVPixelFormat srcFormat,
+	                const uint8_t* const src[4], const int srcStride[4], int dstW, int dstH, AVPixelFormat dstFormat,
+	                uint8_t* const dst[4], const int dstStride[4]);
+
+	// Border state of one destination buffer, so that callers rotating through a few frames (a frame pool)
+	// only get their letterbox bars painted once per buffer.
+	struct ScalerBorderEntry
+	{
+		BorderState state;
+		uint64_t lastUse;
+	};
+
+	struct ScalerCacheEntry
+	{
+		int srcW, srcH, dstW, dstH;
+		AVPixelFormat srcFormat, dstFormat;
+		struct SwsContext* sws_ctx;
+		uint64_t lastUse;
+	};
+
 	public ref class Scaler : IDisposable
 	{
 	private:
-		struct SwsContext* sws_ctx;
-		int srcW, srcH, dstW, dstH;
-		PixelFormat srcFormat, dstFormat;
+		// Small LRU of contexts keyed by the six geometry/format values, so alternating between a few
+		// geometries (preview and encode, region resize) does not rebuild the filters on every call.
+		ScalerCacheEntry* cache;
+		int cacheCapacity;
+		ScalerBorderEntry* borders;
+		int threads;
+		AVColorSpace colorSpace;
+		AVColorRange colorRange;
+		MediaEncoder::ScaleMode scaleMode;
+		BgraScaleScratch* bgraScratch;
+		bool usePixelKernels;
+		uint64_t useCounter;
+		uint64_t cacheHits, cacheMisses;
 		bool disposed;
 
 		void CheckIfDisposed()
@@ -25,15 +65,40 @@ namespace MediaEncoder
 				throw gcnew ObjectDisposedException("The object was already disposed.");
 		}
 
+		void ClearCache();
+		BorderState* GetBorderState(uint8_t* const dst[4]);
+		struct SwsContext* GetContext(int srcW, int srcH, AVPixelFormat srcFormat, int dstW, int dstH,
+		                              AVPixelFormat dstFormat);
+		bool ConvertCore(int srcW, int srcH, AVPixelFormat srcFormat, const uint8_t* const src[4],
+		                 const int srcStride[4], int dstW, int dstH, AVPixelFormat dstFormat, uint8_t* const dst[4],
+		                 const int dstStride[4]);
+
 	protected:
 		!Scaler()
 		{
-			if (sws_ctx != nullptr)
-				sws_freeContext(sws_ctx);
+			if (cache != nullptr)
+			{
+				ClearCache();
+				delete[] cache;
+				cache = nullptr;
+			}
+			if (borders != nullptr)
+			{
+				delete[] borders;
+				borders = nullptr;
+			}
+			if (bgraScratch != nullptr)
+			{
+				FreeBgraScaleScratch(bgraScratch);
+				delete bgraScratch;
+				bgraScratch = nullptr;
+			}
 		}
 
 	public:
 		Scaler();
+		Scaler(int cacheCapacity);
+		Scaler(int cacheCapacity, int threads);
 
 		~Scaler()
 		{
@@ -47,24 +112,141 @@ namespace MediaEncoder
 		bool Convert(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat,
 		             array<IntPtr>^ src, array<int>^ srcStride, array<IntPtr>^ dst, array<int>^ dstStride);
 
+		bool Convert(int srcW, int srcH, PixelFormat srcFormat, int dstW, int dstH, PixelFormat dstFormat,
+		             FramePlanes src, FramePlanes dst);
+
 		bool Convert(int srcW, int srcH, PixelFormat srcFormat, array<IntPtr>^ src, array<int>^ srcStride,
-		             VideoFrame^ dest)
+		             VideoFrame^ dest);
+
+		bool Convert(VideoFrame^ src, int dstW, int dstH, PixelFormat dstFormat, array<IntPtr>^ dst,
+		             array<int>^ dstStride);
+
+		// Makes the next conversion into every destination buffer paint its letterbox bars again.
+		void InvalidateBorders();
+
+		// Reads the planes straight from both AVFrames, so nothing is allocated per call.
+		bool Convert(VideoFrame^ src, VideoFrame^ dest);
+
+		// Converts a rectangle of a packed source image in place, without copying it out first. BGRA sources
+		// going to NV12/YUV420P are scaled and converted in a single pass; anything else goes through swscale.
+		bool ConvertRegion(IntPtr src, int srcStride, PixelFormat srcFormat, int regionX, int regionY, int regionW,
+		                   int regionH, int dstW, int dstH, PixelFormat dstFormat, array<IntPtr>^ dst,
+		                   array<int>^ dstStride);
+
+		bool ConvertRegion(IntPtr src, int srcStride, PixelFormat srcFormat, int regionX, int regionY, int regionW,
+		                   int regionH, int dstW, int dstH, PixelFormat dstFormat, FramePlanes dst);
+
+		bool ConvertRegion(IntPtr src, int srcStride, PixelFormat srcFormat, int regionX, int regionY, int regionW,
+		                   int regionH, VideoFrame^ dest)
 		{
-			return Convert(srcW, srcH, srcFormat, dest->Width, dest->Height, dest->PixelFormat, src, srcStride,
-			               dest->DataPointer, dest->LineSize);
+			return ConvertRegion(src, srcStride, srcFormat, regionX, regionY, regionW, regionH, dest->Width,
+			                     dest->Height, dest->PixelFormat, dest->Planes);
 		}
 
-		bool Convert(VideoFrame^ src, int dstW, int dstH, PixelFormat dstFormat, array<IntPtr>^ dst,
-		             array<int>^ dstStride)
+	public:
+		property int CacheCapacity
+		{
+			int get()
+			{
+				return cacheCapacity;
+			}
+		}
+
+		// Target matrix and range for RGB -> YUV conversions, applied to both the kernels and swscale.
+		property MediaEncoder::ColorSpace ColorSpace
+		{
+			MediaEncoder::ColorSpace get()
+			{
+				return static_cast<MediaEncoder::ColorSpace>(colorSpace);
+			}
+			void set(MediaEncoder::ColorSpace value)
+			{
+				CheckIfDisposed();
+				colorSpace = static_cast<AVColorSpace>(value);
+				ClearCache();
+			}
+		}
+
+		property MediaEncoder::ColorRange ColorRange
+		{
+			MediaEncoder::ColorRange get()
+			{
+				return static_cast<MediaEncoder::ColorRange>(colorRange);
+			}
+			void set(MediaEncoder::ColorRange value)
+			{
+				CheckIfDisposed();
+				colorRange = static_cast<AVColorRange>(value);
+				ClearCache();
+			}
+		}
+
+		// How a source of a different aspect ratio is mapped onto the destination. With Fit, the bars are painted
+		// the first time a destination buffer is seen (the last CacheCapacity buffers are remembered) and again
+		// only when its geometry, format or range changes. Callers that write over the padding of a buffer they
+		// convert into again call InvalidateBorders.
+		property MediaEncoder::ScaleMode ScaleMode
+		{
+			MediaEncoder::ScaleMode get()
+			{
+				return scaleMode;
+			}
+			void set(MediaEncoder::ScaleMode value)
+			{
+				CheckIfDisposed();
+				scaleMode = value;
+			}
+		}
+
+		static property String^ PixelKernel
+		{
+			String^ get()
+			{
+				return gcnew String(GetPixelKernelName());
+			}
+		}
+
+		// When false every conversion goes through swscale, e.g. to compare the kernels against it.
+		property bool UsePixelKernels
+		{
+			bool get()
+			{
+				return usePixelKernels;
+			}
+			void set(bool value)
+			{
+				usePixelKernels = value;
+			}
+		}
+
+		// Runs every vector kernel this CPU supports against the scalar path on random input.
+		static bool VerifyPixelKernels()
+		{
+			return MediaEncoder::VerifyPixelKernels();
+		}
+
+		property int Threads
+		{
+			int get()
+			{
+				return threads;
+			}
+		}
+
+		property uint64_t CacheHits
 		{
-			return Convert(src->Width, src->Height, src->PixelFormat, dstW, dstH, dstFormat, src->DataPointer,
-			               src->LineSize, dst, dstStride);
+			uint64_t get()
+			{
+				return cacheHits;
+			}
 		}
 
-		bool Convert(VideoFrame^ src, VideoFrame^ dest)
+		property uint64_t CacheMisses
 		{
-			return Convert(src->Width, src->Height, src->PixelFormat, dest->Width, dest->Height, dest->PixelFormat,
-			               src->DataPointer, src->LineSize, dest->DataPointer, dest->LineSize);
+			uint64_t get()
+			{
+				return cacheMisses;
+			}
 		}
 	};
 }
@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "VideoFileReader.h"
+
+using namespace Runtime::InteropServices;
+using namespace Collections::Generic;
+
+namespace MediaEncoder
+{
+	// Holds one reference on a MappedFile for a zero-copy VideoFrame and drops it from the frame's release callback.
+	private ref class MappedFileReference
+	{
+	private:
+		MappedFile* m_file;
+
+	public:
+		MappedFileReference(MappedFile* file) : m_file(file)
+		{
+			m_file->AddRef();
+		}
+
+		void Release()
+		{
+			MappedFile* file = m_file;
+			m_file = nullptr;
+			if (file != nullptr)
+				file->Release();
+		}
+	};
+
+	static const int Y4MMaxHeaderLength = 1024;
+
+	// Length of the line starting at offset, without the '\n', or -1 if the file ends first.
+	static int LineLength(const uint8_t* data, int64_t size, int64_t offset, int maxLength)
+	{
+		for (int i = 0; i < maxLength && offset + i < size; i++)
+		{
+			if (data[offset + i] == '\n')
+				return i;
+		}
+		return -1;
+	}
+
+	static AVPixelFormat Y4MPixelFormat(const char* colorspace)
+	{
+		// the 420 variants only differ in chroma siting
+		if (strcmp(colorspace, "420") == 0 || strcmp(colorspace, "420jpeg") == 0 ||
+			strcmp(colorspace, "420paldv") == 0 || strcmp(colorspace, "420mpeg2") == 0)
+			return AV_PIX_FMT_YUV420P;
+		if (strcmp(colorspace, "422") == 0)
+			return AV_PIX_FMT_YUV422P;
+		if (strcmp(colorspace, "444") == 0)
+			return AV_PIX_FMT_YUV444P;
+		if (strcmp(colorspace, "411") == 0)
+			return AV_PIX_FMT_YUV411P;
+		return AV_PIX_FMT_NONE;
+	}
+
+	VideoFileReader::VideoFileReader(String^ path) : m_file(nullptr), m_disposed(false)
+	{
+		OpenFile(path);
+		try
+		{
+			ParseY4M();
+		}
+		catch (Exception^)
+		{
+			this->!VideoFileReader();
+			throw;
+		}
+	}
+
+	VideoFileReader::VideoFileReader(String^ path, int width, int height, MediaEncoder::PixelFormat pixelFormat,
+	                                 int frameRateNumerator, int frameRateDenominator)
+		: m_file(nullptr), m_width(width), m_height(height), m_pixelFormat(pixelFormat),
+		  m_frameRateNumerator(frameRateNumerator), m_frameRateDenominator(frameRateDenominator), m_disposed(false)
+	{
+		if (av_image_check_size(width, height, 0, nullptr) < 0)
+			throw gcnew ArgumentException("VideoFileReader(): invalid frame size.");
+		if (frameRateNumerator <= 0 || frameRateDenominator <= 0)
+			throw gcnew ArgumentOutOfRangeException("frameRateNumerator");
+
+		OpenFile(path);
+		try
+		{
+			IndexRawFrames();
+		}
+		catch (Exception^)
+		{
+			this->!VideoFileReader();
+			throw;
+		}
+	}
+
+	void VideoFileReader::OpenFile(String^ path)
+	{
+		if (path == nullptr)
+			throw gcnew ArgumentNullException("path");
+
+		IntPtr pathStringPointer = Marshal::StringToHGlobalUni(path);
+		m_file = MappedFile::Create(static_cast<wchar_t*>(pathStringPointer.ToPointer()));
+		Marshal::FreeHGlobal(pathStringPointer);
+		if (m_file == nullptr)
+			throw gcnew IO::IOException(String::Format("MappedFile::Create(): cannot map {0}", path));
+	}
+
+	void VideoFileReader::ParseY4M()
+	{
+		const uint8_t* data = m_file->Data();
+		int64_t size = m_file->Size();
+
+		int headerLength = LineLength(data, size, 0, Y4MMaxHeaderLength);
+		if (headerLength < 9 || memcmp(data, "YUV4MPEG2", 9) != 0)
+			throw gcnew IO::InvalidDataException("VideoFileReader(): not a YUV4MPEG2 file.");
+
+		char header[Y4MMaxHeaderLength + 1];
+		memcpy(header, data, headerLength);
+		header[headerLength] = '\0';
+
+		m_width = 0;
+		m_height = 0;
+		m_frameRateNumerator = 0;
+		m_frameRateDenominator = 0;
+		AVPixelFormat format = AV_PIX_FMT_YUV420P;
+
+		char* context = nullptr;
+		for (char* token = strtok_s(header + 9, " ", &context); token != nullptr; token = strtok_s(
+			     nullptr, " ", &context))
+		{
+			switch (token[0])
+			{
+			case 'W':
+				m_width = atoi(token + 1);
+				break;
+			case 'H':
+				m_height = atoi(token + 1);
+				break;
+			case 'F':
+				sscanf_s(token + 1, "%d:%d", &m_frameRateNumerator, &m_frameRateDenominator);
+				break;
+			case 'C':
+				format = Y4MPixelFormat(token + 1);
+				if (format == AV_PIX_FMT_NONE)
+					throw gcnew NotSupportedException(
+						String::Format("VideoFileReader(): Y4M colorspace {0} is not supported.",
+						               gcnew String(token + 1)));
+				break;
+			default:
+				// interlacing, aspect ratio and comments don't change the payload layout
+				break;
+			}
+		}
+
+		if (av_image_check_size(m_width, m_height, 0, nullptr) < 0)
+			throw gcnew IO::InvalidDataException("VideoFileReader(): invalid Y4M frame size.");
+		if (m_frameRateNumerator <= 0 || m_frameRateDenominator <= 0)
+		{
+			m_frameRateNumerator = 25;
+			m_frameRateDenominator = 1;
+		}
+		m_pixelFormat = static_cast<MediaEncoder::PixelFormat>(format);
+		m_frameSize = av_image_get_buffer_size(format, m_width, m_height, 1);
+
+		// Each payload is preceded by a FRAME line that may carry parameters, so offsets are found by walking.
+		auto offsets = gcnew List<Int64>();
+		int64_t offset = headerLength + 1;
+		while (offset < size)
+		{
+			int lineLength = LineLength(data, size, offset, Y4MMaxHeaderLength);
+			if (lineLength < 5 || memcmp(data + offset, "FRAME", 5) != 0)
+				throw gcnew IO::InvalidDataException(
+					String::Format("VideoFileReader(): missing FRAME marker at offset {0}.", offset));
+
+			offset += lineLength + 1;
+			if (offset + m_frameSize > size)
+				break; // truncated last frame
+			offsets->Add(offset);
+			offset += m_frameSize;
+		}
+		m_frameOffsets = offsets->ToArray();
+	}
+
+	void VideoFileReader::IndexRawFrames()
+	{
+		m_frameSize = av_image_get_buffer_size(static_cast<AVPixelFormat>(m_pixelFormat), m_width, m_height, 1);
+		if (m_frameSize <= 0)
+			throw gcnew NotSupportedException("VideoFileReader(): pixel format has no packed layout.");
+
+		auto frameCount = static_cast<int>(m_file->Size() / m_frameSize);
+		m_frameOffsets = gcnew array<Int64>(frameCount);
+		for (int i = 0; i < frameCount; i++)
+			m_frameOffsets[i] = static_cast<Int64>(i) * m_frameSize;
+	}
+
+	FramePlanes VideoFileReader::GetFramePlanes(int index)
+	{
+		CheckIfDisposed();
+		if (index < 0 || index >= m_frameOffsets->Length)
+			throw gcnew ArgumentOutOfRangeException("index");
+
+		uint8_t* data[4];
+		int linesize[4];
+		av_image_fill_arrays(data, linesize, m_file->Data() + m_frameOffsets[index],
+		                     static_cast<AVPixelFormat>(m_pixelFormat), m_width, m_height, 1);
+		return FramePlanes::FromPointers(data, linesize);
+	}
+
+	VideoFrame^ VideoFileReader::ReadFrame(int index)
+	{
+		FramePlanes planes = GetFramePlanes(index);
+
+		auto data = gcnew array<IntPtr>{planes.Data0, planes.Data1, planes.Data2, planes.Data3};
+		auto lineSize = gcnew array<int>{planes.Stride0, planes.Stride1, planes.Stride2, planes.Stride3};
+		auto reference = gcnew MappedFileReference(m_file);
+		try
+		{
+			return gcnew VideoFrame(m_width, m_height, m_pixelFormat, data, lineSize,
+			                        gcnew Action(reference, &MappedFileReference::Release));
+		}
+		catch (Exception^)
+		{
+			reference->Release();
+			throw;
+		}
+	}
+}
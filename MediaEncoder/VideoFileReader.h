@@ -0,0 +1,120 @@
+#pragma once
+
+using namespace System;
+
+#include "MappedFile.h"
+#include "VideoFrame.h"
+
+namespace MediaEncoder
+{
+	// Memory-mapped reader for YUV4MPEG2 (.y4m) files and headerless raw video (NV12, BGRA, ...). Frames are
+	// handed out without copying: GetFramePlanes points straight into the mapping and ReadFrame wraps it in a
+	// read-only VideoFrame that keeps the mapping alive. Meant to replay a fixed corpus through the encoder.
+	public ref class VideoFileReader : IDisposable
+	{
+	private:
+		MappedFile* m_file;
+		array<Int64>^ m_frameOffsets;
+		int m_frameSize;
+		int m_width;
+		int m_height;
+		PixelFormat m_pixelFormat;
+		int m_frameRateNumerator;
+		int m_frameRateDenominator;
+		bool m_disposed;
+
+		void CheckIfDisposed()
+		{
+			if (m_disposed)
+				throw gcnew ObjectDisposedException("The object was already disposed.");
+		}
+
+		void OpenFile(String^ path);
+		void ParseY4M();
+		void IndexRawFrames();
+
+	protected:
+		!VideoFileReader()
+		{
+			if (m_file != nullptr)
+			{
+				m_file->Release();
+				m_file = nullptr;
+			}
+		}
+
+	public:
+		// Opens a Y4M file; geometry, pixel format and frame rate come from its header.
+		VideoFileReader(String^ path);
+
+		// Opens a raw file holding tightly packed frames of the given geometry and format back to back.
+		VideoFileReader(String^ path, int width, int height, PixelFormat pixelFormat, int frameRateNumerator,
+		                int frameRateDenominator);
+
+		~VideoFileReader()
+		{
+			this->!VideoFileReader();
+			m_disposed = true;
+		}
+
+		// Planes of frame index inside the mapping; only valid while the reader is alive.
+		FramePlanes GetFramePlanes(int index);
+
+		// Zero-copy frame over frame index; stays valid after the reader is disposed.
+		VideoFrame^ ReadFrame(int index);
+
+		property int FrameCount
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_frameOffsets->Length;
+			}
+		}
+
+		property int Width
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_width;
+			}
+		}
+
+		property int Height
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_height;
+			}
+		}
+
+		property PixelFormat PixelFormat
+		{
+			MediaEncoder::PixelFormat get()
+			{
+				CheckIfDisposed();
+				return m_pixelFormat;
+			}
+		}
+
+		property int FrameRateNumerator
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_frameRateNumerator;
+			}
+		}
+
+		property int FrameRateDenominator
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_frameRateDenominator;
+			}
+		}
+	};
+}
@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "VideoFilterGraph.h"
+
+namespace MediaEncoder
+{
+	int VideoFilterGraph::Create(const char* filters, int threads, int width, int height, AVPixelFormat format,
+	                             AVRational timeBase, AVPixelFormat outputFormat, VideoFilterGraph** graph)
+	{
+		*graph = nullptr;
+
+		auto filterGraph = new VideoFilterGraph();
+		filterGraph->m_graph = avfilter_graph_alloc();
+		filterGraph->m_source = nullptr;
+		filterGraph->m_sink = nullptr;
+		filterGraph->m_width = width;
+		filterGraph->m_height = height;
+		filterGraph->m_format = format;
+		if (filterGraph->m_graph == nullptr)
+		{
+			delete filterGraph;
+			return AVERROR(ENOMEM);
+		}
+		filterGraph->m_graph->nb_threads = threads;
+
+		char args[256];
+		snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=1/1", width, height,
+		         format, timeBase.num, timeBase.den);
+
+		AVFilterInOut* outputs = nullptr;
+		AVFilterInOut* inputs = nullptr;
+		enum AVPixelFormat sinkFormats[] = {outputFormat, AV_PIX_FMT_NONE};
+
+		int ret = avfilter_graph_create_filter(&filterGraph->m_source, avfilter_get_by_name("buffer"), "in", args,
+		                                       nullptr, filterGraph->m_graph);
+		if (ret >= 0)
+			ret = avfilter_graph_create_filter(&filterGraph->m_sink, avfilter_get_by_name("buffersink"), "out",
+			                                   nullptr, nullptr, filterGraph->m_graph);
+		if (ret >= 0)
+			ret = av_opt_set_int_list(filterGraph->m_sink, "pix_fmts", sinkFormats, AV_PIX_FMT_NONE,
+			                          AV_OPT_SEARCH_CHILDREN);
+		if (ret >= 0)
+		{
+			outputs = avfilter_inout_alloc();
+			inputs = avfilter_inout_alloc();
+			if (outputs == nullptr || inputs == nullptr)
+				ret = AVERROR(ENOMEM);
+		}
+		if (ret >= 0)
+		{
+			// the open ends of the description: its input is fed by "in", its output drains into "out"
+			outputs->name = av_strdup("in");
+			outputs->filter_ctx = filterGraph->m_source;
+			outputs->pad_idx = 0;
+			outputs->next = nullptr;
+
+			inputs->name = av_strdup("out");
+			inputs->filter_ctx = filterGraph->m_sink;
+			inputs->pad_idx = 0;
+			inputs->next = nullptr;
+
+			ret = avfilter_graph_parse_ptr(filterGraph->m_graph, filters, &inputs, &outputs, nullptr);
+		}
+		if (ret >= 0)
+			ret = avfilter_graph_config(filterGraph->m_graph, nullptr);
+
+		avfilter_inout_free(&inputs);
+		avfilter_inout_free(&outputs);
+
+		if (ret < 0)
+		{
+			Destroy(filterGraph);
+			return ret;
+		}
+
+		*graph = filterGraph;
+		return 0;
+	}
+
+	void VideoFilterGraph::Destroy(VideoFilterGraph* graph)
+	{
+		if (graph == nullptr)
+			return;
+
+		avfilter_graph_free(&graph->m_graph);
+		delete graph;
+	}
+
+	bool VideoFilterGraph::Matches(int width, int height, AVPixelFormat format) const
+	{
+		return m_width == width && m_height == height && m_format == format;
+	}
+
+	int VideoFilterGraph::Push(AVFrame* frame)
+	{
+		return av_buffersrc_add_frame_flags(m_source, frame, 0);
+	}
+
+	int VideoFilterGraph::Pull(AVFrame* frame)
+	{
+		return av_buffersink_get_frame(m_sink, frame);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace MediaEncoder
+{
+	// buffer -> filters -> buffersink, built from an avfilter description such as "hqdn3d,crop=1280:720,fps=30".
+	// Frames travel through the graph by reference; only the filters themselves touch the pixels.
+	class VideoFilterGraph
+	{
+	public:
+		// Returns a negative AVERROR and leaves *graph null on failure. threads is AVFilterGraph::nb_threads,
+		// 0 lets libavfilter pick. The sink only accepts outputFormat, so the conversion to the encoder format
+		// runs inside the graph as well.
+		static int Create(const char* filters, int threads, int width, int height, AVPixelFormat format,
+		                  AVRational timeBase, AVPixelFormat outputFormat, VideoFilterGraph** graph);
+		static void Destroy(VideoFilterGraph* graph);
+
+		bool Matches(int width, int height, AVPixelFormat format) const;
+
+		// Moves the reference held by frame into the graph and resets frame; nullptr signals the end of input.
+		int Push(AVFrame* frame);
+		// AVERROR(EAGAIN) when the graph needs more input, AVERROR_EOF once a flushed graph is empty.
+		int Pull(AVFrame* frame);
+
+	private:
+		VideoFilterGraph() = default;
+
+		AVFilterGraph* m_graph;
+		AVFilterContext* m_source;
+		AVFilterContext* m_sink;
+		int m_width, m_height;
+		AVPixelFormat m_format;
+	};
+}
@@ -3,18 +3,39 @@
 
 namespace MediaEncoder
 {
+	static void ReleaseExternalBuffer(void* opaque, uint8_t* data)
+	{
+		GCHandle handle = GCHandle::FromIntPtr(IntPtr(opaque));
+		auto release = safe_cast<Action^>(handle.Target);
+		handle.Free();
+
+		// This runs inside av_buffer_unref, possibly on an FFmpeg thread; nothing may be thrown through it.
+		try
+		{
+			release();
+		}
+		catch (Exception^ e)
+		{
+			System::Diagnostics::Debug::WriteLine("VideoFrame release callback: {0}", e->Message);
+		}
+	}
+
 	VideoFrame::VideoFrame(VideoFrame^ videoFrame)
 	{
 		m_avFrame = av_frame_clone(videoFrame->m_avFrame);
 	}
 
+	VideoFrame::VideoFrame(AVFrame* avFrame) : m_avFrame(avFrame), m_disposed(false)
+	{
+	}
+
 	VideoFrame::VideoFrame(int width, int height, MediaEncoder::PixelFormat pixelFormat) : m_disposed(false)
 	{
 		m_avFrame = av_frame_alloc();
 		m_avFrame->width = width;
 		m_avFrame->height = height;
 		m_avFrame->format = static_cast<int>(pixelFormat);
-		av_frame_get_buffer(m_avFrame, 32);
+		av_frame_get_buffer(m_avFrame, 64);
 	}
 
 	VideoFrame::VideoFrame(Windows::Media::Imaging::BitmapSource^ bitmapSource) : m_disposed(false)
@@ -23,13 +44,58 @@ namespace MediaEncoder
 		m_avFrame->width = bitmapSource->PixelWidth;
 		m_avFrame->height = bitmapSource->PixelHeight;
 		m_avFrame->format = static_cast<int>(AVPixelFormat::AV_PIX_FMT_BGRA);
-		av_frame_get_buffer(m_avFrame, 32);
+		av_frame_get_buffer(m_avFrame, 64);
 
 		bitmapSource->CopyPixels(Windows::Int32Rect(0, 0, bitmapSource->PixelWidth, bitmapSource->PixelHeight),
 		                         IntPtr(m_avFrame->data[0]), m_avFrame->linesize[0] * m_avFrame->height,
 		                         m_avFrame->linesize[0]);
 	}
 
+	VideoFrame::VideoFrame(int width, int height, MediaEncoder::PixelFormat pixelFormat, array<IntPtr>^ data,
+	                       array<int>^ lineSize, Action^ release) : m_disposed(false)
+	{
+		if (data == nullptr || lineSize == nullptr || data->Length == 0 || data[0] == IntPtr::Zero)
+			throw gcnew ArgumentNullException("data");
+		if (release == nullptr)
+			throw gcnew ArgumentNullException("release");
+
+		auto format = static_cast<AVPixelFormat>(pixelFormat);
+		ptrdiff_t linesizes[4] = {0, 0, 0, 0};
+		for (int i = 0; i < 4 && i < lineSize->Length; i++)
+			linesizes[i] = lineSize[i];
+
+		size_t planeSizes[4];
+		if (av_image_check_size(width, height, 0, nullptr) < 0 || av_image_fill_plane_sizes(
+			planeSizes, format, height, linesizes) < 0)
+			throw gcnew ArgumentException("VideoFrame(): invalid frame geometry or pixel format.");
+
+		m_avFrame = av_frame_alloc();
+		if (m_avFrame == nullptr)
+			throw gcnew OutOfMemoryException("av_frame_alloc");
+
+		m_avFrame->width = width;
+		m_avFrame->height = height;
+		m_avFrame->format = format;
+		for (int i = 0; i < 4; i++)
+		{
+			m_avFrame->data[i] = (i < data->Length) ? static_cast<uint8_t*>(data[i].ToPointer()) : nullptr;
+			m_avFrame->linesize[i] = static_cast<int>(linesizes[i]);
+		}
+
+		// One reference covers all planes; the size only matters to code that copies the buffer.
+		GCHandle handle = GCHandle::Alloc(release);
+		m_avFrame->buf[0] = av_buffer_create(m_avFrame->data[0], planeSizes[0], ReleaseExternalBuffer,
+		                                     GCHandle::ToIntPtr(handle).ToPointer(), AV_BUFFER_FLAG_READONLY);
+		if (m_avFrame->buf[0] == nullptr)
+		{
+			handle.Free();
+			AVFrame* frame = m_avFrame;
+			av_frame_free(&frame);
+			m_avFrame = nullptr;
+			throw gcnew OutOfMemoryException("av_buffer_create");
+		}
+	}
+
 	void VideoFrame::FillFrame(IntPtr src, int srcStride)
 	{
 		CheckIfDisposed();
@@ -56,4 +122,16 @@ namespace MediaEncoder
 		av_image_copy(m_avFrame->data, m_avFrame->linesize, src_data, src_linesize,
 		              static_cast<AVPixelFormat>(m_avFrame->format), m_avFrame->width, m_avFrame->height);
 	}
+
+	void VideoFrame::FillFrame(FramePlanes src)
+	{
+		CheckIfDisposed();
+
+		uint8_t* src_data[4];
+		int src_linesize[4];
+		src.CopyTo(src_data, src_linesize);
+
+		av_image_copy(m_avFrame->data, m_avFrame->linesize, const_cast<const uint8_t**>(src_data), src_linesize,
+		              static_cast<AVPixelFormat>(m_avFrame->format), m_avFrame->width, m_avFrame->height);
+	}
 }
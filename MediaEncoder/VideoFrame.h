@@ -1,5 +1,9 @@
 #pragma once
 
+using namespace System;
+using namespace Runtime::InteropServices;
+
+#include "FramePlanes.h"
 
 namespace MediaEncoder
 {
@@ -32,14 +36,26 @@ namespace MediaEncoder
 		VideoFrame(int width, int height, PixelFormat pixelFormat);
 		VideoFrame(Windows::Media::Imaging::BitmapSource^ bitmapSource);
 
+		// Wraps planes owned by the caller without copying them. The frame and every reference the encoder takes
+		// on it share the memory; release is invoked, on whichever thread drops the last reference, once the
+		// memory is no longer used. The planes are marked read-only, so FFmpeg copies before it ever writes.
+		VideoFrame(int width, int height, PixelFormat pixelFormat, array<IntPtr>^ data, array<int>^ lineSize,
+		           Action^ release);
+
 		~VideoFrame()
 		{
 			this->!VideoFrame();
 			m_disposed = true;
 		}
 
+	internal:
+		// Takes ownership of avFrame.
+		VideoFrame(AVFrame* avFrame);
+
+	public:
 		void FillFrame(IntPtr src, int srcStride);
 		void FillFrame(array<IntPtr>^ src, array<int>^ srcStride);
+		void FillFrame(FramePlanes src);
 	public:
 		property IntPtr NativePointer
 		{
@@ -76,7 +92,7 @@ namespace MediaEncoder
 				auto result = gcnew array<int>(8);
 				for (int i = 0; i < 8; i++)
 				{
-					result[i] = m_avFrame->linesize[0];
+					result[i] = m_avFrame->linesize[i];
 				}
 				return result;
 			}
@@ -96,6 +112,16 @@ namespace MediaEncoder
 			}
 		}
 
+		// Same as DataPointer and LineSize, without allocating.
+		property FramePlanes Planes
+		{
+			FramePlanes get()
+			{
+				CheckIfDisposed();
+				return FramePlanes::FromAVFrame(m_avFrame);
+			}
+		}
+
 		property PixelFormat PixelFormat
 		{
 			MediaEncoder::PixelFormat get()
@@ -104,5 +130,21 @@ namespace MediaEncoder
 				return static_cast<MediaEncoder::PixelFormat>(m_avFrame->format);
 			}
 		}
+
+		// QueryPerformanceCounter (Stopwatch) ticks at which the content was captured, 0 if unknown. Kept in
+		// AVFrame::opaque so it follows the frame through av_frame_ref, clones and filter graphs.
+		property Int64 CaptureTimestamp
+		{
+			Int64 get()
+			{
+				CheckIfDisposed();
+				return reinterpret_cast<intptr_t>(m_avFrame->opaque);
+			}
+			void set(Int64 value)
+			{
+				CheckIfDisposed();
+				m_avFrame->opaque = reinterpret_cast<void*>(static_cast<intptr_t>(value));
+			}
+		}
 	};
 }
@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "VideoFramePool.h"
+
+namespace MediaEncoder
+{
+#pragma managed(push, off)
+	static void FreeAlignedBuffer(void* opaque, uint8_t* data)
+	{
+		_aligned_free(data);
+	}
+
+	static AVBufferRef* AllocAlignedBuffer(void* opaque, size_t size)
+	{
+		auto data = static_cast<uint8_t*>(_aligned_malloc(size, 64));
+		if (data == nullptr)
+			return nullptr;
+
+		AVBufferRef* buffer = av_buffer_create(data, size, FreeAlignedBuffer, nullptr, 0);
+		if (buffer == nullptr)
+		{
+			_aligned_free(data);
+			return nullptr;
+		}
+
+		static_cast<VideoFramePoolBucket*>(opaque)->allocated++;
+		return buffer;
+	}
+#pragma managed(pop)
+
+	VideoFramePool::VideoFramePool() : VideoFramePool(4)
+	{
+	}
+
+	VideoFramePool::VideoFramePool(int bucketCapacity)
+		:
+		m_buckets(nullptr), m_bucketCapacity(bucketCapacity > 0 ? bucketCapacity : 1), m_useCounter(0), m_hits(0),
+		m_misses(0), m_peakSize(0), m_disposed(false)
+	{
+		m_buckets = new VideoFramePoolBucket[m_bucketCapacity];
+		memset(m_buckets, 0, sizeof(VideoFramePoolBucket) * m_bucketCapacity);
+	}
+
+	VideoFramePoolBucket* VideoFramePool::GetBucket(int width, int height, AVPixelFormat format)
+	{
+		m_useCounter++;
+
+		VideoFramePoolBucket* victim = &m_buckets[0];
+		for (int i = 0; i < m_bucketCapacity; i++)
+		{
+			VideoFramePoolBucket* bucket = &m_buckets[i];
+			if (bucket->pool != nullptr && bucket->width == width && bucket->height == height && bucket->format ==
+				format)
+			{
+				bucket->lastUse = m_useCounter;
+				return bucket;
+			}
+
+			if (victim->pool != nullptr && (bucket->pool == nullptr || bucket->lastUse < victim->lastUse))
+				victim = bucket;
+		}
+
+		int linesize[4];
+		if (av_image_check_size(width, height, 0, nullptr) < 0 || av_image_fill_linesizes(linesize, format, width) < 0)
+			throw gcnew ArgumentException("VideoFramePool::Rent(): invalid frame geometry or pixel format.");
+
+		ptrdiff_t alignedLinesize[4];
+		for (int i = 0; i < 4; i++)
+		{
+			linesize[i] = FFALIGN(linesize[i], 64);
+			alignedLinesize[i] = linesize[i];
+		}
+
+		size_t planeSize[4];
+		if (av_image_fill_plane_sizes(planeSize, format, height, alignedLinesize) < 0)
+			throw gcnew ArgumentException("VideoFramePool::Rent(): invalid frame geometry or pixel format.");
+
+		if (victim->pool != nullptr)
+			av_buffer_pool_uninit(&victim->pool);
+		memset(victim, 0, sizeof(VideoFramePoolBucket));
+
+		size_t size = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			victim->linesize[i] = linesize[i];
+			victim->offset[i] = size;
+			size += FFALIGN(planeSize[i], 64);
+		}
+
+		// Room for SIMD code that reads a little past the last row, as av_frame_get_buffer leaves.
+		victim->size = size + 64;
+		victim->width = width;
+		victim->height = height;
+		victim->format = format;
+		victim->lastUse = m_useCounter;
+		victim->pool = av_buffer_pool_init2(victim->size, victim, AllocAlignedBuffer, nullptr);
+		if (victim->pool == nullptr)
+			throw gcnew OutOfMemoryException("av_buffer_pool_init2");
+
+		return victim;
+	}
+
+	VideoFrame^ VideoFramePool::Rent(int width, int height, PixelFormat pixelFormat)
+	{
+		CheckIfDisposed();
+
+		VideoFramePoolBucket* bucket = GetBucket(width, height, static_cast<AVPixelFormat>(pixelFormat));
+
+		uint64_t allocated = bucket->allocated;
+		AVBufferRef* buffer = av_buffer_pool_get(bucket->pool);
+		if (buffer == nullptr)
+			throw gcnew OutOfMemoryException("av_buffer_pool_get");
+
+		if (bucket->allocated != allocated)
+		{
+			m_misses++;
+			if (bucket->allocated > m_peakSize)
+				m_peakSize = bucket->allocated;
+		}
+		else
+		{
+			m_hits++;
+		}
+
+		AVFrame* frame = av_frame_alloc();
+		if (frame == nullptr)
+		{
+			av_buffer_unref(&buffer);
+			throw gcnew OutOfMemoryException("av_frame_alloc");
+		}
+
+		frame->width = width;
+		frame->height = height;
+		frame->format = bucket->format;
+		frame->buf[0] = buffer;
+		for (int i = 0; i < 4; i++)
+		{
+			if (bucket->linesize[i] == 0)
+				break;
+
+			frame->data[i] = buffer->data + bucket->offset[i];
+			frame->linesize[i] = bucket->linesize[i];
+		}
+
+		return gcnew VideoFrame(frame);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+using namespace System;
+using namespace IO;
+
+#include "VideoFrame.h"
+
+namespace MediaEncoder
+{
+	struct VideoFramePoolBucket
+	{
+		int width, height;
+		AVPixelFormat format;
+		int linesize[4];
+		size_t offset[4];
+		size_t size;
+		AVBufferPool* pool;
+		uint64_t allocated;
+		uint64_t lastUse;
+	};
+
+	// Hands out VideoFrames whose buffers come from one AVBufferPool per (width, height, PixelFormat).
+	// Disposing a rented frame returns its buffer to the pool instead of freeing it. All planes share one
+	// buffer with 64 byte aligned planes and rows. Rent is meant to be called from a single thread; rented
+	// frames can be disposed from any thread, also after the pool itself was disposed.
+	public ref class VideoFramePool : IDisposable
+	{
+	private:
+		VideoFramePoolBucket* m_buckets;
+		int m_bucketCapacity;
+		uint64_t m_useCounter;
+		uint64_t m_hits;
+		uint64_t m_misses;
+		uint64_t m_peakSize;
+		bool m_disposed;
+
+		void CheckIfDisposed()
+		{
+			if (m_disposed)
+				throw gcnew ObjectDisposedException("The object was already disposed.");
+		}
+
+		VideoFramePoolBucket* GetBucket(int width, int height, AVPixelFormat format);
+
+	protected:
+		!VideoFramePool()
+		{
+			if (m_buckets != nullptr)
+			{
+				for (int i = 0; i < m_bucketCapacity; i++)
+				{
+					// Buffers still rented out keep their pool alive until they are returned.
+					if (m_buckets[i].pool != nullptr)
+						av_buffer_pool_uninit(&m_buckets[i].pool);
+				}
+				delete[] m_buckets;
+				m_buckets = nullptr;
+			}
+		}
+
+	public:
+		VideoFramePool();
+		VideoFramePool(int bucketCapacity);
+
+		~VideoFramePool()
+		{
+			this->!VideoFramePool();
+			m_disposed = true;
+		}
+
+		VideoFrame^ Rent(int width, int height, PixelFormat pixelFormat);
+
+	public:
+		// Rents served with a recycled buffer.
+		property uint64_t Hits
+		{
+			uint64_t get()
+			{
+				return m_hits;
+			}
+		}
+
+		// Rents that had to allocate a new buffer.
+		property uint64_t Misses
+		{
+			uint64_t get()
+			{
+				return m_misses;
+			}
+		}
+
+		// Largest number of buffers a single geometry has needed at once.
+		property uint64_t PeakSize
+		{
+			uint64_t get()
+			{
+				return m_peakSize;
+			}
+		}
+	};
+}
@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "WaveFileReader.h"
+
+using namespace Runtime::InteropServices;
+
+namespace MediaEncoder
+{
+	static const uint16_t WaveFormatPcm = 0x0001;
+	static const uint16_t WaveFormatIeeeFloat = 0x0003;
+	static const uint16_t WaveFormatExtensible = 0xFFFE;
+
+	static uint16_t ReadUInt16(const uint8_t* p)
+	{
+		return static_cast<uint16_t>(p[0] | (p[1] << 8));
+	}
+
+	static uint32_t ReadUInt32(const uint8_t* p)
+	{
+		return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+			(static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	static AVSampleFormat WaveSampleFormat(uint16_t formatTag, int bitsPerSample)
+	{
+		if (formatTag == WaveFormatPcm)
+		{
+			switch (bitsPerSample)
+			{
+			case 8: return AV_SAMPLE_FMT_U8;
+			case 16: return AV_SAMPLE_FMT_S16;
+			case 32: return AV_SAMPLE_FMT_S32;
+			default: return AV_SAMPLE_FMT_NONE;
+			}
+		}
+		if (formatTag == WaveFormatIeeeFloat)
+		{
+			switch (bitsPerSample)
+			{
+			case 32: return AV_SAMPLE_FMT_FLT;
+			case 64: return AV_SAMPLE_FMT_DBL;
+			default: return AV_SAMPLE_FMT_NONE;
+			}
+		}
+		return AV_SAMPLE_FMT_NONE;
+	}
+
+	WaveFileReader::WaveFileReader(String^ path) : m_file(nullptr), m_disposed(false)
+	{
+		if (path == nullptr)
+			throw gcnew ArgumentNullException("path");
+
+		IntPtr pathStringPointer = Marshal::StringToHGlobalUni(path);
+		m_file = MappedFile::Create(static_cast<wchar_t*>(pathStringPointer.ToPointer()));
+		Marshal::FreeHGlobal(pathStringPointer);
+		if (m_file == nullptr)
+			throw gcnew IO::IOException(String::Format("MappedFile::Create(): cannot map {0}", path));
+
+		try
+		{
+			ParseHeader();
+		}
+		catch (Exception^)
+		{
+			this->!WaveFileReader();
+			throw;
+		}
+	}
+
+	void WaveFileReader::ParseHeader()
+	{
+		const uint8_t* data = m_file->Data();
+		int64_t size = m_file->Size();
+
+		if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+			throw gcnew IO::InvalidDataException("WaveFileReader(): not a RIFF/WAVE file.");
+
+		bool hasFormat = false;
+		int64_t offset = 12;
+		while (offset + 8 <= size)
+		{
+			const uint8_t* chunk = data + offset;
+			int64_t chunkSize = ReadUInt32(chunk + 4);
+			int64_t body = offset + 8;
+
+			if (memcmp(chunk, "fmt ", 4) == 0)
+			{
+				if (chunkSize < 16 || body + chunkSize > size)
+					throw gcnew IO::InvalidDataException("WaveFileReader(): truncated fmt chunk.");
+
+				uint16_t formatTag = ReadUInt16(data + body);
+				m_channels = ReadUInt16(data + body + 2);
+				m_sampleRate = static_cast<int>(ReadUInt32(data + body + 4));
+				m_blockAlign = ReadUInt16(data + body + 12);
+				int bitsPerSample = ReadUInt16(data + body + 14);
+				// WAVE_FORMAT_EXTENSIBLE keeps the real tag in the first two bytes of its SubFormat GUID
+				if (formatTag == WaveFormatExtensible && chunkSize >= 40)
+					formatTag = ReadUInt16(data + body + 24);
+
+				AVSampleFormat format = WaveSampleFormat(formatTag, bitsPerSample);
+				if (format == AV_SAMPLE_FMT_NONE)
+					throw gcnew NotSupportedException(String::Format(
+						"WaveFileReader(): format 0x{0:X4} with {1} bits per sample is not supported.", formatTag,
+						bitsPerSample));
+				if (m_channels <= 0 || m_sampleRate <= 0 || m_blockAlign != m_channels * bitsPerSample / 8)
+					throw gcnew IO::InvalidDataException("WaveFileReader(): inconsistent fmt chunk.");
+
+				m_sampleFormat = static_cast<MediaEncoder::SampleFormat>(format);
+				hasFormat = true;
+			}
+			else if (memcmp(chunk, "data", 4) == 0)
+			{
+				if (!hasFormat)
+					throw gcnew IO::InvalidDataException("WaveFileReader(): data chunk before fmt chunk.");
+
+				// recorders that were killed mid-write leave the size unset; take whatever is in the file
+				int64_t dataSize = min(chunkSize, size - body);
+				m_dataOffset = body;
+				m_samples = dataSize / m_blockAlign;
+				return;
+			}
+
+			// chunks are padded to an even size
+			offset = body + chunkSize + (chunkSize & 1);
+		}
+
+		throw gcnew IO::InvalidDataException("WaveFileReader(): no data chunk.");
+	}
+
+	IntPtr WaveFileReader::GetSamples(Int64 offset)
+	{
+		CheckIfDisposed();
+		if (offset < 0 || offset > m_samples)
+			throw gcnew ArgumentOutOfRangeException("offset");
+
+		return IntPtr(const_cast<uint8_t*>(m_file->Data() + m_dataOffset + offset * m_blockAlign));
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+using namespace System;
+
+#include "MappedFile.h"
+
+namespace MediaEncoder
+{
+	// Memory-mapped reader for RIFF/WAVE files with 8/16/32-bit PCM or 32/64-bit float samples. Samples are not
+	// copied: GetSamples points into the mapping and stays valid while the reader is alive.
+	public ref class WaveFileReader : IDisposable
+	{
+	private:
+		MappedFile* m_file;
+		int64_t m_dataOffset;
+		Int64 m_samples;
+		int m_sampleRate;
+		int m_channels;
+		int m_blockAlign;
+		SampleFormat m_sampleFormat;
+		bool m_disposed;
+
+		void CheckIfDisposed()
+		{
+			if (m_disposed)
+				throw gcnew ObjectDisposedException("The object was already disposed.");
+		}
+
+		void ParseHeader();
+
+	protected:
+		!WaveFileReader()
+		{
+			if (m_file != nullptr)
+			{
+				m_file->Release();
+				m_file = nullptr;
+			}
+		}
+
+	public:
+		WaveFileReader(String^ path);
+
+		~WaveFileReader()
+		{
+			this->!WaveFileReader();
+			m_disposed = true;
+		}
+
+		// Interleaved samples starting at sample offset (counted per channel).
+		IntPtr GetSamples(Int64 offset);
+
+		// Number of samples per channel.
+		property Int64 Samples
+		{
+			Int64 get()
+			{
+				CheckIfDisposed();
+				return m_samples;
+			}
+		}
+
+		property int SampleRate
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_sampleRate;
+			}
+		}
+
+		property int Channels
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_channels;
+			}
+		}
+
+		// Bytes per sample across all channels.
+		property int BlockAlign
+		{
+			int get()
+			{
+				CheckIfDisposed();
+				return m_blockAlign;
+			}
+		}
+
+		property SampleFormat SampleFormat
+		{
+			MediaEncoder::SampleFormat get()
+			{
+				CheckIfDisposed();
+				return m_sampleFormat;
+			}
+		}
+	};
+}
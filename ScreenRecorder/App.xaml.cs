@@ -1,7 +1,9 @@
 ﻿using System;
+using System.IO;
 using System.Text.RegularExpressions;
 using System.Threading;
 using System.Windows;
+using ScreenRecorder.Encoder;
 
 namespace ScreenRecorder
 {
@@ -17,6 +19,11 @@ namespace ScreenRecorder
 #if DEBUG
             ScreenRecorder.Properties.Resources.Culture = new System.Globalization.CultureInfo("en-US");
 #endif
+            if (e.Args.Length >= 3 && e.Args[0].Equals("/replay", StringComparison.OrdinalIgnoreCase))
+            {
+                Environment.Exit(Replay(e.Args[1], e.Args[2], e.Args.Length > 3 ? e.Args[3] : null));
+            }
+
             try
             {
                 Mutex = new Mutex(true, AppConstants.AppName, out bool isNew);
@@ -47,6 +54,45 @@ namespace ScreenRecorder
             }
         }
 
+        /// <summary>
+        /// ScreenRecorder /replay video.y4m output.mp4 [audio.wav]: records the files through the same encoder
+        /// as a screen capture, without a window, at the default settings. Returns 0 on success.
+        /// </summary>
+        private static int Replay(string videoPath, string url, string audioPath)
+        {
+            string format = Path.GetExtension(url).TrimStart('.').ToLowerInvariant();
+            var stopped = new ManualResetEvent(false);
+            ulong videoFramesCount = 0;
+
+            VideoClockEvent.Start();
+            try
+            {
+                using (var replayEncoder = new ReplayEncoder())
+                {
+                    replayEncoder.EncoderStopped += (sender, eventArgs) =>
+                    {
+                        videoFramesCount = eventArgs.VideoFramesCount;
+                        stopped.Set();
+                    };
+                    replayEncoder.Start(format, url, MediaEncoder.VideoCodec.H264, 5000000,
+                        MediaEncoder.AudioCodec.Aac, 160000, videoPath, audioPath);
+                    stopped.WaitOne();
+                }
+            }
+            catch (Exception ex)
+            {
+                Console.Error.WriteLine(ex.Message);
+                return -1;
+            }
+            finally
+            {
+                VideoClockEvent.Stop();
+                stopped.Close();
+            }
+
+            return videoFramesCount > 0 ? 0 : -1;
+        }
+
         protected override void OnExit(ExitEventArgs e)
         {
             AppCommands.Instance.Dispose();
@@ -1,24 +1,27 @@
 ﻿using System;
+using System.Diagnostics;
 using System.Linq;
 using System.Runtime.InteropServices;
 using System.Threading;
 using MediaEncoder;
-using ScreenRecorder.Encoder;
 
 namespace ScreenRecorder.AudioSource
 {
     /// <summary>
-    /// Audio Mixer (2Ch, 16bit, 48000Hz)
+    /// Audio Mixer (2Ch, 32bit float, 48000Hz)
     /// </summary>
     public class AudioMixer : IAudioSource, IDisposable
     {
         #region Fields
 
         private readonly IAudioSource[] _audioSources;
-        private readonly CircularBuffer _circularMixerBuffer;
+        private readonly AudioRingBuffer _circularMixerBuffer;
         private readonly int _samplesPerFrame;
         private readonly int _samplesBytesPerFrame;
-        private readonly int _framesPerAdditinalSample;
+
+        // capture time of the sample at the write end of _circularMixerBuffer, 0 while unknown
+        private readonly object _timestampSyncObject = new object();
+        private long _writeTimestamp;
 
         private Thread _mixerThread, _renderThread;
         private ManualResetEvent _needToStop;
@@ -31,12 +34,9 @@ namespace ScreenRecorder.AudioSource
         {
             _audioSources = audioSources;
             _samplesPerFrame = (int)(48000.0d / VideoClockEvent.Framerate);
-            _samplesBytesPerFrame = _samplesPerFrame * 2 * 2; // 2Ch, 16bit
-
-            var remainingSamples = 48000 - (_samplesPerFrame * VideoClockEvent.Framerate);
-            _framesPerAdditinalSample = remainingSamples != 0 ? VideoClockEvent.Framerate / remainingSamples : 0;
+            _samplesBytesPerFrame = _samplesPerFrame * 2 * 4; // 2Ch, 32bit float
 
-            _circularMixerBuffer = new CircularBuffer(_samplesBytesPerFrame * 6);
+            _circularMixerBuffer = new AudioRingBuffer(_samplesBytesPerFrame * 6);
 
             _needToStop = new ManualResetEvent(false);
 
@@ -87,15 +87,18 @@ namespace ScreenRecorder.AudioSource
             }
 
             _needToStop = null;
+
+            _circularMixerBuffer.Dispose();
         }
 
         private void MixerThreadHandler()
         {
-            var sources = _audioSources.Select(source => new AudioSourceResampler(source, 2, SampleFormat.S16, 48000))
+            // each source is steered to keep three frames of audio buffered, which absorbs its clock drift
+            var sources = _audioSources.Select(source => new AudioSourceResampler(source, 2, SampleFormat.FLT, 48000, _samplesPerFrame * 10, _samplesPerFrame * 3))
                 .ToArray();
 
-            var sample = Marshal.AllocHGlobal(_samplesBytesPerFrame + 4);
-            var mixSample = Marshal.AllocHGlobal(_samplesBytesPerFrame + 4);
+            var sample = Marshal.AllocHGlobal(_samplesBytesPerFrame + 8);
+            var mixSample = Marshal.AllocHGlobal(_samplesBytesPerFrame + 8);
 
             using (var systemClockEvent = new VideoClockEvent())
             {
@@ -104,8 +107,10 @@ namespace ScreenRecorder.AudioSource
                 {
                     if (systemClockEvent.WaitOne(10))
                     {
-                        var samplesBytesPerFrame = _samplesBytesPerFrame + (frames++ % 3 == 0 ? 4 : 0);
+                        var samplesBytesPerFrame = Utils.AudioSamplesForVideoFrames(frames++, 1, 48000) * 8;
 
+                        // the mix is timed by the first source, which is always read
+                        var timestamp = sources[0].ReadTimestamp;
                         var count = sources[0].Buffer.Read(mixSample, samplesBytesPerFrame);
                         if (count < samplesBytesPerFrame)
                         {
@@ -122,11 +127,15 @@ namespace ScreenRecorder.AudioSource
                                     ZeroMemory(sample + count, new IntPtr(samplesBytesPerFrame - count));
                                 }
 
-                                MixStereoSamples(sample, mixSample, mixSample, count / 4);
+                                MixStereoSamples(sample, mixSample, mixSample, count / 8);
                             }
                         }
 
-                        _circularMixerBuffer.Write(mixSample, 0, samplesBytesPerFrame);
+                        lock (_timestampSyncObject)
+                        {
+                            _circularMixerBuffer.Write(mixSample, samplesBytesPerFrame);
+                            _writeTimestamp = timestamp != 0 ? timestamp + SamplesToTicks(samplesBytesPerFrame / 8) : 0;
+                        }
                     }
                 }
             }
@@ -140,38 +149,29 @@ namespace ScreenRecorder.AudioSource
             }
         }
 
+        private static long SamplesToTicks(long samples)
+        {
+            return samples * Stopwatch.Frequency / 48000;
+        }
+
         private void MixStereoSamples(IntPtr sample1, IntPtr sample2, IntPtr mix, int samples = 1)
         {
             unsafe
             {
-                var pSample1 = (short*)sample1.ToPointer();
-                var pSample2 = (short*)sample2.ToPointer();
-                var pMixSample = (short*)mix;
-                for (var s = 0; s < samples; s++)
+                var pSample1 = (float*)sample1.ToPointer();
+                var pSample2 = (float*)sample2.ToPointer();
+                var pMixSample = (float*)mix;
+                for (var i = 0; i < samples * 2; i++)
                 {
-                    for (var i = 0; i < 2; i++)
-                    {
-                        var s1 = (*pSample1 - 32768) / 32768.0f;
-                        var s2 = (*pSample2 - 32768) / 32768.0f;
-                        if (Math.Abs(s1 * s2) > 0.25f)
-                        {
-                            *pMixSample++ = (short)(*pSample1 + *pSample2);
-                        }
-                        else
-                        {
-                            *pMixSample++ = Math.Abs(s1) < Math.Abs(s2) ? *pSample1 : *pSample2;
-                        }
-
-                        pSample1++;
-                        pSample2++;
-                    }
+                    var mixed = *pSample1++ + *pSample2++;
+                    *pMixSample++ = mixed > 1.0f ? 1.0f : (mixed < -1.0f ? -1.0f : mixed);
                 }
             }
         }
 
         private void RenderThreadHandler()
         {
-            var mixerAudioBuffer = Marshal.AllocHGlobal(_samplesBytesPerFrame + 4); // 16bit 2channels
+            var mixerAudioBuffer = Marshal.AllocHGlobal(_samplesBytesPerFrame + 8); // 32bit float 2channels
             using (var systemClockEvent = new VideoClockEvent())
             {
                 long frames = 0;
@@ -179,12 +179,31 @@ namespace ScreenRecorder.AudioSource
                 {
                     if (systemClockEvent.WaitOne(10))
                     {
-                        var samplesBytesPerFrame = _samplesBytesPerFrame + (frames++ % 3 == 0 ? 4 : 0);
+                        var samplesBytesPerFrame = Utils.AudioSamplesForVideoFrames(frames++, 1, 48000) * 8;
 
                         if (_circularMixerBuffer.Count >= samplesBytesPerFrame)
                         {
-                            _circularMixerBuffer.Read(mixerAudioBuffer, samplesBytesPerFrame);
-                            OnNewAudioPacket(new NewAudioPacketEventArgs(48000, 2, SampleFormat.S16, samplesBytesPerFrame / 4, mixerAudioBuffer));
+                            // the packet ends where the samples still queued behind it begin
+                            long timestamp;
+                            lock (_timestampSyncObject)
+                            {
+                                timestamp = _writeTimestamp != 0
+                                    ? _writeTimestamp - SamplesToTicks((_circularMixerBuffer.Count - samplesBytesPerFrame) / 8)
+                                    : Stopwatch.GetTimestamp();
+                            }
+
+                            // Hand the ring memory to listeners in place unless the packet wraps around the end.
+                            var region = _circularMixerBuffer.BeginRead(samplesBytesPerFrame);
+                            if (region.SecondLength == 0)
+                            {
+                                OnNewAudioPacket(new NewAudioPacketEventArgs(48000, 2, SampleFormat.FLT, samplesBytesPerFrame / 8, region.First, timestamp));
+                                _circularMixerBuffer.EndRead(samplesBytesPerFrame);
+                            }
+                            else
+                            {
+                                _circularMixerBuffer.Read(mixerAudioBuffer, samplesBytesPerFrame);
+                                OnNewAudioPacket(new NewAudioPacketEventArgs(48000, 2, SampleFormat.FLT, samplesBytesPerFrame / 8, mixerAudioBuffer, timestamp));
+                            }
                         }
                     }
                 }
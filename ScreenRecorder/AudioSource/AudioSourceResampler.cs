@@ -1,5 +1,5 @@
-﻿using MediaEncoder;
-using ScreenRecorder.Encoder;
+﻿using System.Diagnostics;
+using MediaEncoder;
 
 namespace ScreenRecorder.AudioSource
 {
@@ -7,30 +7,24 @@ namespace ScreenRecorder.AudioSource
     {
         private readonly IAudioSource _audioSource;
         private bool _isDisposed;
-        private readonly int _outputChannels;
-        private readonly int _outputSampleRate;
-        private readonly SampleFormat _outputSampleFormat;
 
         private Resampler _resampler;
-        private readonly int _samplePerBytes;
         private readonly object _syncObject = new object();
+        private readonly int _outputSampleRate;
+        private long _lastPacketTimestamp;
 
         public AudioSourceResampler(IAudioSource audioSource, int outputChannels, SampleFormat outputSampleFormat,
-            int outputSampleRate, int bufferSize = 3200 * 10)
+            int outputSampleRate, int bufferSamples = 800 * 10, int targetBufferedSamples = 0)
         {
-            Buffer = new CircularBuffer(bufferSize);
             this._audioSource = audioSource;
-            this._outputChannels = outputChannels;
-            this._outputSampleRate = outputSampleRate;
-            this._outputSampleFormat = outputSampleFormat;
-            switch (outputSampleFormat)
+            _outputSampleRate = outputSampleRate;
+
+            _resampler = new Resampler(outputChannels, outputSampleFormat, outputSampleRate, bufferSamples);
+            if (targetBufferedSamples > 0)
             {
-                case SampleFormat.S16:
-                    _samplePerBytes = 2;
-                    break;
+                _resampler.EnableDriftCompensation(targetBufferedSamples);
             }
-
-            _resampler = new Resampler();
+            Buffer = _resampler.OutputBuffer;
 
             if (this._audioSource != null)
             {
@@ -38,10 +32,29 @@ namespace ScreenRecorder.AudioSource
             }
         }
 
-        public CircularBuffer Buffer { get; }
+        public AudioRingBuffer Buffer { get; }
 
         public bool IsValidBuffer => _audioSource != null;
 
+        /// <summary>
+        /// Stopwatch ticks at which the sample at the read position of <see cref="Buffer"/> was captured, 0 before the first packet.
+        /// </summary>
+        public long ReadTimestamp
+        {
+            get
+            {
+                lock (_syncObject)
+                {
+                    if (_isDisposed || _lastPacketTimestamp == 0)
+                    {
+                        return 0;
+                    }
+
+                    return _lastPacketTimestamp - (long)_resampler.BufferedSamples * Stopwatch.Frequency / _outputSampleRate;
+                }
+            }
+        }
+
         private void AudioSource_NewAudioPacket(object sender, NewAudioPacketEventArgs eventArgs)
         {
             lock (_syncObject)
@@ -51,18 +64,8 @@ namespace ScreenRecorder.AudioSource
                     return;
                 }
 
-                if (eventArgs.Channels != _outputChannels || eventArgs.SampleFormat != _outputSampleFormat ||
-                    eventArgs.SampleRate != _outputSampleRate)
-                {
-                    _resampler.Resampling(eventArgs.Channels, eventArgs.SampleFormat, eventArgs.SampleRate,
-                        _outputChannels, _outputSampleFormat, _outputSampleRate, eventArgs.DataPointer, eventArgs.Samples,
-                        out var destData, out var destSamples);
-                    Buffer.Write(destData, 0, destSamples * _outputChannels * _samplePerBytes);
-                }
-                else
-                {
-                    Buffer.Write(eventArgs.DataPointer, 0, eventArgs.Samples * eventArgs.Channels * _samplePerBytes);
-                }
+                _resampler.Push(eventArgs.Channels, eventArgs.SampleFormat, eventArgs.SampleRate, eventArgs.DataPointer, eventArgs.Samples);
+                _lastPacketTimestamp = eventArgs.Timestamp;
             }
         }
 
@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Diagnostics;
 using MediaEncoder;
 
 namespace ScreenRecorder.AudioSource
@@ -14,12 +15,19 @@ namespace ScreenRecorder.AudioSource
     {
         public NewAudioPacketEventArgs(int sampleRate, int channels, SampleFormat sampleFormat, int samples,
             IntPtr dataPointer)
+            : this(sampleRate, channels, sampleFormat, samples, dataPointer, Stopwatch.GetTimestamp())
+        {
+        }
+
+        public NewAudioPacketEventArgs(int sampleRate, int channels, SampleFormat sampleFormat, int samples,
+            IntPtr dataPointer, long timestamp)
         {
             SampleRate = sampleRate;
             Channels = channels;
             SampleFormat = sampleFormat;
             Samples = samples;
             DataPointer = dataPointer;
+            Timestamp = timestamp;
         }
 
         public IntPtr DataPointer { get; }
@@ -27,5 +35,11 @@ namespace ScreenRecorder.AudioSource
         public int SampleRate { get; }
         public int Channels { get; }
         public SampleFormat SampleFormat { get; }
+
+        /// <summary>
+        /// Stopwatch ticks at which the last sample of the packet was captured. Sources stamp the packet when they
+        /// hand it out; <see cref="AudioMixer"/> carries its first source's stamps through its own buffering.
+        /// </summary>
+        public long Timestamp { get; }
     }
 }
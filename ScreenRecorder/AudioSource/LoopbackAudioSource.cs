@@ -1,5 +1,4 @@
 ﻿using System;
-using System.Runtime.InteropServices;
 using System.Threading;
 using MediaEncoder;
 using NAudio.CoreAudioApi;
@@ -118,26 +117,17 @@ namespace ScreenRecorder.AudioSource
             {
                 var samples = e.BytesRecorded / ((_bitsPerSample + 7) / 8) / _channels;
 
-                var convertedSamples = Marshal.AllocHGlobal(e.BytesRecorded / 2);
                 unsafe
                 {
                     fixed (void* pBuffer = e.Buffer)
                     {
-                        // FLTP to S16 변환 (추후에 오디오 관련 처리를 간편하게 하기 위해..)
-                        var src = (float*)pBuffer;
-                        var dest = (short*)convertedSamples.ToPointer();
-                        for (var i = 0; i < e.BytesRecorded; i += 4)
-                        {
-                            *dest++ = (short)(*src++ * 32767.0f);
-                        }
-
-                        var eventArgs = new NewAudioPacketEventArgs(_sampleRate, _channels, SampleFormat.S16, samples,
-                            convertedSamples);
+                        // WASAPI loopback delivers interleaved float, which is handed on as is; the listener
+                        // converts once, straight to the format it needs.
+                        var eventArgs = new NewAudioPacketEventArgs(_sampleRate, _channels, SampleFormat.FLT, samples,
+                            new IntPtr(pBuffer));
                         NewAudioPacket?.Invoke(this, eventArgs);
                     }
                 }
-
-                Marshal.FreeHGlobal(convertedSamples);
             }
         }
 
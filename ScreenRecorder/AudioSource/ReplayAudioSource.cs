@@ -0,0 +1,86 @@
+﻿using System;
+using System.Diagnostics;
+using System.Threading;
+using MediaEncoder;
+
+namespace ScreenRecorder.AudioSource
+{
+    /// <summary>
+    /// Replays a WAV file as an audio source in packets of 10ms, pointing straight into the file mapping.
+    /// Packets are always paced by the sample clock: the Encoder drains its audio on VideoClockEvent, so
+    /// packets raised faster than real time would overflow its ring and be dropped.
+    /// </summary>
+    public sealed class ReplayAudioSource : IAudioSource, IDisposable
+    {
+        public event NewAudioPacketEventHandler NewAudioPacket;
+
+        private readonly WaveFileReader _reader;
+
+        private Thread _workerThread;
+        private ManualResetEvent _needToStop;
+
+        /// <summary>
+        /// Takes ownership of reader.
+        /// </summary>
+        public ReplayAudioSource(WaveFileReader reader)
+        {
+            _reader = reader ?? throw new ArgumentNullException(nameof(reader));
+
+            _needToStop = new ManualResetEvent(false);
+            _workerThread = new Thread(new ThreadStart(WorkerThreadHandler)) { Name = "ReplayAudioSource", IsBackground = true };
+        }
+
+        public long SamplesCount { get; private set; }
+
+        /// <summary>
+        /// Starts replaying; subscribe to NewAudioPacket first, or the leading packets are raised to nobody.
+        /// </summary>
+        public void Start()
+        {
+            if (_workerThread == null)
+                throw new ObjectDisposedException(nameof(ReplayAudioSource));
+
+            _workerThread.Start();
+        }
+
+        private void WorkerThreadHandler()
+        {
+            long totalSamples = _reader.Samples;
+            int packetSamples = Math.Max(1, _reader.SampleRate / 100);
+            if (totalSamples > 0)
+            {
+                long startTimestamp = Stopwatch.GetTimestamp();
+                long position = 0;
+
+                while (position < totalSamples && !_needToStop.WaitOne(0, false))
+                {
+                    long dueTimestamp = startTimestamp + (position * Stopwatch.Frequency / _reader.SampleRate);
+                    long remaining = dueTimestamp - Stopwatch.GetTimestamp();
+                    if (remaining > 0 && _needToStop.WaitOne((int)(remaining * 1000 / Stopwatch.Frequency), false))
+                        break;
+
+                    int samples = (int)Math.Min(packetSamples, totalSamples - position);
+                    NewAudioPacket?.Invoke(this, new NewAudioPacketEventArgs(_reader.SampleRate, _reader.Channels, _reader.SampleFormat, samples, _reader.GetSamples(position)));
+                    position += samples;
+                    SamplesCount = position;
+                }
+            }
+        }
+
+        public void Dispose()
+        {
+            _needToStop?.Set();
+            if (_workerThread != null)
+            {
+                if (_workerThread.IsAlive && !_workerThread.Join(1000))
+                    _workerThread.Abort();
+                _workerThread = null;
+
+                _needToStop?.Close();
+                _needToStop = null;
+            }
+
+            _reader.Dispose();
+        }
+    }
+}
@@ -270,7 +270,8 @@ float4 PShader(PSInput input) : SV_Target
                 _oldKeyGreen = keyGreen;
                 _oldKeyBlue = keyBlue;
 
-                var keyColor = ((uint)keyRed << 16) | ((uint)keyGreen << 8) | ((uint)keyBlue << 0);
+                // vec4_from_rgba_srgb reads red from the low byte, as OBS packs its key colors
+                var keyColor = ((uint)keyBlue << 16) | ((uint)keyGreen << 8) | ((uint)keyRed << 0);
                 vec4_from_rgba_srgb(out var keyRgb, keyColor | 0xFF000000);
                 var cb = new Vector4(-0.100644f, -0.338572f, 0.439216f, 0.501961f);
                 var cr = new Vector4(0.439216f, -0.398942f, -0.040274f, 0.501961f);
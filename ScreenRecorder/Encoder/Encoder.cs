@@ -1,6 +1,7 @@
 ﻿using System;
 using System.Collections.Concurrent;
-using System.Runtime.InteropServices;
+using System.Collections.Generic;
+using System.Diagnostics;
 using System.Threading;
 using System.Windows;
 using MediaEncoder;
@@ -38,6 +39,7 @@ namespace ScreenRecorder.Encoder
             private bool _isDisposed = false;
 
             private readonly ConcurrentQueue<VideoFrame> _srcVideoFrameQueue;
+            private readonly VideoFramePool _videoFramePool;
 
             private readonly ConcurrentQueue<VideoFrame> _videoFrameQueue;
             private readonly ConcurrentQueue<AudioFrame> _audioFrameQueue;
@@ -48,18 +50,27 @@ namespace ScreenRecorder.Encoder
             private Thread _audioWorkerThread;
             private ManualResetEvent _needToStop;
 
-            private readonly CircularBuffer _srcAudioCircularBuffer;
             private Resampler _resampler;
 
             private readonly int _samplesPerFrame;
-            private readonly int _samplesBytesPerFrame;
-            private readonly int _framesPerAdditinalSample;
+            private readonly int _audioFramesPerChunk;
+
+            private long _lastAudioPacketTimestamp;
 
             #endregion
 
             #region Constructors
 
             public MediaBuffer(IVideoSource videoSource, IAudioSource audioSource)
+                : this(videoSource, audioSource, SampleFormat.S16)
+            {
+            }
+
+            /// <summary>
+            /// Audio frames are produced in sampleFormat, normally MediaWriter.PreferredSampleFormat,
+            /// so that the source is converted only once on its way to the encoder.
+            /// </summary>
+            public MediaBuffer(IVideoSource videoSource, IAudioSource audioSource, SampleFormat sampleFormat)
             {
                 _enableEvent = new ManualResetEvent(false);
                 _videoSource = videoSource;
@@ -69,20 +80,21 @@ namespace ScreenRecorder.Encoder
                 {
                     _videoFrameQueue = new ConcurrentQueue<VideoFrame>();
                     _srcVideoFrameQueue = new ConcurrentQueue<VideoFrame>();
+                    _videoFramePool = new VideoFramePool();
                     _videoSource.NewVideoFrame += VideoSource_NewVideoFrame;
                     _videoWorkerThread = new Thread(new ThreadStart(VideoWorkerThreadHandler)) { IsBackground = true };
                 }
                 if (_audioSource != null)
                 {
-                    _resampler = new Resampler();
-
                     _samplesPerFrame = (int)(48000.0d / VideoClockEvent.Framerate);
-                    _samplesBytesPerFrame = _samplesPerFrame * 2 * 2; // 2Ch, 16bit
 
-                    var remainingSamples = 48000 - (_samplesPerFrame * VideoClockEvent.Framerate);
-                    _framesPerAdditinalSample = remainingSamples != 0 ? VideoClockEvent.Framerate / remainingSamples : 0;
+                    // Keep the minimum number of samples at 1600 (Aac codec has a minimum number of samples, so less than this will cause problems)
+                    // I tried to process it on the encoder, but it's easier to implement if I just supply a lot of samples.
+                    _audioFramesPerChunk = (int)Math.Ceiling(1600.0d / _samplesPerFrame);
 
-                    _srcAudioCircularBuffer = new CircularBuffer(_samplesBytesPerFrame * 15);
+                    // the source is steered to keep two chunks buffered, which absorbs its clock drift without padding
+                    _resampler = new Resampler(2, sampleFormat, 48000, _samplesPerFrame * 15);
+                    _resampler.EnableDriftCompensation(_samplesPerFrame * _audioFramesPerChunk * 2);
                     _audioFrameQueue = new ConcurrentQueue<AudioFrame>();
                     _audioSource.NewAudioPacket += AudioSource_NewAudioPacket;
                     _audioWorkerThread = new Thread(new ThreadStart(AudioWorkerThreadHandler)) { IsBackground = true };
@@ -100,26 +112,16 @@ namespace ScreenRecorder.Encoder
 
             private void AudioWorkerThreadHandler()
             {
-                int samplesPerAudioFrame = _samplesPerFrame;
-
-                // Keep the minimum number of samples at 1600 (Aac codec has a minimum number of samples, so less than this will cause problems)
-                // I tried to process it on the encoder, but it's easier to implement if I just supply a lot of samples.
-                int skipFrames = (int)(Math.Ceiling(1600.0d / samplesPerAudioFrame) - 1);
-                samplesPerAudioFrame *= skipFrames + 1;
-
-                var samplesBytesPerFrame = samplesPerAudioFrame * 2 * 2;
+                int skipFrames = _audioFramesPerChunk - 1;
 
                 long skipCount = skipFrames;
-                IntPtr audioBuffer = Marshal.AllocHGlobal(samplesBytesPerFrame + (VideoClockEvent.Framerate * 2 * 2));
                 using (VideoClockEvent videoClockEvent = new VideoClockEvent())
                 {
-                    long frames = 0, lastReadedFrames = 0;
+                    long chunkFrames = 0;
                     while (!_needToStop.WaitOne(0, false))
                     {
                         if (videoClockEvent.WaitOne(10))
                         {
-                            frames++;
-
                             if (!(_enableEvent?.WaitOne(0, false) ?? true))
                                 continue;
 
@@ -139,30 +141,27 @@ namespace ScreenRecorder.Encoder
                                 skipCount = skipFrames;
                             }
 
-                            var needAdditinalSamples = _framesPerAdditinalSample != 0 ? Math.Min(VideoClockEvent.Framerate, (int)(lastReadedFrames - frames) % _framesPerAdditinalSample) : 0;
-                            var needSamplesBytes = samplesBytesPerFrame + (needAdditinalSamples * 4);
+                            var needSamples = Utils.AudioSamplesForVideoFrames(chunkFrames, _audioFramesPerChunk, 48000);
+                            chunkFrames += _audioFramesPerChunk;
 
-                            if (_srcAudioCircularBuffer.Count >= needSamplesBytes)
+                            // Only a source that delivers nothing at all (e.g. silent loopback) still ends up here.
+                            AudioFrame audioFrame = _resampler.Pull(needSamples);
+                            if (audioFrame == null)
                             {
-                                _srcAudioCircularBuffer.Read(audioBuffer, needSamplesBytes);
-
-                                AudioFrame audioFrame = new AudioFrame(48000, 2, SampleFormat.S16, needSamplesBytes / 4);
-                                audioFrame.FillFrame(audioBuffer);
-
-                                _audioFrameQueue.Enqueue(audioFrame);
+                                audioFrame = _resampler.RentFrame(needSamples);
+                                audioFrame.ClearFrame();
                             }
                             else
                             {
-                                AudioFrame audioFrame = new AudioFrame(48000, 2, SampleFormat.S16, needSamplesBytes / 4);
-                                audioFrame.ClearFrame();
-                                _audioFrameQueue.Enqueue(audioFrame);
+                                // the newest buffered sample arrived with the last packet; the frame starts that many samples earlier
+                                long lastPacketTimestamp = Interlocked.Read(ref _lastAudioPacketTimestamp);
+                                if (lastPacketTimestamp != 0)
+                                    audioFrame.CaptureTimestamp = lastPacketTimestamp - (long)((_resampler.BufferedSamples + audioFrame.Samples) * (double)Stopwatch.Frequency / 48000);
                             }
-
-                            lastReadedFrames = frames;
+                            _audioFrameQueue.Enqueue(audioFrame);
                         }
                     }
                 }
-                Marshal.FreeHGlobal(audioBuffer);
             }
 
             private void VideoWorkerThreadHandler()
@@ -202,6 +201,8 @@ namespace ScreenRecorder.Encoder
                             }
                             else if (lastVideoFrame != null)
                             {
+                                // a repeated frame shows nothing new, so its latency is counted from the clock tick
+                                lastVideoFrame.CaptureTimestamp = Stopwatch.GetTimestamp();
                                 VideoFrame clone = new VideoFrame(lastVideoFrame);
                                 _videoFrameQueue.Enqueue(lastVideoFrame);
                                 lastVideoFrame = clone;
@@ -257,15 +258,9 @@ namespace ScreenRecorder.Encoder
                     if (_enableEvent != null && !_enableEvent.WaitOne(0, false))
                         return;
 
-                    VideoFrame videoFrame = new VideoFrame(eventArgs.Width, eventArgs.Height, eventArgs.PixelFormat);
-                    if (eventArgs.PixelFormat == PixelFormat.NV12)
-                    {
-                        videoFrame.FillFrame(new IntPtr[] { eventArgs.DataPointer, eventArgs.DataPointer + (eventArgs.Stride * eventArgs.Height) }, new int[] { eventArgs.Stride, eventArgs.Stride, eventArgs.Stride, eventArgs.Stride, eventArgs.Stride, eventArgs.Stride, eventArgs.Stride, eventArgs.Stride });
-                    }
-                    else
-                    {
-                        videoFrame.FillFrame(eventArgs.DataPointer, eventArgs.Stride);
-                    }
+                    VideoFrame videoFrame = _videoFramePool.Rent(eventArgs.Width, eventArgs.Height, eventArgs.PixelFormat);
+                    videoFrame.FillFrame(eventArgs.Planes);
+                    videoFrame.CaptureTimestamp = eventArgs.Timestamp;
                     _srcVideoFrameQueue.Enqueue(videoFrame);
                 }
             }
@@ -280,17 +275,8 @@ namespace ScreenRecorder.Encoder
                     if (_enableEvent != null && !_enableEvent.WaitOne(0, false))
                         return;
 
-                    if (eventArgs.Channels != 2 || eventArgs.SampleFormat != SampleFormat.S16 || eventArgs.SampleRate != 48000)
-                    {
-                        _resampler.Resampling(eventArgs.Channels, eventArgs.SampleFormat, eventArgs.SampleRate,
-                            2, SampleFormat.S16, 48000, eventArgs.DataPointer, eventArgs.Samples, out var destData, out var destSamples);
-
-                        _srcAudioCircularBuffer.Write(destData, 0, destSamples * 4);
-                    }
-                    else
-                    {
-                        _srcAudioCircularBuffer.Write(eventArgs.DataPointer, 0, eventArgs.Samples * 4);
-                    }
+                    _resampler.Push(eventArgs.Channels, eventArgs.SampleFormat, eventArgs.SampleRate, eventArgs.DataPointer, eventArgs.Samples);
+                    Interlocked.Exchange(ref _lastAudioPacketTimestamp, eventArgs.Timestamp);
                 }
             }
 
@@ -340,6 +326,8 @@ namespace ScreenRecorder.Encoder
                                 videoFrame.Dispose();
                         }
 
+                        _videoFramePool?.Dispose();
+
                         _resampler?.Dispose();
                         _resampler = null;
 
@@ -366,6 +354,70 @@ namespace ScreenRecorder.Encoder
                 return null;
             }
 
+            /// <summary>
+            /// Dequeues up to audioFrames.Length queued audio frames and returns how many were taken.
+            /// </summary>
+            public int TryAudioFramesDequeue(AudioFrame[] audioFrames)
+            {
+                int count = 0;
+                while (_audioFrameQueue != null && count < audioFrames.Length && _audioFrameQueue.TryDequeue(out AudioFrame audioFrame))
+                {
+                    audioFrames[count++] = audioFrame;
+                }
+                return count;
+            }
+
+            public void RecycleAudioFrame(AudioFrame audioFrame)
+            {
+                if (_resampler != null)
+                {
+                    _resampler.Recycle(audioFrame);
+                }
+                else
+                {
+                    audioFrame.Dispose();
+                }
+            }
+
+            /// <summary>
+            /// Stops the audio worker and returns every sample that is still queued or buffered in the resampler,
+            /// so the end of the recording is not cut off.
+            /// </summary>
+            public IEnumerable<AudioFrame> DrainAudioFrames()
+            {
+                if (_audioWorkerThread == null)
+                    yield break;
+
+                _needToStop?.Set();
+                if (_audioWorkerThread.IsAlive && !_audioWorkerThread.Join(500))
+                    _audioWorkerThread.Abort();
+                _audioWorkerThread = null;
+
+                while (_audioFrameQueue.TryDequeue(out AudioFrame audioFrame))
+                {
+                    yield return audioFrame;
+                }
+
+                Stop();
+                bool flushed = false;
+                lock (_audioSyncObject)
+                {
+                    if (!_isDisposed)
+                    {
+                        _resampler.Flush();
+                        flushed = true;
+                    }
+                }
+                if (!flushed)
+                    yield break;
+
+                AudioFrame remainFrame;
+                while ((remainFrame = _resampler.Pull(_samplesPerFrame)) != null)
+                {
+                    yield return remainFrame;
+                }
+            }
+
             #endregion
         }
 
@@ -587,21 +639,27 @@ namespace ScreenRecorder.Encoder
             {
                 if (argument is EncoderArguments encoderArguments)
                 {
-                    using (var mediaBuffer = new MediaBuffer(encoderArguments.VideoSource, encoderArguments.AudioCodec == AudioCodec.None ? null : encoderArguments.AudioSource))
+                    using (var mediaWriter = new MediaWriter(
+                        encoderArguments.VideoSize.Width, encoderArguments.VideoSize.Height, VideoClockEvent.Framerate, 1,
+                        encoderArguments.VideoCodec, encoderArguments.VideoBitrate,
+                        encoderArguments.AudioCodec, encoderArguments.AudioBitrate))
                     {
-                        using (var mediaWriter = new MediaWriter(
-                            encoderArguments.VideoSize.Width, encoderArguments.VideoSize.Height, VideoClockEvent.Framerate, 1,
-                            encoderArguments.VideoCodec, encoderArguments.VideoBitrate,
-                            encoderArguments.AudioCodec, encoderArguments.AudioBitrate))
-                        {
-                            mediaWriter.Open(encoderArguments.Url, encoderArguments.Format);
+                        mediaWriter.TimestampSync = true;
+                        mediaWriter.WriteKeyframeIndex = true;
+                        mediaWriter.Open(encoderArguments.Url, encoderArguments.Format);
 
+                        using (var mediaBuffer = new MediaBuffer(encoderArguments.VideoSource,
+                            encoderArguments.AudioCodec == AudioCodec.None ? null : encoderArguments.AudioSource,
+                            encoderArguments.AudioCodec == AudioCodec.None ? SampleFormat.S16 : mediaWriter.PreferredSampleFormat))
+                        {
+                            var audioFrames = new AudioFrame[16];
                             mediaBuffer.Start();
+                            OnEncoderStarted();
                             while (!_needToStop.WaitOne(0, false))
                             {
                                 var videoFrame = mediaBuffer.TryVideoFrameDequeue();
-                                var audioFrame = mediaBuffer.TryAudioFrameDequeue();
-                                if (videoFrame != null || audioFrame != null)
+                                var audioFramesCount = mediaBuffer.TryAudioFramesDequeue(audioFrames);
+                                if (videoFrame != null || audioFramesCount > 0)
                                 {
                                     if (videoFrame != null)
                                     {
@@ -618,15 +676,19 @@ namespace ScreenRecorder.Encoder
 
                                         videoFrame.Dispose();
                                     }
-                                    if (audioFrame != null)
+                                    if (audioFramesCount > 0)
                                     {
                                         if (_status != EncoderStatus.Pause)
                                         {
-                                            mediaWriter.EncodeAudioFrame(audioFrame);
+                                            mediaWriter.EncodeAudioFrames(audioFrames, 0, audioFramesCount);
                                             AudioSamplesCount = mediaWriter.AudioSamplesCount;
                                         }
 
-                                        audioFrame.Dispose();
+                                        for (int i = 0; i < audioFramesCount; i++)
+                                        {
+                                            mediaBuffer.RecycleAudioFrame(audioFrames[i]);
+                                            audioFrames[i] = null;
+                                        }
                                     }
                                 }
                                 else
@@ -635,6 +697,17 @@ namespace ScreenRecorder.Encoder
                                         break;
                                 }
                             }
+
+                            foreach (var audioFrame in mediaBuffer.DrainAudioFrames())
+                            {
+                                if (_status != EncoderStatus.Pause)
+                                {
+                                    mediaWriter.EncodeAudioFrame(audioFrame);
+                                    AudioSamplesCount = mediaWriter.AudioSamplesCount;
+                                }
+
+                                mediaBuffer.RecycleAudioFrame(audioFrame);
+                            }
                         }
                     }
                 }
@@ -684,6 +757,15 @@ namespace ScreenRecorder.Encoder
             EncoderFirstStarting?.Invoke(this, EventArgs.Empty);
         }
 
+        /// <summary>
+        /// Raised on the encoder thread once the writer is open and the sources are being buffered.
+        /// </summary>
+        public event EventHandler EncoderStarted;
+        protected virtual void OnEncoderStarted()
+        {
+            EncoderStarted?.Invoke(this, EventArgs.Empty);
+        }
+
         #endregion
     }
 }
@@ -0,0 +1,88 @@
+﻿using System;
+using System.Diagnostics;
+using MediaEncoder;
+using ScreenRecorder.AudioSource;
+using ScreenRecorder.VideoSource;
+
+namespace ScreenRecorder.Encoder
+{
+    /// <summary>
+    /// Encoder fed from a Y4M/raw video file and an optional WAV file instead of the desktop, so that the whole
+    /// capture-to-file pipeline runs on the same input every time. Stops by itself at the end of the video.
+    /// </summary>
+    public class ReplayEncoder : Encoder
+    {
+        private ReplayVideoSource _replayVideoSource;
+        private ReplayAudioSource _replayAudioSource;
+
+        public ReplayEncoder()
+        {
+            this.EncoderStopped += ReplayEncoder_EncoderStopped;
+        }
+
+        public void Start(string format, string url, VideoCodec videoCodec, int videoBitrate, AudioCodec audioCodec, int audioBitrate, string videoPath, string audioPath)
+        {
+            if (base.IsRunning)
+                return;
+
+            // to be on the safe side
+            Debug.Assert(_replayVideoSource == null);
+            Debug.Assert(_replayAudioSource == null);
+            ReplayEncoder_EncoderStopped(this, null);
+
+            try
+            {
+                var videoReader = new VideoFileReader(videoPath);
+                _replayVideoSource = new ReplayVideoSource(videoReader);
+                if (!string.IsNullOrEmpty(audioPath))
+                    _replayAudioSource = new ReplayAudioSource(new WaveFileReader(audioPath));
+                else
+                    audioCodec = AudioCodec.None;
+
+                // the encoder runs on VideoClockEvent, so the file's length in clock ticks is where it ends
+                MaximumVideoFramesCount = (ulong)Math.Max(1, Math.Round(videoReader.FrameCount * (double)videoReader.FrameRateDenominator /
+                    videoReader.FrameRateNumerator * VideoClockEvent.Framerate));
+
+                base.Start(format, url,
+                    _replayVideoSource, videoCodec, videoBitrate, new VideoSize(videoReader.Width, videoReader.Height),
+                    _replayAudioSource, audioCodec, audioBitrate);
+            }
+            catch (Exception ex)
+            {
+                base.Stop();
+                ReplayEncoder_EncoderStopped(this, null);
+                throw ex;
+            }
+        }
+
+        /// <summary>
+        /// The files are only played once, so they start when the encoder listens rather than in Start.
+        /// </summary>
+        protected override void OnEncoderStarted()
+        {
+            _replayVideoSource?.Start();
+            _replayAudioSource?.Start();
+            base.OnEncoderStarted();
+        }
+
+        private void ReplayEncoder_EncoderStopped(object sender, EncoderStoppedEventArgs eventArgs)
+        {
+            _replayVideoSource?.Dispose();
+            _replayVideoSource = null;
+
+            _replayAudioSource?.Dispose();
+            _replayAudioSource = null;
+
+            MaximumVideoFramesCount = 0;
+        }
+
+        protected override void Dispose(bool disposing)
+        {
+            if (disposing)
+            {
+                base.Dispose(disposing);
+                this.EncoderStopped -= ReplayEncoder_EncoderStopped;
+            }
+        }
+    }
+}
@@ -56,6 +56,16 @@ namespace ScreenRecorder
             return (ulong)(videoFramesCount / (double)VideoClockEvent.Framerate);
         }
 
+        /// <summary>
+        /// Number of audio samples belonging to the video frames [firstFrame, firstFrame + frameCount).
+        /// Consecutive calls add up to exactly sampleRate samples per second of video.
+        /// </summary>
+        public static int AudioSamplesForVideoFrames(long firstFrame, int frameCount, int sampleRate)
+        {
+            long framerate = VideoClockEvent.Framerate;
+            return (int)(((firstFrame + frameCount) * sampleRate / framerate) - (firstFrame * sampleRate / framerate));
+        }
+
         [DllImport("user32.dll")]
         static extern bool SetWindowDisplayAffinity(IntPtr hwnd, uint affinity);
 
@@ -1,29 +1,20 @@
 ﻿using System;
 using System.Diagnostics;
 using System.Threading;
+using MediaEncoder;
 
 namespace ScreenRecorder
 {
+    /// <summary>
+    /// Ticks at the record frame rate. Every instance paces itself with a native FramePacer on a grid shared
+    /// from Start, so all consumers tick together and a consumer that falls behind gets its missed ticks
+    /// instead of losing them.
+    /// </summary>
     public class VideoClockEvent : IDisposable
     {
-        private const int MaxEventCount = 8;
-
         private static readonly object SyncObject = new object();
-        private static int _referenceCount = -1;
-        private static readonly AutoResetEvent[] Events = new AutoResetEvent[MaxEventCount];
-        private static Thread _workerThread;
-        private static ManualResetEvent _needToStop;
         private static int _frameRate = 60;
-        private static long _interval;
-        private static long _sleepLimit;
-
-        static VideoClockEvent()
-        {
-            for (int i = 0; i < Events.Length; i++)
-            {
-                Events[i] = new AutoResetEvent(false);
-            }
-        }
+        private static long _origin;
 
         public static int Framerate
         {
@@ -35,96 +26,77 @@ namespace ScreenRecorder
                     if (_frameRate != value)
                     {
                         _frameRate = value;
-                        UpdateInterval();
+                        _origin = Stopwatch.GetTimestamp();
                     }
                 }
             }
         }
 
-        private static void UpdateInterval()
-        {
-            _interval = (long)(Stopwatch.Frequency / (double)_frameRate);
-            _sleepLimit = _interval - (Stopwatch.Frequency / 500);
-        }
-
         public static void Start()
         {
             lock (SyncObject)
             {
-                _needToStop = new ManualResetEvent(false);
-
-                _workerThread = new Thread(new ThreadStart(WorkerThreadHandler)) { Name = "SystemClockEventThread", IsBackground = false, Priority = ThreadPriority.Highest };
-                _workerThread.Start();
+                _origin = Stopwatch.GetTimestamp();
             }
         }
 
         public static void Stop()
         {
-            try
+            lock (SyncObject)
             {
-                lock (SyncObject)
-                {
-                    _needToStop?.Set();
-                    if (_workerThread != null)
-                    {
-                        if (_workerThread.IsAlive && !_workerThread.Join(100))
-                            _workerThread.Abort();
-                        _workerThread = null;
-                        _needToStop?.Close();
-                        _needToStop = null;
-                    }
-                }
+                _origin = 0;
             }
-            catch { }
         }
 
-        private static void WorkerThreadHandler()
-        {
-            UpdateInterval();
+        private readonly bool _catchUp;
+        private FramePacer _pacer;
+        private int _pacerFrameRate;
 
-            long prevTick = Stopwatch.GetTimestamp();
-            while (!_needToStop.WaitOne(0, false))
-            {
-                long currentTick = Stopwatch.GetTimestamp();
-                if (currentTick - prevTick >= _interval)
-                {
-                    foreach (var @event in Events)
-                        @event.Set();
+        public VideoClockEvent() : this(true)
+        {
+        }
 
-                    prevTick += _interval;
-                }
-                else if (currentTick - prevTick < _sleepLimit)
-                {
-                    if (_needToStop.WaitOne(1, false))
-                        break;
-                }
-            }
+        /// <summary>
+        /// Without catchUp, ticks missed while the consumer was busy are skipped (capture has no use for them).
+        /// </summary>
+        public VideoClockEvent(bool catchUp)
+        {
+            _catchUp = catchUp;
+            CreatePacer();
         }
 
-        private readonly int _currentReferenceIndex;
+        public FramePacer Pacer => _pacer;
 
-        public VideoClockEvent()
+        private void CreatePacer()
         {
-            _currentReferenceIndex = Interlocked.Increment(ref _referenceCount);
-            if (_currentReferenceIndex >= MaxEventCount)
+            long origin;
+            lock (SyncObject)
             {
-                throw new OutOfMemoryException();
+                _pacerFrameRate = _frameRate;
+                origin = _origin != 0 ? _origin : Stopwatch.GetTimestamp();
             }
+
+            _pacer?.Dispose();
+            _pacer = new FramePacer(_pacerFrameRate, 1, origin) { CatchUp = _catchUp };
         }
 
         public bool WaitOne(int millisecondsTimeout = Timeout.Infinite)
         {
-            return Events[_currentReferenceIndex].WaitOne(millisecondsTimeout);
+            if (_pacerFrameRate != _frameRate)
+                CreatePacer();
+
+            return _pacer.WaitNext(millisecondsTimeout);
         }
 
         public bool WaitOne(int millisecondsTimeout, bool exitContext)
         {
-            return Events[_currentReferenceIndex].WaitOne(millisecondsTimeout, exitContext);
+            return WaitOne(millisecondsTimeout);
         }
 
         public void Dispose()
         {
-            _ = Interlocked.Decrement(ref _referenceCount);
+            _pacer?.Dispose();
+            _pacer = null;
         }
     }
 }
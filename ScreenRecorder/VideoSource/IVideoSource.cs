@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Diagnostics;
 using MediaEncoder;
 
 namespace ScreenRecorder.VideoSource
@@ -21,6 +22,23 @@ namespace ScreenRecorder.VideoSource
             Stride = stride;
             DataPointer = dataPointer;
             PixelFormat = pixelFormat;
+            Timestamp = Stopwatch.GetTimestamp();
+
+            // NV12 from the capture comes as one block with the UV plane right below the Y plane
+            Planes = pixelFormat == PixelFormat.NV12
+                ? new FramePlanes(dataPointer, stride, dataPointer + (stride * height), stride)
+                : new FramePlanes(dataPointer, stride);
+        }
+
+        public NewVideoFrameEventArgs(int width, int height, FramePlanes planes, PixelFormat pixelFormat)
+        {
+            Width = width;
+            Height = height;
+            Stride = planes.Stride0;
+            DataPointer = planes.Data0;
+            PixelFormat = pixelFormat;
+            Planes = planes;
+            Timestamp = Stopwatch.GetTimestamp();
         }
 
         #endregion
@@ -38,6 +56,13 @@ namespace ScreenRecorder.VideoSource
 
         public PixelFormat PixelFormat { get; }
 
+        public FramePlanes Planes { get; }
+
+        /// <summary>
+        /// Stopwatch ticks at which the source handed out the frame.
+        /// </summary>
+        public long Timestamp { get; }
+
         #endregion
     }
 }
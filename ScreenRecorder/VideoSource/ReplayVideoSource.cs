@@ -0,0 +1,85 @@
+﻿using System;
+using System.Diagnostics;
+using System.Threading;
+using MediaEncoder;
+
+namespace ScreenRecorder.VideoSource
+{
+    /// <summary>
+    /// Replays a Y4M or raw video file as a video source, so that the encode pipeline can be driven with the same
+    /// frames on every run. Frames point straight into the file mapping; nothing is copied before the consumer.
+    /// Frames are always paced at the file's frame rate: the Encoder samples its sources on VideoClockEvent and
+    /// drops frames that arrive early, so an unpaced source would lose most of its frames. To encode a file as
+    /// fast as possible, feed VideoFileReader.ReadFrame to a MediaWriter directly (Benchmark encode).
+    /// </summary>
+    public sealed class ReplayVideoSource : IVideoSource, IDisposable
+    {
+        public event NewVideoFrameEventHandler NewVideoFrame;
+
+        private readonly VideoFileReader _reader;
+
+        private Thread _workerThread;
+        private ManualResetEvent _needToStop;
+
+        /// <summary>
+        /// Takes ownership of reader.
+        /// </summary>
+        public ReplayVideoSource(VideoFileReader reader)
+        {
+            _reader = reader ?? throw new ArgumentNullException(nameof(reader));
+
+            _needToStop = new ManualResetEvent(false);
+            _workerThread = new Thread(new ThreadStart(WorkerThreadHandler)) { Name = "ReplayVideoSource", IsBackground = true };
+        }
+
+        public long FramesCount { get; private set; }
+
+        /// <summary>
+        /// Starts replaying; subscribe to NewVideoFrame first, or the leading frames are raised to nobody.
+        /// </summary>
+        public void Start()
+        {
+            if (_workerThread == null)
+                throw new ObjectDisposedException(nameof(ReplayVideoSource));
+
+            _workerThread.Start();
+        }
+
+        private void WorkerThreadHandler()
+        {
+            int frameCount = _reader.FrameCount;
+            if (frameCount > 0)
+            {
+                double ticksPerFrame = Stopwatch.Frequency * (double)_reader.FrameRateDenominator / _reader.FrameRateNumerator;
+                long startTimestamp = Stopwatch.GetTimestamp();
+
+                for (int frame = 0; frame < frameCount && !_needToStop.WaitOne(0, false); frame++)
+                {
+                    long dueTimestamp = startTimestamp + (long)(frame * ticksPerFrame);
+                    long remaining = dueTimestamp - Stopwatch.GetTimestamp();
+                    if (remaining > 0 && _needToStop.WaitOne((int)(remaining * 1000 / Stopwatch.Frequency), false))
+                        break;
+
+                    NewVideoFrame?.Invoke(this, new NewVideoFrameEventArgs(_reader.Width, _reader.Height, _reader.GetFramePlanes(frame), _reader.PixelFormat));
+                    FramesCount = frame + 1;
+                }
+            }
+        }
+
+        public void Dispose()
+        {
+            _needToStop?.Set();
+            if (_workerThread != null)
+            {
+                if (_workerThread.IsAlive && !_workerThread.Join(3000))
+                    _workerThread.Abort();
+                _workerThread = null;
+
+                _needToStop?.Close();
+                _needToStop = null;
+            }
+
+            _reader.Dispose();
+        }
+    }
+}
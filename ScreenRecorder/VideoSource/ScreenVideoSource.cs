@@ -46,7 +46,7 @@ namespace ScreenRecorder.VideoSource
                 region = screenVideoSourceArguments.Region;
             }
 
-            using (var videoClockEvent = new VideoClockEvent())
+            using (var videoClockEvent = new VideoClockEvent(false))
             {
                 while (!_needToStop.WaitOne(0, false))
                 {